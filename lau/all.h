@@ -24,15 +24,28 @@
 #define LAU_CPP_LIB_LAU_ALL_H
 
 #include "algorithm.h"
+#include "async_reader.h"
+#include "buffer_pool.h"
+#include "clock_cache.h"
+#include "crc32c.h"
 #include "exception.h"
+#include "file_b_plus_tree.h"
 #include "file_data_structure.h"
 #include "file_double_unrolled_linked_list.h"
+#include "file_sharded_unrolled_linked_list.h"
+#include "file_storage.h"
+#include "file_string_unrolled_linked_list.h"
 #include "file_unrolled_linked_list.h"
+#include "flat_hash_table.h"
+#include "flat_hash_map.h"
+#include "journaled_storage.h"
 #include "linked_hash_table.h"
 #include "linked_hash_map.h"
 #include "map.h"
+#include "mapped_storage.h"
 #include "priority_queue.h"
 #include "RB_tree.h"
+#include "reader_writer_latch.h"
 #include "rehash_policy.h"
 #include "sparse_table.h"
 #include "token_scanner.h"
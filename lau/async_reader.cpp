@@ -0,0 +1,424 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/async_reader.cpp
+ *
+ * This is a internal source file, including the implementation of the
+ * <code>lau::AsyncReader</code> class.
+ */
+
+#include "async_reader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__) && !defined(LAU_CPP_LIB_NO_IO_URING) && __has_include(<linux/io_uring.h>)
+#define LAU_CPP_LIB_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "exception.h"
+#include "type_traits.h"
+
+namespace {
+
+/**
+ * Read the buffer at the position, retrying short reads.  The part beyond
+ * the end of the file is filled with 0.
+ * @return whether the read is successful
+ */
+bool ReadAll(int fd, char* data, SizeT length, long position) {
+    while (length > 0) {
+        ssize_t size = ::pread(fd, data, length, position);
+        if (size < 0 && errno == EINTR) continue;
+        if (size < 0) return false;
+        if (size == 0) break;
+        data += size;
+        length -= size;
+        position += size;
+    }
+    if (length > 0) std::memset(data, 0, length);
+    return true;
+}
+
+} // namespace
+
+#ifdef LAU_CPP_LIB_IO_URING
+
+/**
+ * @struct Ring_
+ *
+ * The rings of io_uring mapped into memory.
+ */
+struct lau::AsyncReader::Ring_ {
+    int fd = -1;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned* sqArray = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    bool broken = false; // io_uring_enter failed, so the ring is not used again
+    io_uring_cqe* cqes = nullptr;
+    void* sqRing = MAP_FAILED;
+    std::size_t sqRingSize = 0;
+    void* cqRing = MAP_FAILED;
+    std::size_t cqRingSize = 0;
+    std::size_t sqesSize = 0;
+
+    ~Ring_() {
+        if (sqes != nullptr) ::munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) ::munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED) ::munmap(sqRing, sqRingSize);
+        if (fd >= 0) ::close(fd);
+    }
+
+    /**
+     * Set up the rings.
+     * @param entries
+     * @return whether io_uring is available
+     */
+    bool SetUp(unsigned entries) {
+        io_uring_params params{};
+        fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                        IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) return false;
+        cqRing = singleMap ? sqRing
+                           : ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                    IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) return false;
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* address = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                               IORING_OFF_SQES);
+        if (address == MAP_FAILED) return false;
+        sqes = static_cast<io_uring_sqe*>(address);
+
+        char* sq = static_cast<char*>(sqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqEntries = params.sq_entries;
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    /**
+     * Do a batch of reads on the file.  The reads are sent as long as
+     * there are free entries in the ring, and a read that is not finished
+     * (e.g. a short read) is sent again for the rest.  This function never
+     * returns while a read is in flight, since the kernel may still be
+     * writing to the buffers; if <code>io_uring_enter</code> fails, no more
+     * reads are sent, the reads in flight are waited for, and the ring is
+     * marked as broken.
+     * @return whether all the reads are successful
+     */
+    bool Read(int file, lau::ReadRequest* requests, SizeT count) {
+        struct Pending {
+            iovec vector;
+            long  position;
+        };
+        std::vector<Pending> pending(count);
+        std::vector<SizeT> queue(count); // the reads to send
+        for (SizeT i = 0; i < count; ++i) {
+            pending[i] = Pending{iovec{requests[i].buffer, static_cast<std::size_t>(requests[i].length)},
+                                 requests[i].position};
+            queue[i] = count - 1 - i;
+        }
+
+        SizeT inFlight = 0;
+        bool failed = false;
+        while (inFlight > 0 || (!failed && !queue.empty())) {
+            // Fill the submission queue
+            unsigned tail = *sqTail;
+            unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+            while (!failed && !queue.empty() && tail - head < sqEntries) {
+                SizeT i = queue.back();
+                queue.pop_back();
+                if (pending[i].vector.iov_len == 0) continue;
+                unsigned slot = tail & sqMask;
+                io_uring_sqe& sqe = sqes[slot];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode = IORING_OP_READV;
+                sqe.fd = file;
+                sqe.addr = reinterpret_cast<unsigned long>(&pending[i].vector);
+                sqe.len = 1;
+                sqe.off = pending[i].position;
+                sqe.user_data = i;
+                sqArray[slot] = slot;
+                ++tail;
+                ++inFlight;
+            }
+            __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+            if (inFlight == 0) break;
+
+            unsigned toSubmit = tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+            if (::syscall(__NR_io_uring_enter, fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0
+                && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                if (!broken) {
+                    // Take back the entries the kernel has not taken, and
+                    // keep reaping the reads it has taken.
+                    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+                    inFlight -= tail - head;
+                    __atomic_store_n(sqTail, head, __ATOMIC_RELEASE);
+                    broken = true;
+                    failed = true;
+                } else {
+                    std::this_thread::yield(); // the completions are still posted
+                }
+            }
+
+            // Reap the completions
+            unsigned cqeHead = *cqHead;
+            while (cqeHead != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& cqe = cqes[cqeHead & cqMask];
+                SizeT i = static_cast<SizeT>(cqe.user_data);
+                int result = cqe.res;
+                ++cqeHead;
+                --inFlight;
+                Pending& read = pending[i];
+                if (result == -EINTR || result == -EAGAIN) {
+                    queue.push_back(i);
+                } else if (result < 0) {
+                    failed = true;
+                } else if (result == 0) { // the end of the file
+                    std::memset(read.vector.iov_base, 0, read.vector.iov_len);
+                } else {
+                    read.vector.iov_base = static_cast<char*>(read.vector.iov_base) + result;
+                    read.vector.iov_len -= result;
+                    read.position += result;
+                    if (read.vector.iov_len > 0) queue.push_back(i);
+                }
+            }
+            __atomic_store_n(cqHead, cqeHead, __ATOMIC_RELEASE);
+        }
+        return !failed;
+    }
+};
+
+#else
+
+struct lau::AsyncReader::Ring_ {
+    bool broken = false;
+    bool SetUp(unsigned) { return false; }
+    bool Read(int, lau::ReadRequest*, SizeT) { return false; }
+};
+
+#endif
+
+/**
+ * @struct Pool_
+ *
+ * The pool of threads reading with <code>pread</code>.  A batch is put in
+ * the queue, and the threads (and the thread reading the batch) take the
+ * reads of the batch one by one.
+ */
+struct lau::AsyncReader::Pool_ {
+    struct Job {
+        lau::ReadRequest* requests;
+        SizeT count;
+        std::atomic<SizeT> next{0};
+        std::atomic<bool> failed{false};
+        SizeT users = 0; // the threads working on the job, guarded by the latch of the pool
+        std::condition_variable finished;
+    };
+
+    int file;
+    std::mutex latch;
+    std::condition_variable wake;
+    std::deque<Job*> jobs;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    Pool_(int file, SizeT threads) : file(file) {
+        for (SizeT i = 0; i < threads; ++i) workers.emplace_back([this] { Work(); });
+    }
+
+    ~Pool_() {
+        {
+            std::lock_guard<std::mutex> lock(latch);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    void Do(Job& job) {
+        for (SizeT i = job.next.fetch_add(1); i < job.count; i = job.next.fetch_add(1)) {
+            lau::ReadRequest& request = job.requests[i];
+            if (!ReadAll(file, request.buffer, request.length, request.position)) job.failed.store(true);
+        }
+    }
+
+    void Work() {
+        std::unique_lock<std::mutex> lock(latch);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            Job* job = jobs.front();
+            jobs.pop_front(); // the other threads take the next job
+            ++job->users;
+            lock.unlock();
+            Do(*job);
+            lock.lock();
+            if (--job->users == 0) job->finished.notify_all();
+        }
+    }
+
+    bool Read(lau::ReadRequest* requests, SizeT count) {
+        Job job;
+        job.requests = requests;
+        job.count = count;
+        {
+            // Put the job once for each helping thread
+            std::lock_guard<std::mutex> lock(latch);
+            SizeT helpers = std::min(static_cast<SizeT>(workers.size()), count - 1);
+            for (SizeT i = 0; i < helpers; ++i) jobs.push_back(&job);
+        }
+        wake.notify_all();
+        Do(job);
+        std::unique_lock<std::mutex> lock(latch);
+        jobs.erase(std::remove(jobs.begin(), jobs.end(), &job), jobs.end());
+        job.finished.wait(lock, [&job] { return job.users == 0; });
+        return !job.failed.load();
+    }
+};
+
+lau::AsyncReader::AsyncReader(const std::string& fileName, SizeT depth) : ownsFile_(true), depth_(depth) {
+    if (depth <= 0) {
+        throw lau::InvalidArgument("Invalid Argument: the depth is not positive");
+    }
+    fd_ = ::open(fileName.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        throw lau::RuntimeError("Runtime Error: cannot open the file");
+    }
+}
+
+lau::AsyncReader::AsyncReader(int fd, SizeT depth) : fd_(fd), depth_(depth) {
+    if (depth <= 0) {
+        throw lau::InvalidArgument("Invalid Argument: the depth is not positive");
+    }
+}
+
+lau::AsyncReader::~AsyncReader() {
+    idleRings_.clear();
+    pool_.reset();
+    if (ownsFile_ && fd_ >= 0) ::close(fd_);
+}
+
+void lau::AsyncReader::Read(ReadRequest* requests, SizeT count) {
+    if (count <= 0) return;
+    if (count == 1) { // nothing to wait for together
+        if (!ReadAll(fd_, requests->buffer, requests->length, requests->position)) {
+            throw lau::RuntimeError("Runtime Error: fail to read the file");
+        }
+        return;
+    }
+    std::unique_lock<std::mutex> lock(latch_);
+    if (!started_) Start_();
+    std::unique_ptr<Ring_> ring = TakeRing_(lock);
+    lock.unlock(); // the other threads read their batches with other rings or the pool
+    bool succeeded;
+    if (ring != nullptr) {
+        succeeded = ring->Read(fd_, requests, count);
+        lock.lock();
+        GiveBackRing_(std::move(ring));
+    } else {
+        succeeded = pool_->Read(requests, count);
+    }
+    if (!succeeded) throw lau::RuntimeError("Runtime Error: fail to read the file");
+}
+
+bool lau::AsyncReader::UsesIOUring() {
+    std::lock_guard<std::mutex> lock(latch_);
+    if (!started_) Start_();
+    return usesRing_;
+}
+
+void lau::AsyncReader::Start_() {
+    started_ = true;
+    auto ring = std::make_unique<Ring_>();
+    if (ring->SetUp(static_cast<unsigned>(std::min(depth_, 4096L)))) {
+        usesRing_ = true;
+        ringCount_ = 1;
+        ringLimit_ = std::max(static_cast<SizeT>(std::thread::hardware_concurrency()), 1L);
+        idleRings_.push_back(std::move(ring));
+        return;
+    }
+    pool_ = std::make_unique<Pool_>(fd_, depth_ - 1);
+}
+
+std::unique_ptr<lau::AsyncReader::Ring_> lau::AsyncReader::TakeRing_(std::unique_lock<std::mutex>& lock) {
+    while (usesRing_) {
+        if (!idleRings_.empty()) {
+            std::unique_ptr<Ring_> ring = std::move(idleRings_.back());
+            idleRings_.pop_back();
+            return ring;
+        }
+        if (ringCount_ < ringLimit_) {
+            auto ring = std::make_unique<Ring_>();
+            if (ring->SetUp(static_cast<unsigned>(std::min(depth_, 4096L)))) {
+                ++ringCount_;
+                return ring;
+            }
+            ringLimit_ = ringCount_; // e.g. out of locked memory, so wait for the rings set up
+        }
+        ringFree_.wait(lock);
+    }
+    return nullptr;
+}
+
+void lau::AsyncReader::GiveBackRing_(std::unique_ptr<Ring_> ring) {
+    if (ring->broken && usesRing_) { // the later batches are read by the pool
+        usesRing_ = false;
+        idleRings_.clear();
+        pool_ = std::make_unique<Pool_>(fd_, depth_ - 1);
+        ringFree_.notify_all();
+    }
+    if (!usesRing_) return; // the ring is dropped
+    idleRings_.push_back(std::move(ring));
+    ringFree_.notify_one();
+}
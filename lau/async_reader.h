@@ -0,0 +1,147 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/async_reader.h
+ *
+ * This is a external header file, including the
+ * <code>lau::AsyncReader</code> class and the <code>lau::ReadRequest</code>
+ * struct.
+ */
+
+#ifndef LAU_CPP_LIB_LAU_ASYNC_READER_H
+#define LAU_CPP_LIB_LAU_ASYNC_READER_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "type_traits.h"
+
+namespace lau {
+
+/**
+ * @struct ReadRequest{buffer, position, length}
+ *
+ * A read of <code>length</code> bytes at <code>position</code> of a file
+ * into <code>buffer</code>, which is sent to <code>ReadBatch</code> of the
+ * storages together with other reads.
+ */
+struct ReadRequest {
+    char* buffer;
+    long  position;
+    SizeT length;
+};
+
+/**
+ * @class AsyncReader
+ *
+ * A reader of a file that keeps many reads in flight at the same time, so
+ * that deep storage devices (e.g. NVMe SSDs) are kept busy.  On Linux, the
+ * reads are sent to io_uring if the kernel supports it; otherwise (or if
+ * <code>LAU_CPP_LIB_NO_IO_URING</code> is defined) they are done by a pool
+ * of threads with <code>pread</code>.  The ring or the threads are set up
+ * when the first batch is read.
+ * <br><br>
+ * <code>Read</code> can be called by several threads at the same time.
+ * With io_uring, each batch takes a ring of its own, and the rings are
+ * kept for the later batches (at most one for each hardware thread).
+ */
+class AsyncReader {
+public:
+    /**
+     * Open the file for reading.
+     * @param fileName
+     * @param depth the largest number of reads in flight
+     * @throw lau::InvalidArgument if the depth is not positive
+     * @throw lau::RuntimeError if the file cannot be opened
+     */
+    explicit AsyncReader(const std::string& fileName, SizeT depth = 32);
+
+    /**
+     * Read a file that is opened.  The file descriptor is not closed by
+     * the reader.
+     * @param fd the file descriptor
+     * @param depth the largest number of reads in flight
+     * @throw lau::InvalidArgument if the depth is not positive
+     */
+    explicit AsyncReader(int fd, SizeT depth = 32);
+
+    AsyncReader(const AsyncReader&) = delete;
+
+    AsyncReader& operator=(const AsyncReader&) = delete;
+
+    ~AsyncReader();
+
+    /**
+     * Do a batch of reads and wait for all of them.  The part of a read
+     * beyond the end of the file is filled with 0.
+     * @param requests
+     * @param count the number of requests
+     * @throw lau::RuntimeError if a read fails
+     */
+    void Read(ReadRequest* requests, SizeT count);
+
+    /**
+     * Tell whether the reads are sent to io_uring.
+     * @return the boolean of whether io_uring is used
+     */
+    [[nodiscard]] bool UsesIOUring();
+
+private:
+    struct Ring_;
+    struct Pool_;
+
+    /**
+     * Set up io_uring, or the pool of threads if io_uring is not
+     * available.  The latch must be held.
+     */
+    void Start_();
+
+    /**
+     * Take a ring that no other thread is using, setting up a new one or
+     * waiting for one if all of them are in use.  The latch must be held.
+     * @param lock the lock of the latch
+     * @return the ring, or nullptr if the pool of threads is used
+     */
+    std::unique_ptr<Ring_> TakeRing_(std::unique_lock<std::mutex>& lock);
+
+    /**
+     * Give back a ring taken by <code>TakeRing_</code>.  If the ring is
+     * broken, it is dropped and the later batches are read by the pool of
+     * threads.  The latch must be held.
+     * @param ring
+     */
+    void GiveBackRing_(std::unique_ptr<Ring_> ring);
+
+    int fd_ = -1;
+    bool ownsFile_ = false;
+    SizeT depth_;
+    std::mutex latch_; // guards the rings and the setup
+    std::condition_variable ringFree_;
+    bool started_ = false;
+    bool usesRing_ = false;
+    SizeT ringCount_ = 0; // the rings set up, including the ones in use
+    SizeT ringLimit_ = 1;
+    std::vector<std::unique_ptr<Ring_>> idleRings_; // a ring can only be used by one thread
+    std::unique_ptr<Pool_> pool_;
+};
+
+} // namespace lau
+
+#endif // LAU_CPP_LIB_LAU_ASYNC_READER_H
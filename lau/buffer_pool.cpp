@@ -0,0 +1,393 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/buffer_pool.cpp
+ *
+ * This is a internal source file, including the implementation of the
+ * <code>lau::BufferPool</code> class.
+ */
+
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "async_reader.h"
+#include "exception.h"
+#include "type_traits.h"
+
+namespace {
+
+/**
+ * Read the buffer at the position, retrying short reads.  The part beyond
+ * the end of the file is filled with 0.
+ * @return whether the read is successful
+ */
+bool ReadAll(int fd, char* data, SizeT length, long position) {
+    while (length > 0) {
+        ssize_t size = ::pread(fd, data, length, position);
+        if (size < 0 && errno == EINTR) continue;
+        if (size < 0) return false;
+        if (size == 0) break;
+        data += size;
+        length -= size;
+        position += size;
+    }
+    if (length > 0) std::memset(data, 0, length);
+    return true;
+}
+
+/**
+ * Write the buffer at the position, retrying short writes.
+ * @return whether the write is successful
+ */
+bool WriteAll(int fd, const char* data, SizeT length, long position) {
+    while (length > 0) {
+        ssize_t size = ::pwrite(fd, data, length, position);
+        if (size < 0 && errno == EINTR) continue;
+        if (size <= 0) return false;
+        data += size;
+        length -= size;
+        position += size;
+    }
+    return true;
+}
+
+} // namespace
+
+lau::BufferPool::BufferPool(const std::string& fileName, SizeT memoryBudget, SizeT pageSize, bool direct)
+    : fileName_(fileName), direct_(direct), pageSize_(pageSize), capacity_(std::max(memoryBudget / std::max(pageSize, 1L), 1L)) {
+    if (pageSize <= 0) {
+        throw lau::InvalidArgument("Invalid Argument: the page size is not positive");
+    }
+    if (direct && pageSize % kDirectAlignment_ != 0) {
+        throw lau::InvalidArgument("Invalid Argument: the page size is not a multiple of 4 KiB");
+    }
+    int flags = O_RDWR;
+#ifdef O_DIRECT
+    if (direct) flags |= O_DIRECT;
+#endif
+    fd_ = ::open(fileName.c_str(), flags);
+    if (fd_ < 0) {
+        throw lau::RuntimeError("Runtime Error: cannot open the file");
+    }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    if (direct && ::fcntl(fd_, F_NOCACHE, 1) != 0) {
+        ::close(fd_);
+        throw lau::RuntimeError("Runtime Error: cannot open the file");
+    }
+#endif
+    struct stat status{};
+    if (::fstat(fd_, &status) != 0) {
+        ::close(fd_);
+        throw lau::RuntimeError("Runtime Error: cannot get the size of the file");
+    }
+    fileEnd_ = status.st_size;
+
+    // Direct I/O can only read and write whole pages, so the last page of
+    // the file is completed
+    if (direct && fileEnd_ % pageSize_ != 0) {
+        fileEnd_ = (fileEnd_ / pageSize_ + 1) * pageSize_;
+        if (::ftruncate(fd_, fileEnd_) != 0) {
+            ::close(fd_);
+            throw lau::RuntimeError("Runtime Error: cannot extend the file");
+        }
+    }
+    end_ = fileEnd_;
+}
+
+lau::BufferPool::BufferPool(BufferPool&& obj) noexcept
+    : fileName_(std::move(obj.fileName_)), fd_(obj.fd_), direct_(obj.direct_), readLatch_(std::move(obj.readLatch_)), reader_(std::move(obj.reader_)),
+      pages_(std::move(obj.pages_)), table_(std::move(obj.table_)), pageSize_(obj.pageSize_),
+      capacity_(obj.capacity_), end_(obj.end_), fileEnd_(obj.fileEnd_), buffer_(std::move(obj.buffer_)) {
+    obj.fd_ = -1;
+}
+
+lau::BufferPool& lau::BufferPool::operator=(BufferPool&& obj) noexcept {
+    if (this == &obj) return *this;
+    Close_();
+    fileName_ = std::move(obj.fileName_);
+    fd_ = obj.fd_;
+    direct_ = obj.direct_;
+    readLatch_ = std::move(obj.readLatch_);
+    reader_ = std::move(obj.reader_);
+    pages_ = std::move(obj.pages_);
+    table_ = std::move(obj.table_);
+    pageSize_ = obj.pageSize_;
+    capacity_ = obj.capacity_;
+    end_ = obj.end_;
+    fileEnd_ = obj.fileEnd_;
+    buffer_ = std::move(obj.buffer_);
+    obj.fd_ = -1;
+    return *this;
+}
+
+lau::BufferPool::~BufferPool() {
+    Close_();
+}
+
+void lau::BufferPool::Read(char* buffer, Ptr position, SizeT length) {
+    while (length > 0) {
+        SizeT offset = position % pageSize_;
+        SizeT size = std::min(length, pageSize_ - offset);
+        ReadPage_(position / pageSize_, offset, buffer, size);
+        buffer += size;
+        position += size;
+        length -= size;
+    }
+}
+
+void lau::BufferPool::ReadBatch(ReadRequest* requests, SizeT count) {
+    // Find the pages in the file that are not in the pool
+    std::vector<SizeT> missing;
+    Ptr fileEnd;
+    AsyncReader* reader = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(*readLatch_);
+        for (SizeT i = 0; i < count; ++i) {
+            if (requests[i].length <= 0) continue;
+            SizeT last = std::min(requests[i].position + requests[i].length, fileEnd_) - 1;
+            for (SizeT number = requests[i].position / pageSize_; number * pageSize_ <= last; ++number) {
+                if (table_.find(number) == table_.end()) missing.push_back(number);
+            }
+        }
+        fileEnd = fileEnd_;
+        if (!missing.empty()) {
+            if (reader_ == nullptr) reader_ = std::make_unique<AsyncReader>(fd_);
+            reader = reader_.get();
+        }
+    }
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+    if (static_cast<SizeT>(missing.size()) > capacity_) missing.resize(capacity_);
+
+    if (!missing.empty()) {
+        // Load the pages without the latch, so that the other threads can
+        // read the pages in the pool meanwhile
+        std::vector<PageData_> data;
+        std::vector<ReadRequest> loads;
+        for (SizeT number : missing) {
+            data.push_back(NewData_());
+            SizeT size = LoadSize_(number, fileEnd);
+            std::memset(data.back().get() + size, 0, pageSize_ - size);
+            loads.push_back(ReadRequest{data.back().get(), number * pageSize_, size});
+        }
+        reader->Read(loads.data(), static_cast<SizeT>(loads.size()));
+
+        std::lock_guard<std::mutex> lock(*readLatch_);
+        for (SizeT i = 0; i < static_cast<SizeT>(missing.size()); ++i) PutPage_(missing[i], std::move(data[i]));
+    }
+
+    for (SizeT i = 0; i < count; ++i) Read(requests[i].buffer, requests[i].position, requests[i].length);
+}
+
+void lau::BufferPool::ReadPage_(SizeT number, SizeT offset, char* buffer, SizeT size) {
+    Ptr fileEnd;
+    {
+        std::lock_guard<std::mutex> lock(*readLatch_);
+        auto iter = table_.find(number);
+        if (iter != table_.end()) {
+            pages_.splice(pages_.begin(), pages_, iter->second);
+            std::memcpy(buffer, pages_.front().data.get() + offset, size);
+            return;
+        }
+        fileEnd = fileEnd_;
+    }
+
+    // Load the page without the latch.  Nothing is written while reading,
+    // and a modified page is written back before it leaves the pool, so
+    // the page in the file is up to date.
+    PageData_ data = NewData_();
+    SizeT loadSize = LoadSize_(number, fileEnd);
+    if (!ReadAll(fd_, data.get(), loadSize, number * pageSize_)) {
+        throw lau::RuntimeError("Runtime Error: fail to read the file");
+    }
+    std::memset(data.get() + loadSize, 0, pageSize_ - loadSize);
+
+    std::lock_guard<std::mutex> lock(*readLatch_);
+    Page_& page = PutPage_(number, std::move(data));
+    std::memcpy(buffer, page.data.get() + offset, size);
+}
+
+void lau::BufferPool::Write(const char* source, Ptr position, SizeT length) {
+    if (position + length > end_) end_ = position + length;
+    while (length > 0) {
+        Page_& page = GetPage_(position / pageSize_);
+        SizeT offset = position % pageSize_;
+        SizeT size = std::min(length, pageSize_ - offset);
+        std::memcpy(page.data.get() + offset, source, size);
+        page.dirty = true;
+        source += size;
+        position += size;
+        length -= size;
+    }
+}
+
+void lau::BufferPool::Move(Ptr source, Ptr target, SizeT length) {
+    if (length <= 0) return;
+    if (static_cast<SizeT>(buffer_.size()) < length) buffer_.resize(length);
+    Read(buffer_.data(), source, length);
+    Write(buffer_.data(), target, length);
+}
+
+void lau::BufferPool::Prefetch(Ptr, SizeT) {}
+
+lau::BufferPool::Ptr lau::BufferPool::Allocate(SizeT length) {
+    Ptr position = end_;
+    end_ += length;
+    return position;
+}
+
+void lau::BufferPool::EndOperation() {}
+
+void lau::BufferPool::Flush() {
+    if (fd_ < 0) return;
+
+    // Write back the pages in the order of their places to make the writes
+    // sequential
+    std::vector<Page_*> dirtyPages;
+    for (auto& page : pages_) {
+        if (page.dirty) dirtyPages.push_back(&page);
+    }
+    std::sort(dirtyPages.begin(), dirtyPages.end(),
+              [](const Page_* lhs, const Page_* rhs) { return lhs->number < rhs->number; });
+    for (auto* page : dirtyPages) WriteBack_(*page);
+
+    // Make sure that the allocated space really exists in the file
+    if (fileEnd_ < end_) {
+        Ptr end = direct_ ? (end_ + pageSize_ - 1) / pageSize_ * pageSize_ : end_;
+        if (::ftruncate(fd_, end) != 0) throw lau::RuntimeError("Runtime Error: cannot extend the file");
+        fileEnd_ = end;
+    }
+}
+
+bool lau::BufferPool::Empty() const noexcept {
+    return end_ == 0;
+}
+
+SizeT lau::BufferPool::Alignment() const noexcept {
+    return direct_ ? pageSize_ : 1;
+}
+
+const std::string& lau::BufferPool::FileName() const noexcept {
+    return fileName_;
+}
+
+lau::BufferPool::Page_& lau::BufferPool::GetPage_(SizeT number) {
+    auto iter = table_.find(number);
+    if (iter != table_.end()) {
+        pages_.splice(pages_.begin(), pages_, iter->second);
+        return pages_.front();
+    }
+
+    // Load the page (the part beyond the end of the file is filled with 0)
+    Page_& page = NewPage_(number);
+    SizeT size = LoadSize_(number, fileEnd_);
+    if (!ReadAll(fd_, page.data.get(), size, number * pageSize_)) {
+        DropPage_(number);
+        throw lau::RuntimeError("Runtime Error: fail to read the file");
+    }
+    std::memset(page.data.get() + size, 0, pageSize_ - size);
+    return page;
+}
+
+lau::BufferPool::Page_& lau::BufferPool::NewPage_(SizeT number, PageData_ data) {
+    // Evict the least recently used page
+    if (static_cast<SizeT>(pages_.size()) >= capacity_) {
+        Page_& victim = pages_.back();
+        WriteBack_(victim);
+        table_.erase(victim.number);
+        pages_.splice(pages_.begin(), pages_, std::prev(pages_.end()));
+        if (data != nullptr) pages_.front().data = std::move(data);
+    } else {
+        pages_.push_front(Page_{0, false, data != nullptr ? std::move(data) : NewData_()});
+    }
+
+    Page_& page = pages_.front();
+    page.number = number;
+    page.dirty = false;
+    table_[number] = pages_.begin();
+    return page;
+}
+
+lau::BufferPool::Page_& lau::BufferPool::PutPage_(SizeT number, PageData_ data) {
+    // Another thread may have loaded the page meanwhile
+    auto iter = table_.find(number);
+    if (iter != table_.end()) {
+        pages_.splice(pages_.begin(), pages_, iter->second);
+        return pages_.front();
+    }
+    return NewPage_(number, std::move(data));
+}
+
+lau::BufferPool::PageData_ lau::BufferPool::NewData_() const {
+    // The buffers of direct I/O must be aligned, and std::aligned_alloc
+    // needs a size that is a multiple of the alignment
+    SizeT size = (pageSize_ + kDirectAlignment_ - 1) / kDirectAlignment_ * kDirectAlignment_;
+    auto* data = static_cast<char*>(std::aligned_alloc(kDirectAlignment_, size));
+    if (data == nullptr) throw std::bad_alloc();
+    return PageData_(data);
+}
+
+SizeT lau::BufferPool::LoadSize_(SizeT number, Ptr fileEnd) const {
+    Ptr start = number * pageSize_;
+    if (start >= fileEnd) return 0;
+    return direct_ ? pageSize_ : std::min(pageSize_, fileEnd - start);
+}
+
+void lau::BufferPool::DropPage_(SizeT number) {
+    auto iter = table_.find(number);
+    if (iter == table_.end()) return;
+    pages_.erase(iter->second);
+    table_.erase(iter);
+}
+
+void lau::BufferPool::WriteBack_(Page_& page) {
+    if (!page.dirty) return;
+    Ptr start = page.number * pageSize_;
+    SizeT size = direct_ ? pageSize_ : std::min(pageSize_, end_ - start);
+    if (!WriteAll(fd_, page.data.get(), size, start)) {
+        throw lau::RuntimeError("Runtime Error: cannot write the file");
+    }
+    if (start + size > fileEnd_) fileEnd_ = start + size;
+    page.dirty = false;
+}
+
+void lau::BufferPool::Close_() noexcept {
+    if (fd_ < 0) return;
+    try {
+        Flush();
+    } catch (...) {
+        // Nothing can be reported when the pool is destroyed, so call
+        // Flush first to know whether the pages are written back
+    }
+    reader_.reset();
+    ::close(fd_);
+    fd_ = -1;
+}
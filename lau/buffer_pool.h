@@ -0,0 +1,328 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/buffer_pool.h
+ *
+ * This is a external header file, including the
+ * <code>lau::BufferPool</code> and <code>lau::DirectBufferPool</code>
+ * classes.
+ */
+
+#ifndef LAU_CPP_LIB_LAU_BUFFER_POOL_H
+#define LAU_CPP_LIB_LAU_BUFFER_POOL_H
+
+#include <cstdlib>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "async_reader.h"
+#include "type_traits.h"
+
+namespace lau {
+
+/**
+ * @class BufferPool
+ *
+ * A storage of the data structures based on files that caches the pages
+ * of the file in memory.  When the memory budget is used up, the least
+ * recently used page is evicted, and it is written back to the file if it
+ * has been modified.  The modified pages are also written back when
+ * <code>Flush</code> is called or the pool is destroyed.
+ * <br><br>
+ * In the direct mode (see <code>lau::DirectBufferPool</code>), the file is
+ * opened with <code>O_DIRECT</code>, so the pages are read and written
+ * whole between the device and the pool without being cached by the
+ * system as well.  The file is then always a multiple of pages long.
+ */
+class BufferPool {
+public:
+    using Ptr = long;
+
+    /**
+     * Open the file.  Please make sure that the file does exist.
+     * @param fileName
+     * @param memoryBudget the maximum bytes of the cached pages, 16 MiB
+     * by default (at least one page is cached)
+     * @param pageSize the size of a page, 4 KiB by default
+     * @param direct whether to use the direct mode
+     * @throw lau::InvalidArgument if the page size is not positive, or
+     * it is not a multiple of 4 KiB in the direct mode
+     * @throw lau::RuntimeError if the file cannot be opened (e.g. the file
+     * system does not support direct I/O)
+     */
+    explicit BufferPool(const std::string& fileName, SizeT memoryBudget = 16 * 1024 * 1024, SizeT pageSize = 4096,
+                        bool direct = false);
+
+    BufferPool(BufferPool&& obj) noexcept;
+
+    BufferPool(const BufferPool&) = delete;
+
+    BufferPool& operator=(BufferPool&& obj) noexcept;
+
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    ~BufferPool();
+
+    /**
+     * Read a string of stuff from the pool.  It is safe to read in several
+     * threads at the same time: the pool is guarded by a latch, which is
+     * not held while a page is loaded from the file.
+     * @param buffer the place to put the data
+     * @param position the place to get the data
+     * @param length
+     * @throw lau::RuntimeError if a page cannot be loaded, or a modified
+     * page cannot be written back when it is evicted
+     */
+    void Read(char* buffer, Ptr position, SizeT length);
+
+    /**
+     * Read a batch of strings of stuff from the pool.  The pages that are
+     * not in the pool are loaded at once with the reads in flight at the
+     * same time (see <code>lau::AsyncReader</code>), as many as the pool
+     * can keep, without holding the latch of the pool.  It is safe to read
+     * in several threads at the same time.
+     * @param requests
+     * @param count the number of requests
+     * @throw lau::RuntimeError if a page cannot be loaded, or a modified
+     * page cannot be written back when it is evicted
+     */
+    void ReadBatch(ReadRequest* requests, SizeT count);
+
+    /**
+     * Write a string of stuff to the pool.  The data will not be written
+     * to the file until the page is evicted or flushed.
+     * @param source the source pointer
+     * @param position the place to place the data
+     * @param length
+     * @throw lau::RuntimeError if a page cannot be loaded, or a modified
+     * page cannot be written back when it is evicted
+     */
+    void Write(const char* source, Ptr position, SizeT length);
+
+    /**
+     * Move a string of stuff to another place of the file.  The source
+     * and the target may overlap.
+     * @param source the place of the data
+     * @param target the new place of the data
+     * @param length
+     */
+    void Move(Ptr source, Ptr target, SizeT length);
+
+    /**
+     * Tell the storage that the data will be read soon.  Nothing needs
+     * to be done for this storage.
+     * @param position the place of the data
+     * @param length
+     */
+    void Prefetch(Ptr position, SizeT length);
+
+    /**
+     * Get a new space at the end of the file.
+     * @param length the length of the new space
+     * @return the place of the new space
+     */
+    Ptr Allocate(SizeT length);
+
+    /**
+     * Mark the end of an operation.  Nothing needs to be done for this
+     * storage.
+     */
+    void EndOperation();
+
+    /**
+     * Write all the modified pages back to the file.  The pages that
+     * cannot be written stay modified.
+     * @throw lau::RuntimeError if a page cannot be written back or the
+     * file cannot be extended
+     */
+    void Flush();
+
+    /**
+     * Tell whether the file is empty.
+     * @return the boolean of whether the file is empty
+     */
+    [[nodiscard]] bool Empty() const noexcept;
+
+    /**
+     * Get the size that the places and the lengths of the data are best
+     * aligned to, which is the page size in the direct mode.
+     * @return the size (1 if there is no need to align)
+     */
+    [[nodiscard]] SizeT Alignment() const noexcept;
+
+    /**
+     * Get the name of the file, so that the data structures based on files
+     * can find the files they keep beside it.
+     * @return the name of the file
+     */
+    [[nodiscard]] const std::string& FileName() const noexcept;
+
+private:
+    constexpr static SizeT kDirectAlignment_ = 4096; // the alignment of the buffers for direct I/O
+
+    /**
+     * @struct FreeData_
+     *
+     * The deleter of the data of the pages, which are allocated by
+     * <code>std::aligned_alloc</code>.
+     */
+    struct FreeData_ {
+        void operator()(char* data) const noexcept { std::free(data); }
+    };
+
+    using PageData_ = std::unique_ptr<char, FreeData_>;
+
+    /**
+     * @struct Page_{number, dirty, data}
+     *
+     * A page cached in memory.
+     */
+    struct Page_ {
+        SizeT number;
+        bool dirty;
+        PageData_ data;
+    };
+
+    /**
+     * Get the page with the number and move it to the front of the LRU
+     * list.  The page will be loaded if it is not in the pool.
+     * @param number
+     * @return the page
+     * @throw lau::RuntimeError if the page cannot be loaded, or the page
+     * evicted cannot be written back
+     */
+    Page_& GetPage_(SizeT number);
+
+    /**
+     * Put a page with the number at the front of the LRU list, evicting
+     * the least recently used page if the pool is full.
+     * @param number
+     * @param data the data of the page, or nullptr to leave the data not
+     * loaded
+     * @return the page
+     * @throw lau::RuntimeError if the page evicted cannot be written back
+     */
+    Page_& NewPage_(SizeT number, PageData_ data = nullptr);
+
+    /**
+     * Put a page loaded without the read latch into the pool, unless
+     * another thread has put it in meanwhile.  The read latch must be
+     * held.
+     * @param number
+     * @param data the data of the page
+     * @return the page in the pool
+     * @throw lau::RuntimeError if the page evicted cannot be written back
+     */
+    Page_& PutPage_(SizeT number, PageData_ data);
+
+    /**
+     * Allocate the data of a page, aligned for direct I/O.
+     * @return the data
+     */
+    [[nodiscard]] PageData_ NewData_() const;
+
+    /**
+     * Get the number of bytes of a page to read from the file.
+     * @param number
+     * @param fileEnd the end of the data in the file
+     * @return the number of bytes
+     */
+    [[nodiscard]] SizeT LoadSize_(SizeT number, Ptr fileEnd) const;
+
+    /**
+     * Remove the page with the number from the pool without writing it
+     * back, if it is in the pool.
+     * @param number
+     */
+    void DropPage_(SizeT number);
+
+    /**
+     * Read a part of a page.  The read latch is held only while the pool
+     * is looked up and changed, and not while the page is read from the
+     * file.
+     * @param number
+     * @param offset the place of the part in the page
+     * @param buffer the place to put the data
+     * @param size the size of the part
+     * @throw lau::RuntimeError if the page cannot be loaded, or a modified
+     * page cannot be written back when it is evicted
+     */
+    void ReadPage_(SizeT number, SizeT offset, char* buffer, SizeT size);
+
+    /**
+     * Write the page back to the file if it is modified.  The page stays
+     * modified if it cannot be written.
+     * @param page
+     * @throw lau::RuntimeError if the page cannot be written
+     */
+    void WriteBack_(Page_& page);
+
+    /**
+     * Close the file after writing back all the modified pages.  The
+     * errors of writing back are ignored.
+     */
+    void Close_() noexcept;
+
+    std::string fileName_;
+    int fd_ = -1;
+    bool direct_ = false;
+    std::unique_ptr<std::mutex> readLatch_ = std::make_unique<std::mutex>(); // guards the pool while reading
+    std::unique_ptr<AsyncReader> reader_; // set up when the first batch is read
+    std::list<Page_> pages_; // the most recently used page is at the front
+    std::unordered_map<SizeT, std::list<Page_>::iterator> table_;
+    SizeT pageSize_;
+    SizeT capacity_; // the maximum number of pages
+    Ptr end_ = 0; // the end of the file, including the allocated space
+    Ptr fileEnd_ = 0; // the end of the data that is really in the file
+    std::vector<char> buffer_; // the buffer for moving data
+};
+
+/**
+ * @class DirectBufferPool
+ *
+ * A <code>lau::BufferPool</code> in the direct mode, so that it can be
+ * used as the storage of the data structures based on files that open the
+ * file by its name (e.g. when the file is compacted).  The data structures
+ * align their blocks to the pages (see <code>Alignment</code>).
+ */
+class DirectBufferPool : public BufferPool {
+public:
+    /**
+     * Open the file in the direct mode.  Please make sure that the file
+     * does exist.
+     * @param fileName
+     * @param memoryBudget the maximum bytes of the cached pages, 16 MiB
+     * by default (at least one page is cached)
+     * @param pageSize the size of a page, 4 KiB by default, which MUST be
+     * a multiple of 4 KiB
+     * @throw lau::InvalidArgument if the page size is not a multiple of
+     * 4 KiB
+     * @throw lau::RuntimeError if the file cannot be opened (e.g. the file
+     * system does not support direct I/O)
+     */
+    explicit DirectBufferPool(const std::string& fileName, SizeT memoryBudget = 16 * 1024 * 1024,
+                              SizeT pageSize = 4096)
+        : BufferPool(fileName, memoryBudget, pageSize, true) {}
+};
+
+} // namespace lau
+
+#endif // LAU_CPP_LIB_LAU_BUFFER_POOL_H
@@ -0,0 +1,273 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/**
+ * @file lau/clock_cache.h
+ *
+ * This is a external header file, including a
+ * <code>lau::ClockCache</code> class.
+ */
+
+#ifndef LAU_CPP_LIB_LAU_CLOCK_CACHE_H
+#define LAU_CPP_LIB_LAU_CLOCK_CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "type_traits.h"
+
+namespace lau {
+
+/**
+ * @class ClockCache
+ *
+ * A cache of key-value pairs with a fixed capacity, which evicts the pairs
+ * with the CLOCK algorithm: every pair has a reference bit set by
+ * <code>Get</code>, and a hand going round the pairs clears the bits and
+ * evicts the first pair whose bit is clear.  The numbers of hits and
+ * misses are counted to help choose the capacity.
+ * <br><br>
+ * <code>Get</code> only sets the bit and counts with atomic operations
+ * instead of moving the pair to the front of a list, so it can be called
+ * by several threads at the same time, as long as no other function is
+ * running.
+ * <br><br>
+ * The key only needs to be comparable by <code>Compare</code>, so that
+ * any key of the data structures based on files can be cached.
+ *
+ * @tparam Key the key type
+ * @tparam Value the value type
+ * @tparam Compare the class that compares two keys
+ */
+template<class Key, class Value, class Compare = std::less<Key>>
+class ClockCache {
+public:
+    /**
+     * Construct an empty cache.
+     * @param capacity the maximum number of pairs (0 to disable the cache)
+     */
+    explicit ClockCache(SizeT capacity = 64) : capacity_(capacity) {}
+
+    ClockCache(const ClockCache& obj)
+        : table_(obj.table_), hand_(obj.hand_), capacity_(obj.capacity_), retiredHits_(obj.retiredHits_),
+          misses_(obj.misses_.load(std::memory_order_relaxed)) {
+        slots_.reserve(obj.slots_.size());
+        for (const auto& slot : obj.slots_) slots_.push_back(std::make_unique<Slot_>(*slot));
+    }
+
+    ClockCache(ClockCache&& obj) noexcept
+        : slots_(std::move(obj.slots_)), table_(std::move(obj.table_)), hand_(obj.hand_),
+          capacity_(obj.capacity_), retiredHits_(obj.retiredHits_),
+          misses_(obj.misses_.load(std::memory_order_relaxed)) {}
+
+    ClockCache& operator=(const ClockCache& obj) {
+        if (this == &obj) return *this;
+        ClockCache tmp(obj);
+        return *this = std::move(tmp);
+    }
+
+    ClockCache& operator=(ClockCache&& obj) noexcept {
+        if (this == &obj) return *this;
+        slots_ = std::move(obj.slots_);
+        table_ = std::move(obj.table_);
+        hand_ = obj.hand_;
+        capacity_ = obj.capacity_;
+        retiredHits_ = obj.retiredHits_;
+        misses_.store(obj.misses_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    ~ClockCache() = default;
+
+    /**
+     * Get the cached value of the key, and set its reference bit.  A hit
+     * or a miss is counted.  It can be called by several threads at the
+     * same time.
+     * @param key
+     * @return the pointer to the cached value, or nullptr if the key is not
+     * cached.  The pointer is valid until the cache is modified.
+     */
+    const Value* Get(const Key& key) {
+        auto iter = table_.find(key);
+        if (iter == table_.end()) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Slot_& slot = *slots_[iter->second];
+        // The hits are counted in the slots, so that the threads getting
+        // different keys do not write the same cache line
+        slot.hits.fetch_add(1, std::memory_order_relaxed);
+        if (!slot.referenced.load(std::memory_order_relaxed)) slot.referenced.store(true, std::memory_order_relaxed);
+        return &(slot.value);
+    }
+
+    /**
+     * Cache a key-value pair, or update the value if the key is cached
+     * (and set its reference bit).  If the cache is full, a pair is
+     * evicted by the hand.
+     * @param key
+     * @param value
+     */
+    void Put(const Key& key, const Value& value) {
+        if (capacity_ <= 0) return;
+        auto iter = table_.find(key);
+        if (iter != table_.end()) {
+            Slot_& slot = *slots_[iter->second];
+            slot.value = value;
+            slot.referenced.store(true, std::memory_order_relaxed);
+            return;
+        }
+        if (static_cast<SizeT>(slots_.size()) < capacity_) {
+            slots_.push_back(std::make_unique<Slot_>(key, value));
+            table_.emplace(key, static_cast<SizeT>(slots_.size()) - 1);
+            return;
+        }
+
+        // Reuse the slot of the pair evicted, and let the new pair go
+        // round once before it can be evicted
+        SizeT victim = Sweep_();
+        Slot_& slot = *slots_[victim];
+        table_.erase(slot.key);
+        retiredHits_ += slot.hits.load(std::memory_order_relaxed);
+        slot.key = key;
+        slot.value = value;
+        slot.hits.store(0, std::memory_order_relaxed);
+        table_.emplace(key, victim);
+        hand_ = (victim + 1) % static_cast<SizeT>(slots_.size());
+    }
+
+    /**
+     * Remove the key from the cache if it is cached.
+     * @param key
+     */
+    void Erase(const Key& key) {
+        auto iter = table_.find(key);
+        if (iter == table_.end()) return;
+        SizeT position = iter->second;
+        table_.erase(iter);
+        Remove_(position);
+    }
+
+    /**
+     * Remove all the pairs.  The numbers of hits and misses are kept.
+     */
+    void Clear() {
+        for (const auto& slot : slots_) retiredHits_ += slot->hits.load(std::memory_order_relaxed);
+        slots_.clear();
+        table_.clear();
+        hand_ = 0;
+    }
+
+    /**
+     * Change the capacity.  Pairs are evicted by the hand if there are too
+     * many pairs.
+     * @param capacity the maximum number of pairs (0 to disable the cache)
+     */
+    void Resize(SizeT capacity) {
+        capacity_ = capacity;
+        while (static_cast<SizeT>(slots_.size()) > std::max(capacity_, 0L)) {
+            SizeT victim = Sweep_();
+            table_.erase(slots_[victim]->key);
+            Remove_(victim);
+        }
+    }
+
+    /**
+     * Set the numbers of hits and misses to 0.
+     */
+    void ResetStatistics() noexcept {
+        for (const auto& slot : slots_) slot->hits.store(0, std::memory_order_relaxed);
+        retiredHits_ = 0;
+        misses_.store(0, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] SizeT Size()     const noexcept { return static_cast<SizeT>(slots_.size()); }
+    [[nodiscard]] SizeT Capacity() const noexcept { return capacity_; }
+    [[nodiscard]] SizeT Misses()   const noexcept { return misses_.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] SizeT Hits() const noexcept {
+        SizeT hits = retiredHits_;
+        for (const auto& slot : slots_) hits += slot->hits.load(std::memory_order_relaxed);
+        return hits;
+    }
+
+private:
+    /**
+     * @struct Slot_{key, value, referenced, hits}
+     *
+     * A cached pair.  The slots are kept in the heap so that the pointers
+     * returned by <code>Get</code> stay valid when other slots are added.
+     */
+    struct Slot_ {
+        Slot_(const Key& key, const Value& value) : key(key), value(value) {}
+
+        Slot_(const Slot_& obj)
+            : key(obj.key), value(obj.value), referenced(obj.referenced.load(std::memory_order_relaxed)),
+              hits(obj.hits.load(std::memory_order_relaxed)) {}
+
+        Key                key;
+        Value              value;
+        std::atomic<bool>  referenced{false};
+        std::atomic<SizeT> hits{0};
+    };
+
+    /**
+     * Move the hand to the first slot whose reference bit is clear,
+     * clearing the bits on its way.  The cache must not be empty.
+     * @return the position of the slot
+     */
+    SizeT Sweep_() {
+        SizeT size = static_cast<SizeT>(slots_.size());
+        if (hand_ >= size) hand_ = 0;
+        while (slots_[hand_]->referenced.load(std::memory_order_relaxed)) {
+            slots_[hand_]->referenced.store(false, std::memory_order_relaxed);
+            hand_ = (hand_ + 1) % size;
+        }
+        return hand_;
+    }
+
+    /**
+     * Remove the slot at the position, whose key has been removed from the
+     * table, by moving the last slot to its place.
+     * @param position
+     */
+    void Remove_(SizeT position) {
+        retiredHits_ += slots_[position]->hits.load(std::memory_order_relaxed);
+        if (position != static_cast<SizeT>(slots_.size()) - 1) {
+            slots_[position] = std::move(slots_.back());
+            table_[slots_[position]->key] = position;
+        }
+        slots_.pop_back();
+        if (hand_ >= static_cast<SizeT>(slots_.size())) hand_ = 0;
+    }
+
+    std::vector<std::unique_ptr<Slot_>> slots_;
+    std::map<Key, SizeT, Compare> table_; // the positions of the slots
+    SizeT hand_ = 0;
+    SizeT capacity_;
+    SizeT retiredHits_ = 0; // the hits of the pairs no longer cached
+    std::atomic<SizeT> misses_{0};
+};
+
+} // namespace lau
+
+#endif // LAU_CPP_LIB_LAU_CLOCK_CACHE_H
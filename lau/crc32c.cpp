@@ -0,0 +1,107 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/crc32c.cpp
+ *
+ * This is a internal source file, including the implementation of the
+ * <code>lau::Crc32c</code> function.
+ */
+
+#include "crc32c.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define LAU_CPP_LIB_CRC32C_SSE42
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define LAU_CPP_LIB_CRC32C_ARM
+#endif
+
+#include "type_traits.h"
+
+namespace {
+
+constexpr std::uint32_t kPolynomial = 0x82f63b78; // the reversed Castagnoli polynomial
+
+/**
+ * Make the table of the checksums of all the bytes.
+ * @return the table
+ */
+std::array<std::uint32_t, 256> MakeTable() {
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+        table[i] = crc;
+    }
+    return table;
+}
+
+std::uint32_t SoftwareCrc32c(const char* data, SizeT length, std::uint32_t crc) {
+    static const std::array<std::uint32_t, 256> table = MakeTable();
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    for (SizeT i = 0; i < length; ++i) crc = (crc >> 8) ^ table[(crc ^ bytes[i]) & 0xff];
+    return crc;
+}
+
+#ifdef LAU_CPP_LIB_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+std::uint32_t HardwareCrc32c(const char* data, SizeT length, std::uint32_t crc) {
+    std::uint64_t crc64 = crc;
+    for (; length >= 8; data += 8, length -= 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<std::uint32_t>(crc64);
+    for (; length > 0; ++data, --length) crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*data));
+    return crc;
+}
+
+bool HasHardwareCrc32c() {
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+}
+#elif defined(LAU_CPP_LIB_CRC32C_ARM)
+std::uint32_t HardwareCrc32c(const char* data, SizeT length, std::uint32_t crc) {
+    for (; length >= 8; data += 8, length -= 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data, 8);
+        crc = __crc32cd(crc, word);
+    }
+    for (; length > 0; ++data, --length) crc = __crc32cb(crc, static_cast<std::uint8_t>(*data));
+    return crc;
+}
+
+bool HasHardwareCrc32c() {
+    return true;
+}
+#endif
+
+} // namespace
+
+std::uint32_t lau::Crc32c(const char* data, SizeT length, std::uint32_t crc) {
+    crc = ~crc;
+#if defined(LAU_CPP_LIB_CRC32C_SSE42) || defined(LAU_CPP_LIB_CRC32C_ARM)
+    if (HasHardwareCrc32c()) return ~HardwareCrc32c(data, length, crc);
+#endif
+    return ~SoftwareCrc32c(data, length, crc);
+}
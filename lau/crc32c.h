@@ -0,0 +1,49 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/crc32c.h
+ *
+ * This is a external header file, including the <code>lau::Crc32c</code>
+ * function.
+ */
+
+#ifndef LAU_CPP_LIB_LAU_CRC32C_H
+#define LAU_CPP_LIB_LAU_CRC32C_H
+
+#include <cstdint>
+
+#include "type_traits.h"
+
+namespace lau {
+
+/**
+ * Get the CRC-32C (Castagnoli) checksum of a string of bytes.  The
+ * instructions of the processor are used if it supports them (SSE 4.2 on
+ * x86-64, or the CRC32 extension on ARMv8).
+ * <br><br>
+ * The checksum can be computed piece by piece: the checksum of the bytes
+ * before can be passed as <code>crc</code> to continue.
+ * @param data
+ * @param length
+ * @param crc the checksum of the bytes before, or 0 if there are none
+ * @return the checksum
+ */
+std::uint32_t Crc32c(const char* data, SizeT length, std::uint32_t crc = 0);
+
+}
+
+#endif // LAU_CPP_LIB_LAU_CRC32C_H
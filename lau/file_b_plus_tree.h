@@ -0,0 +1,841 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/file_b_plus_tree.h
+ *
+ * This is a external header file, including a
+ * <code>lau::FileBPlusTree</code> class.
+ */
+
+#ifndef LAU_CPP_LIB_LAU_FILE_B_PLUS_TREE_H
+#define LAU_CPP_LIB_LAU_FILE_B_PLUS_TREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "exception.h"
+#include "file_storage.h"
+#include "reader_writer_latch.h"
+#include "type_traits.h"
+
+namespace lau {
+
+/**
+ * @class FileBPlusTree
+ *
+ * This is a template class of B+ tree on disk storage.  All the pages
+ * have the same size, and the leaves are linked in the order of their
+ * keys, so a lookup reads one page on each level and a range scan reads
+ * the leaves one after another.
+ * @tparam KeyType Type of Key
+ * @tparam ValueType Type of Value
+ * @tparam Storage Type of the storage, <code>lau::FileStorage</code> by default
+ *
+ * CAUTION:
+ * <br>
+ * 1. The key type MUST have valid operator< and operator== !
+ * <br>
+ * 2. The key and value type must have default constructor and trivial
+ * move and copy constructor.
+ * <br>
+ * 3. The functions that only read the tree (e.g. <code>Get</code>) can
+ * be called by several threads at the same time, and the functions that
+ * modify the tree wait until no other function is running.
+ */
+template <class KeyType, class ValueType, class Storage = FileStorage>
+class FileBPlusTree {
+public:
+    using Ptr = long;
+
+    /**
+     * @struct Node{key, value}
+     *
+     * This is the Node to store data.
+     */
+    struct Node {
+        KeyType   key;
+        ValueType value;
+    };
+
+    /**
+     * @class ScanIterator
+     *
+     * The iterator of the nodes in a range, which reads the leaves lazily.
+     * A leaf is read with one read when the iterator comes to it, and the
+     * next leaf is prefetched.
+     * <br><br>
+     * The iterator is invalid once the tree is modified.
+     */
+    class ScanIterator {
+        friend FileBPlusTree;
+
+    public:
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = Node;
+        using pointer           = const Node*;
+        using reference         = const Node&;
+        using iterator_category = std::input_iterator_tag;
+
+        ScanIterator() noexcept = default;
+        ScanIterator(const ScanIterator& obj) = default;
+        ScanIterator(ScanIterator&& obj) noexcept = default;
+
+        ScanIterator& operator=(const ScanIterator& obj) = default;
+        ScanIterator& operator=(ScanIterator&& obj) noexcept = default;
+
+        ~ScanIterator() = default;
+
+        ScanIterator operator++(int) {
+            ScanIterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        ScanIterator& operator++() {
+            ++position_;
+            if (position_ == static_cast<SizeT>(block_.size()) && tree_ != nullptr) {
+                auto lock = tree_->ReadLock_();
+                LoadLeaf_(nextPtr_);
+            }
+            if (tree_ != nullptr && highKey_ < block_[position_].key) tree_ = nullptr; // out of range
+            return *this;
+        }
+
+        bool operator==(const ScanIterator& rhs) const noexcept {
+            if (tree_ == nullptr || rhs.tree_ == nullptr) return tree_ == rhs.tree_;
+            return leafPtr_ == rhs.leafPtr_ && position_ == rhs.position_;
+        }
+
+        bool operator!=(const ScanIterator& rhs) const noexcept { return !(*this == rhs); }
+
+        const Node& operator*()  const { return block_[position_]; }
+        const Node* operator->() const { return &(block_[position_]); }
+
+    private:
+        ScanIterator(const FileBPlusTree* tree, const KeyType& lowKey, const KeyType& highKey)
+            : tree_(tree), highKey_(highKey) {
+            auto lock = tree_->ReadLock_();
+            if (highKey < lowKey) {
+                tree_ = nullptr;
+                return;
+            }
+
+            // Skip the nodes less than the lower key in the first leaf
+            Page_ page;
+            leafPtr_ = tree_->FindLeaf_(lowKey, page);
+            nextPtr_ = page.header.next;
+            position_ = LowerBound_(page.nodes, lowKey);
+            block_ = std::move(page.nodes);
+            if (position_ == static_cast<SizeT>(block_.size())) LoadLeaf_(nextPtr_);
+            if (tree_ != nullptr && highKey_ < block_[position_].key) tree_ = nullptr;
+        }
+
+        /**
+         * Read a leaf and prefetch the next leaf.  If the pointer is 0,
+         * the iterator becomes the end.
+         * @param ptr the place of the leaf
+         */
+        void LoadLeaf_(Ptr ptr) {
+            if (ptr == 0) {
+                tree_ = nullptr;
+                return;
+            }
+            Page_ page;
+            tree_->ReadPage_(ptr, page);
+            if (page.header.next != 0) tree_->storage_.Prefetch(page.header.next, tree_->head_.pageSize);
+            block_ = std::move(page.nodes);
+            leafPtr_ = ptr;
+            nextPtr_ = page.header.next;
+            position_ = 0;
+            if (block_.empty()) tree_ = nullptr; // only the root can be empty
+        }
+
+        const FileBPlusTree* tree_ = nullptr; // nullptr for the end
+        KeyType highKey_{};
+        std::vector<Node> block_; // the nodes of the current leaf
+        Ptr leafPtr_ = 0;
+        Ptr nextPtr_ = 0;
+        SizeT position_ = 0;
+    };
+
+    /**
+     * @class ScanRange
+     *
+     * The range of nodes returned by <code>Scan</code>, which can be used
+     * in a range-based for loop.
+     */
+    class ScanRange {
+        friend FileBPlusTree;
+
+    public:
+        [[nodiscard]] ScanIterator begin() const { return begin_; }
+        [[nodiscard]] ScanIterator end()   const { return ScanIterator(); }
+
+    private:
+        explicit ScanRange(ScanIterator&& begin) : begin_(std::move(begin)) {}
+
+        ScanIterator begin_;
+    };
+
+    explicit FileBPlusTree(const std::string& fileName, SizeT pageSize = 4096)
+        : FileBPlusTree(Storage(fileName), pageSize) {}
+
+    explicit FileBPlusTree(const char* fileName, SizeT pageSize = 4096)
+        : FileBPlusTree(Storage(fileName), pageSize) {}
+
+    /**
+     * Construct the tree with a storage, which decides how the file is
+     * accessed (e.g. <code>lau::BufferPool</code> caches the file in
+     * memory).
+     * @param storage
+     * @param pageSize the size of a page in bytes, which is ignored if the
+     * file is not empty (the size in the file is used instead)
+     * @throw lau::InvalidArgument if a page cannot hold at least 3 nodes
+     * or 3 keys
+     */
+    explicit FileBPlusTree(Storage&& storage, SizeT pageSize = 4096)
+        : storage_(std::move(storage)), head_{0, 0, 0, 1, pageSize, 0, 1, 1} {
+        if (!storage_.Empty()) {
+            storage_.Read(reinterpret_cast<char*>(&head_), 0, sizeof(Header_));
+        }
+        leafCapacity_ = (head_.pageSize - static_cast<SizeT>(sizeof(PageHeader_))) / static_cast<SizeT>(sizeof(Node_));
+        internalCapacity_ = (head_.pageSize - static_cast<SizeT>(sizeof(PageHeader_) + sizeof(Ptr)))
+                            / static_cast<SizeT>(sizeof(KeyType) + sizeof(Ptr));
+        if (leafCapacity_ < 3 || internalCapacity_ < 3) {
+            throw lau::InvalidArgument("Invalid Argument: the page is too small");
+        }
+
+        if (storage_.Empty()) {
+            // The first page is for the header, and the second one is the root
+            storage_.Allocate(head_.pageSize);
+            head_.root = NewPage_();
+            head_.firstLeaf = head_.root;
+            WritePage_(head_.root, Page_{PageHeader_{1, 0, 0}, {}, {}, {}});
+            WriteHead_();
+            storage_.EndOperation();
+        }
+    }
+
+    FileBPlusTree(FileBPlusTree&&) noexcept = default;
+
+    FileBPlusTree(const FileBPlusTree&) = delete;
+
+    FileBPlusTree& operator=(FileBPlusTree&&) noexcept = default;
+
+    FileBPlusTree& operator=(const FileBPlusTree&) = delete;
+
+    ~FileBPlusTree() = default;
+
+    /**
+     * Insert a new key-value pair.  A full page is split into two, and the
+     * split may go up to the root.
+     * @param key the new key
+     * @param value the value of the new key
+     * @return whether the operation is successful or not
+     */
+    bool Insert(const KeyType& key, const ValueType& value) {
+        auto lock = WriteLock_();
+        std::vector<PathEntry_> path;
+        Page_ leaf;
+        Ptr leafPtr = FindLeaf_(key, leaf, &path);
+        SizeT position = LowerBound_(leaf.nodes, key);
+        if (position < static_cast<SizeT>(leaf.nodes.size()) && leaf.nodes[position].key == key) return false;
+
+        leaf.nodes.insert(leaf.nodes.begin() + position, Node_{key, value});
+        ++(head_.size);
+        if (static_cast<SizeT>(leaf.nodes.size()) <= leafCapacity_) {
+            WritePage_(leafPtr, leaf);
+            WriteHead_();
+            storage_.EndOperation();
+            return true;
+        }
+
+        // Split the leaf
+        SizeT middle = static_cast<SizeT>(leaf.nodes.size()) / 2;
+        Ptr newPtr = NewPage_();
+        Page_ newPage{PageHeader_{1, 0, leaf.header.next}, {}, {}, {}};
+        newPage.nodes.assign(leaf.nodes.begin() + middle, leaf.nodes.end());
+        leaf.nodes.resize(middle);
+        leaf.header.next = newPtr;
+        WritePage_(leafPtr, leaf);
+        WritePage_(newPtr, newPage);
+        KeyType separator = newPage.nodes.front().key;
+
+        // Put the separator into the parents, and split them if they are full
+        Page_ parent;
+        while (!path.empty()) {
+            auto [parentPtr, child] = path.back();
+            path.pop_back();
+            ReadPage_(parentPtr, parent);
+            parent.keys.insert(parent.keys.begin() + child, separator);
+            parent.children.insert(parent.children.begin() + child + 1, newPtr);
+            if (static_cast<SizeT>(parent.keys.size()) <= internalCapacity_) {
+                WritePage_(parentPtr, parent);
+                WriteHead_();
+                storage_.EndOperation();
+                return true;
+            }
+
+            middle = static_cast<SizeT>(parent.keys.size()) / 2;
+            separator = parent.keys[middle];
+            newPtr = NewPage_();
+            newPage = Page_{PageHeader_{0, 0, 0}, {}, {}, {}};
+            newPage.keys.assign(parent.keys.begin() + middle + 1, parent.keys.end());
+            newPage.children.assign(parent.children.begin() + middle + 1, parent.children.end());
+            parent.keys.resize(middle);
+            parent.children.resize(middle + 1);
+            WritePage_(parentPtr, parent);
+            WritePage_(newPtr, newPage);
+        }
+
+        // Grow a new root
+        Page_ root{PageHeader_{0, 0, 0}, {}, {separator}, {head_.root, newPtr}};
+        head_.root = NewPage_();
+        ++(head_.height);
+        WritePage_(head_.root, root);
+        WriteHead_();
+        storage_.EndOperation();
+        return true;
+    }
+
+    /**
+     * Erase the corresponding key-value pair of the input key.  A page
+     * that becomes less than half full borrows from or is merged with a
+     * sibling, and the root is removed when it has only one child.
+     * @param key
+     * @return whether the operation is successful or not
+     */
+    bool Erase(const KeyType& key) {
+        auto lock = WriteLock_();
+        std::vector<PathEntry_> path;
+        Page_ page;
+        Ptr ptr = FindLeaf_(key, page, &path);
+        SizeT position = LowerBound_(page.nodes, key);
+        if (position == static_cast<SizeT>(page.nodes.size()) || !(page.nodes[position].key == key)) return false;
+
+        page.nodes.erase(page.nodes.begin() + position);
+        --(head_.size);
+
+        // Rebalance the pages from the leaf up to the root
+        Page_ parent, sibling;
+        while (!path.empty() && PageSize_(page) < MinPageSize_(page)) {
+            auto [parentPtr, child] = path.back();
+            path.pop_back();
+            ReadPage_(parentPtr, parent);
+
+            // Use the left sibling if there is one, or the right one otherwise
+            SizeT separator = (child > 0 ? child - 1 : child);
+            Ptr siblingPtr = parent.children[child > 0 ? child - 1 : child + 1];
+            ReadPage_(siblingPtr, sibling);
+            Page_& left  = (child > 0 ? sibling : page);
+            Page_& right = (child > 0 ? page : sibling);
+            Ptr leftPtr  = (child > 0 ? siblingPtr : ptr);
+            Ptr rightPtr = (child > 0 ? ptr : siblingPtr);
+
+            if (PageSize_(left) + PageSize_(right) + (left.header.leaf ? 0 : 1) <= Capacity_(left)) {
+                Merge_(left, right, parent.keys[separator]);
+                WritePage_(leftPtr, left);
+                FreePage_(rightPtr);
+                parent.keys.erase(parent.keys.begin() + separator);
+                parent.children.erase(parent.children.begin() + separator + 1);
+            } else {
+                Balance_(left, right, parent.keys[separator]);
+                WritePage_(leftPtr, left);
+                WritePage_(rightPtr, right);
+            }
+            ptr = parentPtr;
+            std::swap(page, parent);
+        }
+
+        // Remove the root if it has only one child
+        if (ptr == head_.root && !page.header.leaf && page.keys.empty()) {
+            FreePage_(head_.root);
+            head_.root = page.children.front();
+            --(head_.height);
+        } else {
+            WritePage_(ptr, page);
+        }
+        WriteHead_();
+        storage_.EndOperation();
+        return true;
+    }
+
+    /**
+     * Modify the value of an existing key-value pair.
+     * @param key
+     * @param value
+     * @return whether the operation is successful or not
+     */
+    bool Modify(const KeyType& key, const ValueType& value) {
+        auto lock = WriteLock_();
+        Page_ leaf;
+        Ptr leafPtr = FindLeaf_(key, leaf);
+        SizeT position = LowerBound_(leaf.nodes, key);
+        if (position == static_cast<SizeT>(leaf.nodes.size()) || !(leaf.nodes[position].key == key)) return false;
+
+        leaf.nodes[position].value = value;
+        storage_.Write(reinterpret_cast<const char*>(&(leaf.nodes[position])),
+                       leafPtr + sizeof(PageHeader_) + position * sizeof(Node_), sizeof(Node_));
+        storage_.EndOperation();
+        return true;
+    }
+
+    /**
+     * The function clears all the data in the tree.  The pages are reused
+     * by later insertions.
+     * @return reference of the current class
+     */
+    FileBPlusTree& Clear() {
+        auto lock = WriteLock_();
+        head_.freePage = 0;
+        head_.usedPages = 1;
+        head_.root = NewPage_();
+        head_.firstLeaf = head_.root;
+        head_.height = 1;
+        head_.size = 0;
+        WritePage_(head_.root, Page_{PageHeader_{1, 0, 0}, {}, {}, {}});
+        WriteHead_();
+        storage_.EndOperation();
+        return *this;
+    }
+
+    /**
+     * Tell whether there exists a node with a certain key
+     * @param key
+     * @return the boolean of whether there exists a node with a certain key
+     * or not
+     */
+    [[nodiscard]] bool Exist(const KeyType& key) const {
+        auto lock = ReadLock_();
+        Page_ leaf;
+        FindLeaf_(key, leaf);
+        SizeT position = LowerBound_(leaf.nodes, key);
+        return position < static_cast<SizeT>(leaf.nodes.size()) && leaf.nodes[position].key == key;
+    }
+
+    /**
+     * Get the value of a certain key.  Please make sure that there
+     * exists such a node.
+     * @param key
+     * @return the value of the certain node.  If the key doesn't exist,
+     * the function will return a ValueType object (constructed by default
+     * constructor).
+     */
+    [[nodiscard]] ValueType Get(const KeyType& key) const {
+        auto lock = ReadLock_();
+        Page_ leaf;
+        FindLeaf_(key, leaf);
+        SizeT position = LowerBound_(leaf.nodes, key);
+        if (position == static_cast<SizeT>(leaf.nodes.size()) || !(leaf.nodes[position].key == key)) {
+            return ValueType(); // no such node
+        }
+        return leaf.nodes[position].value;
+    }
+
+    /**
+     * Get the value of a certain key.
+     * <br><br>
+     * CAUTION: The pointer is generated by <code>new</code>, so please
+     * delete it after using it.
+     * @param key
+     * @return the pointer to the value of the certain node.
+     * If the key doesn't exist, a nullptr will be returned instead.
+     */
+    [[nodiscard]] ValueType* GetWithPointer(const KeyType& key) const {
+        auto lock = ReadLock_();
+        Page_ leaf;
+        FindLeaf_(key, leaf);
+        SizeT position = LowerBound_(leaf.nodes, key);
+        if (position == static_cast<SizeT>(leaf.nodes.size()) || !(leaf.nodes[position].key == key)) {
+            return nullptr; // no such node
+        }
+        return new ValueType(leaf.nodes[position].value);
+    }
+
+    /**
+     * Get all the nodes in the order of their keys by walking through the
+     * leaves.
+     * @return a vector of all the nodes
+     */
+    std::vector<Node> Traverse() const {
+        auto lock = ReadLock_();
+        std::vector<Node> result;
+        result.reserve(head_.size);
+        Page_ leaf;
+        for (Ptr ptr = head_.firstLeaf; ptr != 0; ptr = leaf.header.next) {
+            ReadPage_(ptr, leaf);
+            if (leaf.header.next != 0) storage_.Prefetch(leaf.header.next, head_.pageSize);
+            result.insert(result.end(), leaf.nodes.begin(), leaf.nodes.end());
+        }
+        return result;
+    }
+
+    /**
+     * Get the nodes whose keys are in [lowKey, highKey] lazily, so that
+     * only the nodes of one leaf are kept in memory at a time.
+     * <br><br>
+     * The range is invalid once the tree is modified.
+     * @param lowKey
+     * @param highKey
+     * @return the range of the nodes, which can be used in a range-based
+     * for loop
+     */
+    ScanRange Scan(const KeyType& lowKey, const KeyType& highKey) const {
+        return ScanRange(ScanIterator(this, lowKey, highKey));
+    }
+
+    /**
+     * Flush to make everything in the buffer stored in the file
+     * @return reference of the current class
+     */
+    FileBPlusTree& Flush() {
+        auto lock = WriteLock_();
+        storage_.Flush();
+        return *this;
+    }
+
+    /**
+     * Tell whether the tree is empty.
+     * @return the boolean of whether the tree is empty
+     */
+    [[nodiscard]] bool Empty() const {
+        auto lock = ReadLock_();
+        return head_.size == 0;
+    }
+
+    /**
+     * Get the number of key-value pairs in the tree.
+     * @return the number of key-value pairs
+     */
+    [[nodiscard]] SizeT Size() const {
+        auto lock = ReadLock_();
+        return head_.size;
+    }
+
+    /**
+     * Get the number of levels of the tree, which is also the number of
+     * pages read by a lookup.
+     * @return the height of the tree
+     */
+    [[nodiscard]] SizeT Height() const {
+        auto lock = ReadLock_();
+        return head_.height;
+    }
+
+private:
+    typedef Node Node_;
+
+    /**
+     * @struct Header_{root, firstLeaf, freePage, height, pageSize, size, pageCount, usedPages}
+     *
+     * This is the metadata of the tree, stored at the beginning of the
+     * first page.  The pages before <code>usedPages</code> are either in
+     * the tree or in the list of free pages, and the pages after it are
+     * unused (after <code>Clear</code>).
+     */
+    struct Header_ {
+        Ptr   root;
+        Ptr   firstLeaf; // the leaf with the least keys
+        Ptr   freePage; // the first free page
+        SizeT height;
+        SizeT pageSize;
+        SizeT size; // the number of key-value pairs
+        SizeT pageCount; // the number of pages in the file
+        SizeT usedPages;
+    };
+
+    /**
+     * @struct PageHeader_{leaf, count, next}
+     *
+     * This is the beginning of every page.  For a leaf, <code>count</code>
+     * nodes follow it, and <code>next</code> is the next leaf.  For an
+     * internal page, the array of children and the array of keys follow
+     * it, and <code>count</code> is the number of keys.  For a free page,
+     * <code>next</code> is the next free page.
+     */
+    struct PageHeader_ {
+        SizeT leaf; // 1 for a leaf and 0 for an internal page
+        SizeT count;
+        Ptr   next;
+    };
+
+    /**
+     * @struct Page_{header, nodes, keys, children}
+     *
+     * This is a page loaded into memory.  The key of
+     * <code>keys[i]</code> is the least key in the subtree of
+     * <code>children[i + 1]</code>.
+     */
+    struct Page_ {
+        PageHeader_ header;
+        std::vector<Node_> nodes; // for a leaf
+        std::vector<KeyType> keys; // for an internal page
+        std::vector<Ptr> children; // for an internal page
+    };
+
+    /**
+     * @struct PathEntry_{ptr, child}
+     *
+     * This is an internal page passed by a search, with the position of the
+     * child that the search goes to.
+     */
+    struct PathEntry_ {
+        Ptr   ptr;
+        SizeT child;
+    };
+
+    /**
+     * Go down from the root to the leaf whose range contains the key.
+     * @param key
+     * @param page the place to put the leaf
+     * @param path the place to record the internal pages passed, or
+     * nullptr if they are not needed
+     * @return the place of the leaf
+     */
+    Ptr FindLeaf_(const KeyType& key, Page_& page, std::vector<PathEntry_>* path = nullptr) const {
+        Ptr ptr = head_.root;
+        ReadPage_(ptr, page);
+        while (!page.header.leaf) {
+            SizeT child = std::upper_bound(page.keys.begin(), page.keys.end(), key) - page.keys.begin();
+            if (path != nullptr) path->push_back(PathEntry_{ptr, child});
+            ptr = page.children[child];
+            ReadPage_(ptr, page);
+        }
+        return ptr;
+    }
+
+    /**
+     * Get the position of the first node whose key is not less than the
+     * key.
+     * @param nodes
+     * @param key
+     * @return the position of the node
+     */
+    static SizeT LowerBound_(const std::vector<Node_>& nodes, const KeyType& key) {
+        return std::lower_bound(nodes.begin(), nodes.end(), key,
+                                [](const Node_& lhs, const KeyType& rhs) { return lhs.key < rhs; }) - nodes.begin();
+    }
+
+    /**
+     * Get the number of nodes (for a leaf) or keys (for an internal page).
+     * @param page
+     * @return the size of the page
+     */
+    static SizeT PageSize_(const Page_& page) {
+        return static_cast<SizeT>(page.header.leaf ? page.nodes.size() : page.keys.size());
+    }
+
+    /**
+     * Get the maximum size of a page.
+     * @param page
+     * @return the capacity of the page
+     */
+    [[nodiscard]] SizeT Capacity_(const Page_& page) const {
+        return page.header.leaf ? leafCapacity_ : internalCapacity_;
+    }
+
+    /**
+     * Get the minimum size of a page that is not the root.
+     * @param page
+     * @return the minimum size of the page
+     */
+    [[nodiscard]] SizeT MinPageSize_(const Page_& page) const {
+        return Capacity_(page) / 2;
+    }
+
+    /**
+     * Move everything in a page to the end of its left sibling.
+     * @param left
+     * @param right
+     * @param separator the key between the two pages in their parent
+     */
+    static void Merge_(Page_& left, const Page_& right, const KeyType& separator) {
+        if (left.header.leaf) {
+            left.nodes.insert(left.nodes.end(), right.nodes.begin(), right.nodes.end());
+            left.header.next = right.header.next;
+        } else {
+            left.keys.push_back(separator);
+            left.keys.insert(left.keys.end(), right.keys.begin(), right.keys.end());
+            left.children.insert(left.children.end(), right.children.begin(), right.children.end());
+        }
+    }
+
+    /**
+     * Share the nodes or the keys of two sibling pages evenly between them.
+     * @param left
+     * @param right
+     * @param separator the key between the two pages in their parent,
+     * which is changed to the new one
+     */
+    static void Balance_(Page_& left, Page_& right, KeyType& separator) {
+        if (left.header.leaf) {
+            std::vector<Node_> nodes(std::move(left.nodes));
+            nodes.insert(nodes.end(), right.nodes.begin(), right.nodes.end());
+            SizeT middle = static_cast<SizeT>(nodes.size()) / 2;
+            left.nodes.assign(nodes.begin(), nodes.begin() + middle);
+            right.nodes.assign(nodes.begin() + middle, nodes.end());
+            separator = right.nodes.front().key;
+        } else {
+            std::vector<KeyType> keys(std::move(left.keys));
+            keys.push_back(separator);
+            keys.insert(keys.end(), right.keys.begin(), right.keys.end());
+            std::vector<Ptr> children(std::move(left.children));
+            children.insert(children.end(), right.children.begin(), right.children.end());
+            SizeT middle = static_cast<SizeT>(keys.size()) / 2;
+            separator = keys[middle];
+            left.keys.assign(keys.begin(), keys.begin() + middle);
+            right.keys.assign(keys.begin() + middle + 1, keys.end());
+            left.children.assign(children.begin(), children.begin() + middle + 1);
+            right.children.assign(children.begin() + middle + 1, children.end());
+        }
+    }
+
+    /**
+     * Get the buffer of a page.  Each thread has its own buffer, so that
+     * the pages can be read in several threads at the same time.
+     * @return the buffer, which can hold a whole page
+     */
+    char* PageBuffer_() const {
+        static thread_local std::vector<char> buffer; // one for each thread to read in parallel
+        if (static_cast<SizeT>(buffer.size()) < head_.pageSize) buffer.resize(head_.pageSize);
+        return buffer.data();
+    }
+
+    /**
+     * Read a page with one read.
+     * @param ptr the place of the page
+     * @param page the place to put the page
+     */
+    void ReadPage_(Ptr ptr, Page_& page) const {
+        char* buffer = PageBuffer_();
+        storage_.Read(buffer, ptr, head_.pageSize);
+        std::memcpy(&(page.header), buffer, sizeof(PageHeader_));
+        const char* payload = buffer + sizeof(PageHeader_);
+        if (page.header.leaf) {
+            page.nodes.resize(page.header.count);
+            if (page.header.count > 0) std::memcpy(page.nodes.data(), payload, page.header.count * sizeof(Node_));
+        } else {
+            page.keys.resize(page.header.count);
+            page.children.resize(page.header.count + 1);
+            std::memcpy(page.children.data(), payload, (page.header.count + 1) * sizeof(Ptr));
+            std::memcpy(page.keys.data(), payload + KeysOffset_(), page.header.count * sizeof(KeyType));
+        }
+    }
+
+    /**
+     * Write the used part of a page with one write.
+     * @param ptr the place of the page
+     * @param page
+     */
+    void WritePage_(Ptr ptr, const Page_& page) {
+        PageHeader_ header = page.header;
+        header.count = PageSize_(page);
+        char* buffer = PageBuffer_();
+        std::memset(buffer, 0, head_.pageSize);
+        std::memcpy(buffer, &header, sizeof(PageHeader_));
+        char* payload = buffer + sizeof(PageHeader_);
+        SizeT length = sizeof(PageHeader_);
+        if (page.header.leaf) {
+            if (header.count > 0) std::memcpy(payload, page.nodes.data(), header.count * sizeof(Node_));
+            length += header.count * sizeof(Node_);
+        } else {
+            std::memcpy(payload, page.children.data(), (header.count + 1) * sizeof(Ptr));
+            std::memcpy(payload + KeysOffset_(), page.keys.data(), header.count * sizeof(KeyType));
+            length += KeysOffset_() + header.count * sizeof(KeyType);
+        }
+        storage_.Write(buffer, ptr, length);
+    }
+
+    /**
+     * Get the offset of the array of keys from the end of the page header
+     * in an internal page.
+     * @return the offset of the keys
+     */
+    [[nodiscard]] SizeT KeysOffset_() const {
+        return (internalCapacity_ + 1) * sizeof(Ptr);
+    }
+
+    /**
+     * Get a page from the free pages, the unused pages or the end of the
+     * file.
+     * @return the place of the page
+     */
+    Ptr NewPage_() {
+        if (head_.freePage != 0) {
+            Ptr ptr = head_.freePage;
+            PageHeader_ header;
+            storage_.Read(reinterpret_cast<char*>(&header), ptr, sizeof(PageHeader_));
+            head_.freePage = header.next;
+            return ptr;
+        }
+        if (head_.usedPages < head_.pageCount) return (head_.usedPages++) * head_.pageSize;
+        ++(head_.pageCount);
+        ++(head_.usedPages);
+        return storage_.Allocate(head_.pageSize);
+    }
+
+    /**
+     * Put a page into the list of free pages.
+     * @param ptr the place of the page
+     */
+    void FreePage_(Ptr ptr) {
+        PageHeader_ header{0, 0, head_.freePage};
+        storage_.Write(reinterpret_cast<const char*>(&header), ptr, sizeof(PageHeader_));
+        head_.freePage = ptr;
+    }
+
+    /**
+     * Write the header of the tree.
+     */
+    void WriteHead_() {
+        storage_.Write(reinterpret_cast<const char*>(&head_), 0, sizeof(Header_));
+    }
+
+    /**
+     * Lock the tree for a function that only reads the tree.
+     * @return the shared lock of the tree
+     */
+    std::shared_lock<std::shared_mutex> ReadLock_() const {
+        return latch_->ReadLock();
+    }
+
+    /**
+     * Lock the tree for a function that modifies the tree.
+     * @return the exclusive lock of the tree
+     */
+    std::unique_lock<std::shared_mutex> WriteLock_() {
+        return latch_->WriteLock();
+    }
+
+    mutable Storage storage_;
+    Header_ head_;
+    SizeT leafCapacity_ = 0; // the maximum number of nodes in a leaf
+    SizeT internalCapacity_ = 0; // the maximum number of keys in an internal page
+    std::unique_ptr<ReaderWriterLatch> latch_ = std::make_unique<ReaderWriterLatch>(); // in the heap to be movable
+};
+
+}
+
+#endif // LAU_CPP_LIB_LAU_FILE_B_PLUS_TREE_H
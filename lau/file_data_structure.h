@@ -24,7 +24,10 @@
 #ifndef LAU_CPP_LIB_LAU_FILE_DATA_STRUCTURE_H
 #define LAU_CPP_LIB_LAU_FILE_DATA_STRUCTURE_H
 
+#include "file_b_plus_tree.h"
 #include "file_double_unrolled_linked_list.h"
+#include "file_sharded_unrolled_linked_list.h"
+#include "file_string_unrolled_linked_list.h"
 #include "file_unrolled_linked_list.h"
 
 #endif // LAU_CPP_LIB_LAU_FILE_DATA_STRUCTURE_H
@@ -24,10 +24,23 @@
 #ifndef LAU_CPP_LIB_LAU_FILE_DOUBLE_UNROLLED_LINKED_LIST_H
 #define LAU_CPP_LIB_LAU_FILE_DOUBLE_UNROLLED_LINKED_LIST_H
 
-#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "clock_cache.h"
+#include "exception.h"
+#include "file_storage.h"
+#include "reader_writer_latch.h"
 #include "type_traits.h"
 
 namespace lau {
@@ -36,10 +49,21 @@ namespace lau {
  * @class FileDoubleUnrolledLinkedList
  *
  * This is a template class of double unrolled linked list on disk storage.
+ * The nodes in an array have the same size and are found, modified and
+ * shifted by their offsets.
+ * <br>
+ * The keys can also be front coded if they share long prefixes (e.g. an
+ * id and a time): each key only keeps the bytes that differ from the key
+ * before it, except the keys at the restart points (one in every several
+ * nodes), which are kept whole for the binary search, so that more nodes
+ * fit in an array.  An array is then decoded from the restart point
+ * before a key to find the key, and decoded and encoded again as a whole
+ * to be modified.
  *
  * @tparam KeyType1 Type of First key
  * @tparam KeyType2 Type of Second key
  * @tparam ValueType Type of Value
+ * @tparam Storage Type of the storage, <code>lau::FileStorage</code> by default
  *
  * WARNING:
  * <br>
@@ -47,8 +71,15 @@ namespace lau {
  * <br>
  * 2. The two key and value types must have default constructor and
  * trivial move and copy constructor.
+ * <br>
+ * 3. The functions that only read the list (e.g. <code>Get</code>) can
+ * be called by several threads at the same time, and the functions that
+ * modify the list wait until no other function is running.
+ * <br>
+ * 4. A <code>Snapshot</code> refers to the list, so the list MUST NOT be
+ * moved or destroyed while any snapshot of it exists.
  */
-template<class KeyType1, class KeyType2, class ValueType>
+template<class KeyType1, class KeyType2, class ValueType, class Storage = FileStorage>
 class FileDoubleUnrolledLinkedList {
 public:
     using Ptr = long;
@@ -64,29 +95,219 @@ public:
         ValueType value;
     };
 
-    explicit FileDoubleUnrolledLinkedList(const std::string& fileName, SizeT nodeSize = 500) noexcept
-        : list_(fileName), head_{0, 0, 0, nodeSize, 2 * nodeSize} {
-        list_.seekg(0);
-        list_.seekp(0);
-        if (list_.peek() == EOF) {
-            list_.seekg(0, std::ios::beg);
-            list_.seekp(0, std::ios::beg);
-            list_.write(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
-        } else {
-            list_.read(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
+    /**
+     * @class Snapshot
+     *
+     * A stable view of the list at the time it is taken (see
+     * <code>TakeSnapshot</code>).  The functions of a snapshot only lock
+     * the list while reading a main node or an array, so the list can be
+     * modified while a snapshot is read, and the snapshot still sees the
+     * list as it was.  The pages of the file that are modified after a
+     * snapshot is taken are copied in memory before they are modified, and
+     * the copies are freed once no snapshot needs them.
+     */
+    class Snapshot {
+        friend FileDoubleUnrolledLinkedList;
+
+    public:
+        Snapshot(const Snapshot&) = delete;
+
+        Snapshot(Snapshot&& obj) noexcept
+            : list_(obj.list_), version_(obj.version_), first_(obj.first_) {
+            obj.list_ = nullptr;
+        }
+
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        Snapshot& operator=(Snapshot&& obj) noexcept {
+            if (this == &obj) return *this;
+            if (list_ != nullptr) list_->Release_(version_);
+            list_ = obj.list_;
+            version_ = obj.version_;
+            first_ = obj.first_;
+            obj.list_ = nullptr;
+            return *this;
+        }
+
+        ~Snapshot() {
+            if (list_ != nullptr) list_->Release_(version_);
+        }
+
+        /**
+         * Check whether there exists a node with a certain key or not in
+         * the snapshot.
+         * @param key1
+         * @param key2
+         * @return The boolean of whether there exists a node with a certain
+         * key or not
+         */
+        [[nodiscard]] bool Exist(const KeyType1& key1, const KeyType2& key2) const {
+            ValueType value;
+            return Lookup_(key1, key2, value);
+        }
+
+        /**
+         * Get the corresponding value of the key in the snapshot.  If there
+         * is no such node, it will return the default value (using the
+         * default constructor).
+         * @param key1
+         * @param key2
+         * @return the corresponding value of the key.
+         */
+        [[nodiscard]] ValueType Get(const KeyType1& key1, const KeyType2& key2) const {
+            ValueType value;
+            if (!Lookup_(key1, key2, value)) return ValueType(); // no such node
+            return value;
+        }
+
+        /**
+         * Get all the key-value pair in the snapshot.
+         * @return the <code>std::vector</code> class containing all the
+         * <code>Node</code>s in the snapshot
+         */
+        std::vector<Node> Traverse() const {
+            std::vector<Node> values;
+            ForEach([&values](const Node& node) { values.push_back(node); });
+            return values;
+        }
+
+        /**
+         * Get all the key-value pair with a certain key1 in the snapshot.
+         * @param key1
+         * @return the <code>std::vector</code> class containing all the
+         * <code>Node</code>s with key1
+         */
+        std::vector<Node> Traverse(const KeyType1& key1) const {
+            std::vector<Node> values;
+            ForEach(key1, [&values](const Node& node) { values.push_back(node); });
+            return values;
         }
-    }
 
-    explicit FileDoubleUnrolledLinkedList(const char* fileName, SizeT nodeSize = 500) noexcept
-        : list_(fileName), head_{0, 0, 0, nodeSize, 2 * nodeSize} {
-        list_.seekg(0);
-        list_.seekp(0);
-        if (list_.peek() == EOF) {
-            list_.seekg(0, std::ios::beg);
-            list_.seekp(0, std::ios::beg);
-            list_.write(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
+        /**
+         * Call the function for each key-value pair in the snapshot in
+         * order.  The list is not locked while the function is called, so
+         * the function may call the functions of the list.
+         * @tparam Function a function that can be called with
+         * <code>const Node&</code>
+         * @param function
+         */
+        template <class Function>
+        void ForEach(Function&& function) const {
+            list_->ReadSnapshot_(version_, first_, [](const Node_&) { return false; },
+                                 [&function](const Node_& node) {
+                                     function(node);
+                                     return true;
+                                 });
+        }
+
+        /**
+         * Call the function for each key-value pair with a certain key1 in
+         * the snapshot in order.  The list is not locked while the function
+         * is called, so the function may call the functions of the list.
+         * @tparam Function a function that can be called with
+         * <code>const Node&</code>
+         * @param key1
+         * @param function
+         * @return the number of key-value pairs with key1
+         */
+        template <class Function>
+        SizeT ForEach(const KeyType1& key1, Function&& function) const {
+            SizeT number = 0;
+            list_->ReadSnapshot_(version_, first_, [&key1](const Node_& node) { return node.key1 < key1; },
+                                 [&key1, &function, &number](const Node_& node) {
+                                     if (!(node.key1 == key1)) return false;
+                                     function(node);
+                                     ++number;
+                                     return true;
+                                 });
+            return number;
+        }
+
+    private:
+        Snapshot(const FileDoubleUnrolledLinkedList* list, SizeT version, Ptr first)
+            : list_(list), version_(version), first_(first) {}
+
+        /**
+         * Look up the value of the key pair in the snapshot.
+         * @param key1
+         * @param key2
+         * @param value the place to put the value
+         * @return whether there exists such a node
+         */
+        bool Lookup_(const KeyType1& key1, const KeyType2& key2, ValueType& value) const {
+            bool found = false;
+            list_->ReadSnapshot_(version_, first_,
+                                 [&key1, &key2](const Node_& node) {
+                                     return node.key1 < key1 || (node.key1 == key1 && node.key2 < key2);
+                                 },
+                                 [&key1, &key2, &value, &found](const Node_& node) {
+                                     if (node.key1 == key1 && node.key2 == key2) {
+                                         value = node.value;
+                                         found = true;
+                                     }
+                                     return false;
+                                 });
+            return found;
+        }
+
+        const FileDoubleUnrolledLinkedList* list_; // nullptr for a moved snapshot
+        SizeT version_;
+        Ptr first_; // the first main node when the snapshot is taken
+    };
+
+    /**
+     * Construct the list with a file.
+     * @param fileName
+     * @param nodeSize
+     * @param cacheSize the number of key-value pairs cached in memory
+     * @param restartInterval the number of nodes from one restart point to
+     * the next one if the keys are front coded, or 0 not to front code the
+     * keys, which is ignored if the file is not empty
+     * @throw lau::RuntimeError if the storage cannot open the file (e.g.
+     * the file is missing, or the log of a <code>lau::JournaledStorage</code>
+     * is corrupted)
+     * @throw lau::InvalidArgument if the restart interval is negative
+     */
+    explicit FileDoubleUnrolledLinkedList(const std::string& fileName, SizeT nodeSize = 500, SizeT cacheSize = 64,
+                                          SizeT restartInterval = 0)
+        : FileDoubleUnrolledLinkedList(Storage(fileName), nodeSize, cacheSize, restartInterval) {}
+
+    explicit FileDoubleUnrolledLinkedList(const char* fileName, SizeT nodeSize = 500, SizeT cacheSize = 64,
+                                          SizeT restartInterval = 0)
+        : FileDoubleUnrolledLinkedList(Storage(fileName), nodeSize, cacheSize, restartInterval) {}
+
+    /**
+     * Construct the list with a storage, which decides how the file is
+     * accessed (e.g. <code>lau::BufferPool</code> caches the file in
+     * memory).
+     * @param storage
+     * @param nodeSize
+     * @param cacheSize the number of key-value pairs cached in memory
+     * @param restartInterval the number of nodes from one restart point to
+     * the next one if the keys are front coded, or 0 not to front code the
+     * keys, which is ignored if the file is not empty
+     * @throw lau::RuntimeError if the storage fails to read or write the
+     * head of the list
+     * @throw lau::InvalidArgument if the restart interval is negative
+     */
+    explicit FileDoubleUnrolledLinkedList(Storage&& storage, SizeT nodeSize = 500, SizeT cacheSize = 64,
+                                          SizeT restartInterval = 0)
+        : storage_(std::move(storage)), format_{kMagic_, restartInterval}, head_{0, 0, 0, nodeSize, 2 * nodeSize},
+          cache_(cacheSize) {
+        if (storage_.Empty()) {
+            if (format_.restartInterval < 0) {
+                throw lau::InvalidArgument("Invalid Argument: the restart interval is negative");
+            }
+            if (format_.restartInterval != 0) {
+                storage_.Write(reinterpret_cast<const char*>(&format_), 0, sizeof(FormatNode_));
+            }
+            WriteHead_();
+            storage_.EndOperation();
         } else {
-            list_.read(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
+            storage_.Read(reinterpret_cast<char*>(&format_.magic), 0, sizeof(format_.magic));
+            if (format_.magic == kMagic_) storage_.Read(reinterpret_cast<char*>(&format_), 0, sizeof(FormatNode_));
+            else format_.restartInterval = 0; // the file starts with the first node
+            storage_.Read(reinterpret_cast<char*>(&head_), HeadPtr_(), sizeof(FirstNode_));
         }
     }
 
@@ -108,6 +329,9 @@ public:
      * @return whether the operation is successful or not
      */
     bool Insert(const KeyType1& key1, const KeyType2& key2, const ValueType& value) {
+        auto lock = WriteLock_();
+        if (format_.restartInterval != 0) return InsertFrontCoded_(Node_{key1, key2, value});
+
         // Search the place to accommodate to new pair
         auto [mainNodePtr, index] = Find_(key1, key2);
 
@@ -117,40 +341,33 @@ public:
             NewNode_(mainNode, 0);
 
             // put the new node into cache (store the data in memory to boost efficiency)
-            cachedNode_.key1 = key1;
-            cachedNode_.key2 = key2;
-            cachedNode_.value = value;
-            cached = true;
+            cache_.Put(std::make_pair(key1, key2), value);
 
+            storage_.EndOperation();
             return true;
         }
 
         // Get the main node
         MainNode_ mainNode; // the place to place the new node
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+        ReadMainNode_(mainNodePtr, mainNode);
 
         Node_ tmpNode;
         if (mainNode.pre == 0 && (key1 < mainNode.key1 || (key1 == mainNode.key1 && key2 < mainNode.key2))) {
             // Push back the data
-            char* buffer = Read_(mainNode.target, mainNode.count * sizeof(Node_));
-            Write_(buffer, mainNode.target + sizeof(Node_), mainNode.count * sizeof(Node_));
-            delete[] buffer;
+            Move_(mainNode.target, mainNode.target + sizeof(Node_), mainNode.count * sizeof(Node_));
 
             // Move the data in main node to the first node of its array
             tmpNode.key1 = mainNode.key1;
             tmpNode.key2 = mainNode.key2;
             tmpNode.value = mainNode.value;
-            list_.seekp(mainNode.target);
-            list_.write(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+            WriteNode_(mainNode.target, tmpNode);
 
             // set the new data in the main node
             mainNode.key1 = key1;
             mainNode.key2 = key2;
             mainNode.value = value;
             ++(mainNode.count);
-            list_.seekp(mainNodePtr);
-            list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+            WriteMainNode_(mainNodePtr, mainNode);
 
         } else {
             // Rule out the case of the same node
@@ -158,27 +375,21 @@ public:
                 return false;
             }
             if (index != -1) {
-                list_.seekg(mainNode.target + index * sizeof(Node_));
-                list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+                ReadNode_(mainNode.target + index * sizeof(Node_), tmpNode);
                 if (tmpNode.key1 == key1 && tmpNode.key2 == key2) return false;
             }
 
             // Move the node(s) after the node to be inserted
-            char* buffer = Read_(mainNode.target + (index + 1) * sizeof(Node_),
-                                 (mainNode.count - index - 1) * sizeof(Node_));
-            Write_(buffer, mainNode.target + (index + 2) * sizeof(Node_),
-                   (mainNode.count - index - 1) * sizeof(Node_));
-            delete[] buffer;
+            Move_(mainNode.target + (index + 1) * sizeof(Node_), mainNode.target + (index + 2) * sizeof(Node_),
+                  (mainNode.count - index - 1) * sizeof(Node_));
 
             // Put the new node
             Node_ newNode{key1, key2, value};
-            list_.seekp(mainNode.target + (index + 1) * sizeof(Node_));
-            list_.write(reinterpret_cast<char*>(&newNode), sizeof(Node_));
+            WriteNode_(mainNode.target + (index + 1) * sizeof(Node_), newNode);
 
             // Change the main node
             ++(mainNode.count);
-            list_.seekp(mainNodePtr);
-            list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+            WriteMainNode_(mainNodePtr, mainNode);
         }
 
         // Split the main node if it is larger its expected size
@@ -187,11 +398,9 @@ public:
         }
 
         // put the new node into cache (store the data in memory to boost efficiency)
-        cachedNode_.key1 = key1;
-        cachedNode_.key2 = key2;
-        cachedNode_.value = value;
-        cached = true;
+        cache_.Put(std::make_pair(key1, key2), value);
 
+        storage_.EndOperation();
         return true;
     }
 
@@ -202,10 +411,10 @@ public:
      * @return whether the operation is successful or not
      */
     bool Erase(const KeyType1& key1, const KeyType2& key2) {
+        auto lock = WriteLock_();
         // De-cache the node if it is really in cache
-        if (cached && cachedNode_.key1 == key1 && cachedNode_.key2 == key2) {
-            cached = false;
-        }
+        cache_.Erase(std::make_pair(key1, key2));
+        if (format_.restartInterval != 0) return EraseFrontCoded_(key1, key2);
 
         // Find the exact place of the node to be erased
         auto [mainNodePtr, index] = FindExact_(key1, key2);
@@ -214,44 +423,37 @@ public:
         // Get the main node
         MainNode_ mainNode;
         Node_ tmpNode;
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+        ReadMainNode_(mainNodePtr, mainNode);
 
         if (index == -1) { // the case that the data is in the main node
             if (mainNode.count == 0) { // the case that the main node has no other members
                 DeleteNode_(mainNode, mainNodePtr);
             } else { // the case that the main node has other members
                 // Set the main node
-                list_.seekg(mainNode.target);
-                list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+                ReadNode_(mainNode.target, tmpNode);
                 mainNode.key1 = tmpNode.key1;
                 mainNode.key2 = tmpNode.key2;
                 mainNode.value = tmpNode.value;
                 --(mainNode.count);
 
                 // Put the main Node
-                list_.seekp(mainNodePtr);
-                list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+                WriteMainNode_(mainNodePtr, mainNode);
 
                 // Move forward the other nodes
-                char* buffer = Read_(mainNode.target + sizeof(Node_), mainNode.count * sizeof(Node_));
-                Write_(buffer, mainNode.target, mainNode.count * sizeof(Node_));
-                delete[] buffer;
+                Move_(mainNode.target + sizeof(Node_), mainNode.target,
+                      mainNode.count * sizeof(Node_));
             }
         } else { // the case that the data is in the array of the main node
             // Set and put the main node
             --(mainNode.count);
-            list_.seekp(mainNodePtr);
-            list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+            WriteMainNode_(mainNodePtr, mainNode);
 
             // Move forward the other nodes
-            char* buffer = Read_(mainNode.target + (index + 1) * sizeof(Node_),
-                                 (mainNode.count - index) * sizeof(Node_));
-            Write_(buffer, mainNode.target + index * sizeof(Node_),
-                   (mainNode.count - index) * sizeof(Node_));
-            delete[] buffer;
+            Move_(mainNode.target + (index + 1) * sizeof(Node_), mainNode.target + index * sizeof(Node_),
+                  (mainNode.count - index) * sizeof(Node_));
         }
 
+        storage_.EndOperation();
         return true;
     }
 
@@ -263,33 +465,31 @@ public:
      * @return whether the operation is successful or not
      */
     bool Modify(const KeyType1& key1, const KeyType2& key2, const ValueType& value) {
-        // Change cache the node if it is really in cache
-        if (cached && cachedNode_.key1 == key1 && cachedNode_.key2 == key2) {
-            cachedNode_.value = value;
-        }
+        auto lock = WriteLock_();
+        if (format_.restartInterval != 0) return ModifyFrontCoded_(key1, key2, value);
 
         // Find the Node
         auto [mainNodePtr, index] = FindExact_(key1, key2);
         if (mainNodePtr == -1) return false; // no such node
 
+        // Change the node in cache
+        cache_.Put(std::make_pair(key1, key2), value);
+
         // Get the main node
         MainNode_ mainNode;
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+        ReadMainNode_(mainNodePtr, mainNode);
 
         if (index == -1) { // the case that the data is in the main node
             mainNode.value = value;
-            list_.seekp(mainNodePtr);
-            list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+            WriteMainNode_(mainNodePtr, mainNode);
         } else { // the case that the data is in the array of the main node
             Node_ tmpNode;
-            list_.seekg(mainNode.target + index * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+            ReadNode_(mainNode.target + index * sizeof(Node_), tmpNode);
             tmpNode.value = value; // Modify the value
-            list_.seekp(mainNode.target + index * sizeof(Node_));
-            list_.write(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+            WriteNode_(mainNode.target + index * sizeof(Node_), tmpNode);
         }
 
+        storage_.EndOperation();
         return true;
     }
 
@@ -298,12 +498,13 @@ public:
      * @return reference of the current class
      */
     FileDoubleUnrolledLinkedList& Clear() {
+        auto lock = WriteLock_();
         head_.nextGarbage = head_.next;
         head_.next = 0;
         head_.pre = 0;
-        list_.seekp(0);
-        list_.write(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
-        cached = false;
+        WriteHead_();
+        storage_.EndOperation();
+        cache_.Clear();
         return *this;
     }
 
@@ -315,35 +516,9 @@ public:
      * or not
      */
     [[nodiscard]] bool Exist(const KeyType1& key1, const KeyType2& key2) const {
-        // Check if it is cached
-        if (cached && cachedNode_.key1 == key1 && cachedNode_.key2 == key2) {
-            return true;
-        }
-
-        auto [mainNodePtr, offset] = FindExact_(key1, key2);
-        if (mainNodePtr == -1) return false; // no such node
-
-        MainNode_ mainNode;
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-        if (offset == -1) {
-            cachedNode_.key1 = mainNode.key1;
-            cachedNode_.key2 = mainNode.key2;
-            cachedNode_.value = mainNode.value;
-            cached = true;
-            return true;
-
-        } else {
-            Node_ tmpNode;
-            list_.seekg(mainNode.target + offset * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-
-            cachedNode_.key1 = tmpNode.key1;
-            cachedNode_.key2 = tmpNode.key2;
-            cachedNode_.value = tmpNode.key;
-            cached = true;
-            return true;
-        }
+        auto lock = ReadLock_();
+        ValueType value;
+        return Lookup_(key1, key2, value);
     }
 
     /**
@@ -357,35 +532,10 @@ public:
      * default constructor).
      */
     [[nodiscard]] ValueType Get(const KeyType1& key1, const KeyType2& key2) const {
-        // Check if it is cached
-        if (cached && cachedNode_.key1 == key1 && cachedNode_.key2 == key2) {
-            return cachedNode_.value;
-        }
-
-        auto [mainNodePtr, offset] = FindExact_(key1, key2);
-        if (mainNodePtr == -1) return ValueType(); // no such node
-
-        MainNode_ mainNode;
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-        if (offset == -1) {
-            cachedNode_.key1 = mainNode.key1;
-            cachedNode_.key2 = mainNode.key2;
-            cachedNode_.value = mainNode.value;
-            cached = true;
-            return cachedNode_.value;
-
-        } else {
-            Node_ tmpNode;
-            list_.seekg(mainNode.target + offset * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-
-            cachedNode_.key1 = tmpNode.key1;
-            cachedNode_.key2 = tmpNode.key2;
-            cachedNode_.value = tmpNode.value;
-            cached = true;
-            return cachedNode_.value;
-        }
+        auto lock = ReadLock_();
+        ValueType value;
+        if (!Lookup_(key1, key2, value)) return ValueType(); // no such node
+        return value;
     }
 
     /**
@@ -401,58 +551,86 @@ public:
      * If there is no such node, a nullptr will be returned instead.
      */
     [[nodiscard]] ValueType* GetWithPointer(const KeyType1& key1, const KeyType2& key2) const {
-        // Check if it is cached
-        if (cached && cachedNode_.key1 == key1 && cachedNode_.key2 == key2) {
-            return new ValueType(cachedNode_.value);
-        }
+        auto lock = ReadLock_();
+        ValueType value;
+        if (!Lookup_(key1, key2, value)) return nullptr; // no such node
+        return new ValueType(value);
+    }
 
-        auto [mainNodePtr, offset] = FindExact_(key1, key2);
-        if (mainNodePtr == -1) return nullptr; // no such node
+    /**
+     * Get the corresponding values of a batch of key pairs.  The key pairs
+     * are sorted and looked up in one forward pass over the main nodes,
+     * so each main node and its array are read at most once.  The cache
+     * is neither checked nor filled.
+     * @param keys the key pairs to search (not necessarily sorted or
+     * distinct)
+     * @return the values in the order of the key pairs.
+     * <br>
+     * If there is no such node, the value will be the default value
+     * (calling the default constructor).
+     */
+    [[nodiscard]] std::vector<ValueType> MultiGet(const std::vector<std::pair<KeyType1, KeyType2>>& keys) const {
+        auto lock = ReadLock_();
+        std::vector<ValueType> values(keys.size());
+        if (head_.next == 0) return values;
+
+        // Visit the key pairs in order
+        std::vector<SizeT> order(keys.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&keys](SizeT lhs, SizeT rhs) { return keys[lhs] < keys[rhs]; });
+
+        MainNode_ mainNode, next;
+        ReadMainNode_(head_.next, mainNode);
+        if (mainNode.next != 0) ReadMainNode_(mainNode.next, next);
+        const Node_* array = nullptr; // read when a key pair is in the array
+        for (SizeT i : order) {
+            const KeyType1& key1 = keys[i].first;
+            const KeyType2& key2 = keys[i].second;
+
+            // Move to the last main node that is not greater than the key pair
+            while (mainNode.next != 0 && !(key1 < next.key1 || (key1 == next.key1 && key2 < next.key2))) {
+                mainNode = next;
+                if (mainNode.next != 0) ReadMainNode_(mainNode.next, next);
+                array = nullptr;
+            }
 
-        MainNode_ mainNode;
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-        if (offset == -1) {
-            cachedNode_.key1 = mainNode.key1;
-            cachedNode_.key2 = mainNode.key2;
-            cachedNode_.value = mainNode.value;
-            cached = true;
-            return new ValueType(mainNode.value);
-        } else {
-            Node_ tmpNode;
-            list_.seekg(mainNode.target + offset * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-
-            cachedNode_.key1 = tmpNode.key1;
-            cachedNode_.key2 = tmpNode.key2;
-            cachedNode_.value = tmpNode.value;
-            cached = true;
-            return new ValueType(tmpNode.value);
+            if (key1 < mainNode.key1 || (key1 == mainNode.key1 && key2 < mainNode.key2)) continue; // less than all
+            if (key1 == mainNode.key1 && key2 == mainNode.key2) {
+                values[i] = mainNode.value;
+                continue;
+            }
+            if (mainNode.count == 0) continue;
+            if (array == nullptr) array = ReadArray_(mainNode);
+            const Node_* node = std::lower_bound(array, array + mainNode.count, keys[i],
+                                                 [](const Node_& lhs, const std::pair<KeyType1, KeyType2>& rhs) {
+                                                     return lhs.key1 < rhs.first
+                                                            || (lhs.key1 == rhs.first && lhs.key2 < rhs.second);
+                                                 });
+            if (node != array + mainNode.count && node->key1 == key1 && node->key2 == key2) values[i] = node->value;
         }
+        return values;
     }
 
     /**
-     * Get all the key-value pair in the list.
+     * Get all the key-value pair in the list.  The list cannot be modified
+     * until all the pairs are read; to traverse the list while it is
+     * modified, traverse a snapshot instead (see <code>TakeSnapshot</code>).
      * @return the <code>std::vector</code> class containing all the
      * <code>Node</code>s in the list
      */
     std::vector<Node> Traverse() const {
+        auto lock = ReadLock_();
         std::vector<Node> values; // can be optimized
         MainNode_ mainNode;
-        Node node;
         Ptr mainPtr = head_.next;
         while (mainPtr != 0) {
-            list_.seekg(mainPtr);
-            list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+            ReadMainNode_(mainPtr, mainNode);
             values.emplace_back(Node{mainNode.key1, mainNode.key2, mainNode.value});
-            for (SizeT i = 0; i < mainNode.count; ++i) {
-                list_.seekg(mainNode.target + i * sizeof(Node_));
-                list_.read(reinterpret_cast<char*>(&node), sizeof(Node_));
-                values.emplace_back(node);
-            }
+            const Node_* array = ReadArray_(mainNode);
+            values.insert(values.end(), array, array + mainNode.count);
             mainPtr = mainNode.next;
         }
-        return std::move(values);
+        return values;
     }
 
     /**
@@ -462,51 +640,74 @@ public:
      * <code>Node</code>s with key1
      */
     std::vector<Node> Traverse(const KeyType1& key1) const {
-        std::vector<Node> values; // can be optimized
+        std::vector<Node> values;
+        ForEach(key1, [&values](const Node& node) { values.push_back(node); });
+        return values;
+    }
 
+    /**
+     * Call the function for each key-value pair with a certain key1 in
+     * order, without putting them in a container.  The array of each
+     * main node is read with one read.
+     * <br><br>
+     * The function MUST NOT call the functions of the list, since the list
+     * is locked until all the pairs are visited.
+     * @tparam Function a function that can be called with
+     * <code>const Node&</code>
+     * @param key1
+     * @param function
+     * @return the number of key-value pairs with key1
+     */
+    template <class Function>
+    SizeT ForEach(const KeyType1& key1, Function&& function) const {
+        auto lock = ReadLock_();
         auto [mainNodePtr, offset] = SingleFind_(key1);
 
         // The case of there are no such key
-        if (mainNodePtr == -1) {
-            return std::move(values);
-        }
+        if (mainNodePtr == -1) return 0;
 
+        SizeT number = 0;
         MainNode_ mainNode;
-        Node node;
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-        if (offset != -1) {
-            // Traverse all the data in the array of the main node
-            for (SizeT i = offset; i < mainNode.count; ++i) {
-                list_.seekg(mainNode.target + i * sizeof(Node_));
-                list_.read(reinterpret_cast<char*>(&node), sizeof(Node_));
-                if (!(node.key1 == key1)) break;
-                values.emplace_back(node);
-            }
-
-            // Move to the next node
-            mainNodePtr = mainNode.next;
-            list_.seekg(mainNodePtr);
-            list_.read(reinterpret_cast<char*>(&mainNode), sizeof(mainNode));
+        ReadMainNode_(mainNodePtr, mainNode);
+        if (offset == -1) {
+            offset = 0;
+            function(Node{mainNode.key1, mainNode.key2, mainNode.value});
+            ++number;
         }
-        while (mainNode.key1 == key1) {
-            values.emplace_back(Node{mainNode.key1, mainNode.key2, mainNode.value});
-
-            // Traverse all the data in the array of the main node
-            for (SizeT i = 0; i < mainNode.count; ++i) {
-                list_.seekg(mainNode.target + i * sizeof(Node_));
-                list_.read(reinterpret_cast<char*>(&node), sizeof(Node_));
-                if (!(node.key1 == key1)) break;
-                values.emplace_back(node);
+        while (true) {
+            // Traverse the data in the array of the main node
+            const Node_* array = ReadArray_(mainNode, offset);
+            for (SizeT i = 0; i < mainNode.count - offset; ++i) {
+                if (!(array[i].key1 == key1)) return number;
+                function(array[i]);
+                ++number;
             }
 
             // Move to the next node
-            if (mainNode.next == 0) break;
-            mainNodePtr = mainNode.next;
-            list_.seekg(mainNodePtr);
-            list_.read(reinterpret_cast<char*>(&mainNode), sizeof(mainNode));
+            if (mainNode.next == 0) return number;
+            ReadMainNode_(mainNode.next, mainNode);
+            if (!(mainNode.key1 == key1)) return number;
+            function(Node{mainNode.key1, mainNode.key2, mainNode.value});
+            ++number;
+            offset = 0;
         }
-        return std::move(values);
+    }
+
+    /**
+     * Take a snapshot of the list, which can be read while the list is
+     * modified (see <code>Snapshot</code>).  The snapshot sees the list as
+     * it is now until the snapshot is destroyed.
+     * <br><br>
+     * WARNING: The pages modified after the snapshot is taken are copied
+     * in memory while the snapshot exists, so destroy the snapshot as soon
+     * as it is not needed.
+     * @return the snapshot of the list
+     */
+    [[nodiscard]] Snapshot TakeSnapshot() const {
+        auto lock = WriteLock_();
+        SizeT version = ++(versions_->last);
+        versions_->pinned.insert(version);
+        return Snapshot(this, version, head_.next);
     }
 
     /**
@@ -514,7 +715,8 @@ public:
      * @return reference of the current class
      */
     FileDoubleUnrolledLinkedList& Flush() {
-        list_.flush();
+        auto lock = WriteLock_();
+        storage_.Flush();
         return *this;
     }
 
@@ -523,12 +725,39 @@ public:
      * @return the boolean of whether the list is empty
      */
     [[nodiscard]] bool Empty() const {
+        auto lock = ReadLock_();
         return (head_.next == 0);
     }
 
+    /**
+     * Get the cache of the key-value pairs, which tells the numbers of
+     * hits and misses.
+     * @return the cache
+     */
+    [[nodiscard]] const ClockCache<std::pair<KeyType1, KeyType2>, ValueType>& Cache() const noexcept {
+        return cache_;
+    }
+
+    /**
+     * Change the number of key-value pairs cached in memory.
+     * @param cacheSize the number of pairs (0 to disable the cache)
+     * @return reference of the current class
+     */
+    FileDoubleUnrolledLinkedList& ResizeCache(SizeT cacheSize) {
+        auto lock = WriteLock_();
+        cache_.Resize(cacheSize);
+        return *this;
+    }
+
 private:
     typedef Node Node_;
 
+    using Length_ = std::uint32_t;
+
+    constexpr static SizeT kPageSize_ = 4096; // the size of the pages copied for the snapshots
+    constexpr static std::uint64_t kMagic_ = 0x4c41554644554c4cULL; // "LAUFDULL"
+    constexpr static SizeT kKeyBytes_ = sizeof(KeyType1) + sizeof(KeyType2); // the bytes of a key pair
+
     /**
      * @struct FirstNode_{next, pre, nextGarbage, nodeSize, maxNodeSize}
      *
@@ -542,6 +771,18 @@ private:
         SizeT maxNodeSize;
     };
 
+    /**
+     * @struct FormatNode_{magic, restartInterval}
+     *
+     * The node at the front of a file whose keys are front coded, which is
+     * followed by the first node.  The other files start with the first
+     * node, whose first main node can never be at the magic number.
+     */
+    struct FormatNode_ {
+        std::uint64_t magic;
+        SizeT         restartInterval; // 0 if the keys are not front coded
+    };
+
     /**
      * @struct MainNode_{key1, key2, value, target, count, next, pre}
      *
@@ -558,6 +799,25 @@ private:
         Ptr       pre;
     };
 
+    /**
+     * Find the main node whose range may contain the key pair, i.e. the
+     * last main node that is not greater than the key pair, or the first
+     * main node if the key pair is less than all the keys.
+     * @param key1
+     * @param key2
+     * @param mainNode the place to put the main node
+     * @return the place of the main node, or 0 if the list is empty
+     */
+    Ptr Locate_(const KeyType1& key1, const KeyType2& key2, MainNode_& mainNode) const {
+        if (head_.next == 0) return 0;
+        Ptr ptr = head_.pre;
+        ReadMainNode_(ptr, mainNode);
+        while ((key1 < mainNode.key1 || (key1 == mainNode.key1 && key2 < mainNode.key2)) && mainNode.pre != 0) {
+            ptr = mainNode.pre;
+            ReadMainNode_(ptr, mainNode);
+        }
+        return ptr;
+    }
 
     /**
      * This function return a pair of the pointer to the main node
@@ -574,14 +834,12 @@ private:
 
         MainNode_ tmp;
         Ptr Ptr = head_.pre;
-        list_.seekg(head_.pre);
-        list_.read(reinterpret_cast<char*>(&tmp), sizeof(MainNode_));
+        ReadMainNode_(head_.pre, tmp);
 
         // Searching for the approximate place (only the main node)
         while ((key1 < tmp.key1 || (key1 == tmp.key1 && key2 < tmp.key2)) && tmp.pre != 0) {
             Ptr = tmp.pre;
-            list_.seekg(Ptr);
-            list_.read(reinterpret_cast<char*>(&tmp), sizeof(MainNode_));
+            ReadMainNode_(Ptr, tmp);
         }
 
         // Searching for the exact place
@@ -594,22 +852,19 @@ private:
         SizeT leftIndex = 0, rightIndex = tmp.count - 1;
 
         // the case that the key is between the main node and the first node
-        list_.seekg(tmp.target);
-        list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+        ReadNode_(tmp.target, tmpNode);
         if (key1 < tmpNode.key1 || (key1 == tmpNode.key1 && key2 < tmpNode.key2)) {
             return std::make_pair(Ptr, -1);
         }
 
         // the case that the key is right after the last node
-        list_.seekg(tmp.target + (tmp.count - 1) * sizeof(Node_));
-        list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+        ReadNode_(tmp.target + (tmp.count - 1) * sizeof(Node_), tmpNode);
         if (tmpNode.key1 < key1 || (tmpNode.key1 == key1 && (tmpNode.key2 < key2 || tmpNode.key2 == key2))) {
             return std::make_pair(Ptr, tmp.count - 1);
         }
 
         while (rightIndex - leftIndex > 1) {
-            list_.seekg(tmp.target + ((rightIndex + leftIndex) / 2) * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+            ReadNode_(tmp.target + ((rightIndex + leftIndex) / 2) * sizeof(Node_), tmpNode);
             if (key1 < tmpNode.key1 || (key1 == tmpNode.key1 && key2 < tmpNode.key2)) {
                 rightIndex = (rightIndex + leftIndex) / 2;
             } else {
@@ -625,52 +880,58 @@ private:
      * and the number of node the target is right after, for the case
      * of the main node, the second member of the pair is -1.  If the
      * key doesn't belongs to the unrolled linked list, it will return
-     * {-1, -1}.
+     * {-1, -1}.  If the keys are front coded, only the nodes from the
+     * restart point before the key are decoded.
      * @param key1
      * @param key2
+     * @param value the place to put the value of the node, or nullptr not
+     * to get the value
      * @return a pair of the pointer to the main node and the offset
      */
-    std::pair<Ptr, SizeT> FindExact_(const KeyType1& key1, const KeyType2& key2) const {
-        if (head_.next == 0) return std::make_pair(-1, -1);
-
-        MainNode_ tmp;
-        Ptr Ptr = head_.pre;
-        list_.seekg(head_.pre);
-        list_.read(reinterpret_cast<char*>(&tmp), sizeof(MainNode_));
-
+    std::pair<Ptr, SizeT> FindExact_(const KeyType1& key1, const KeyType2& key2, ValueType* value = nullptr) const {
         // Searching for the approximate place (only the main node)
-        while ((key1 < tmp.key1 || (key1 == tmp.key1 && key2 < tmp.key2)) && tmp.pre != 0) {
-            Ptr = tmp.pre;
-            list_.seekg(Ptr);
-            list_.read(reinterpret_cast<char*>(&tmp), sizeof(MainNode_));
-        }
+        MainNode_ tmp;
+        Ptr Ptr = Locate_(key1, key2, tmp);
+        if (Ptr == 0) return std::make_pair(-1, -1);
 
         // Searching for the exact place
 
         if (tmp.pre == 0 && (key1 < tmp.key1 || (key1 == tmp.key1 && key2 < tmp.key2))) return std::make_pair(-1, -1);
 
-        if (key1 == tmp.key1 && key2 == tmp.key2) return std::make_pair(Ptr, -1);
+        if (key1 == tmp.key1 && key2 == tmp.key2) {
+            if (value != nullptr) *value = tmp.value;
+            return std::make_pair(Ptr, -1);
+        }
 
         if (tmp.count == 0) return std::make_pair(-1, -1);
 
         Node_ tmpNode;
+        if (format_.restartInterval != 0) {
+            SizeT index = PartitionFrontCoded_(ReadFrontCoded_(tmp), tmp.count, [&key1, &key2](const Node_& node) {
+                return node.key1 < key1 || (node.key1 == key1 && node.key2 < key2);
+            }, tmpNode);
+            if (index == tmp.count || !(tmpNode.key1 == key1 && tmpNode.key2 == key2)) return std::make_pair(-1, -1);
+            if (value != nullptr) *value = tmpNode.value;
+            return std::make_pair(Ptr, index);
+        }
+
         SizeT leftIndex = 0, rightIndex = tmp.count - 1;
 
         // the case that the key is between the main node and the first node
-        list_.seekg(tmp.target);
-        list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+        ReadNode_(tmp.target, tmpNode);
         if (key1 < tmpNode.key1 || (key1 == tmpNode.key1 && key2 < tmpNode.key2)) return std::make_pair(-1, -1);
 
         // the case that the key is right after the last node
-        list_.seekg(tmp.target + (tmp.count - 1) * sizeof(Node_));
-        list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+        ReadNode_(tmp.target + (tmp.count - 1) * sizeof(Node_), tmpNode);
         if (tmpNode.key1 < key1 || (tmpNode.key1 == key1 && tmpNode.key2 < key2)) return std::make_pair(-1, -1);
 
-        if (tmpNode.key1 == key1 && tmpNode.key2 == key2) return std::make_pair(Ptr, tmp.count - 1);
+        if (tmpNode.key1 == key1 && tmpNode.key2 == key2) {
+            if (value != nullptr) *value = tmpNode.value;
+            return std::make_pair(Ptr, tmp.count - 1);
+        }
 
         while (rightIndex - leftIndex > 1) {
-            list_.seekg(tmp.target + ((rightIndex + leftIndex) / 2) * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+            ReadNode_(tmp.target + ((rightIndex + leftIndex) / 2) * sizeof(Node_), tmpNode);
             if (key1 < tmpNode.key1 || (key1 == tmpNode.key1 && key2 < tmpNode.key2)) {
                 rightIndex = (rightIndex + leftIndex) / 2;
             } else {
@@ -678,10 +939,10 @@ private:
             }
         }
 
-        list_.seekg(tmp.target + leftIndex * sizeof(Node_));
-        list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-        if (tmpNode.key1 == key1 && tmpNode.key2 == key2) return std::make_pair(Ptr, leftIndex);
-        else return std::make_pair(-1, -1);
+        ReadNode_(tmp.target + leftIndex * sizeof(Node_), tmpNode);
+        if (!(tmpNode.key1 == key1 && tmpNode.key2 == key2)) return std::make_pair(-1, -1);
+        if (value != nullptr) *value = tmpNode.value;
+        return std::make_pair(Ptr, leftIndex);
     }
 
     /**
@@ -699,22 +960,19 @@ private:
 
         MainNode_ tmp;
         Ptr ptr = head_.pre;
-        list_.seekg(head_.pre);
-        list_.read(reinterpret_cast<char*>(&tmp), sizeof(MainNode_));
+        ReadMainNode_(head_.pre, tmp);
         bool exist = false;
 
         // Searching for the approximate place (only the main node)
         while ((key1 < tmp.key1 || key1 == tmp.key1) && tmp.pre != 0) {
             if (!exist && key1 == tmp.key1) exist = true;
             ptr = tmp.pre;
-            list_.seekg(ptr);
-            list_.read(reinterpret_cast<char*>(&tmp), sizeof(MainNode_));
+            ReadMainNode_(ptr, tmp);
         }
         if (exist) {
             while (key1 == tmp.key1 && tmp.pre != 0) {
                 ptr = tmp.pre;
-                list_.seekg(ptr);
-                list_.read(reinterpret_cast<char*>(&tmp), sizeof(MainNode_));
+                ReadMainNode_(ptr, tmp);
             }
         }
 
@@ -729,51 +987,66 @@ private:
             else return std::make_pair(-1, -1);
         }
 
-        Node_ tmpNode;
-        SizeT leftIndex = 0, rightIndex = tmp.count - 1;
-
+        // Search the first node with key1 in the array with one read
+        const Node_* array = ReadArray_(tmp);
+        SizeT index = std::lower_bound(array, array + tmp.count, key1,
+                                       [](const Node_& lhs, const KeyType1& rhs) { return lhs.key1 < rhs; })
+                      - array;
         if (exist) {
-            // for the last node
-            list_.seekg(tmp.target + (tmp.count - 1) * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-            if (tmpNode.key1 < key1) return std::make_pair(tmp.next, -1);
-
-            // for the first node
-            list_.seekg(tmp.target);
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-            if (tmpNode.key1 == key1) return std::make_pair(ptr, 0);
-
-            while (rightIndex - leftIndex > 1) {
-                list_.seekg(tmp.target + ((rightIndex + leftIndex) / 2) * sizeof(Node_));
-                list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-                if (key1 == tmpNode.key1) rightIndex = (rightIndex + leftIndex) / 2;
-                else leftIndex = (rightIndex + leftIndex) / 2;
-            }
-            return std::make_pair(ptr, rightIndex);
+            // All the nodes in the array are less than key1
+            if (index == tmp.count) return std::make_pair(tmp.next, -1);
+            return std::make_pair(ptr, index);
         } else {
-            // the case that the key is between the main node and the first node
-            list_.seekg(tmp.target);
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-            if (key1 < tmpNode.key1) return std::make_pair(-1, -1);
-            if (key1 == tmpNode.key1) return std::make_pair(ptr, 0);
-
-            // the case that the key is right after the last node
-            list_.seekg(tmp.target + (tmp.count - 1) * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-            if (tmpNode.key1 < key1) return std::make_pair(-1, -1);
-
-            while (rightIndex - leftIndex > 1) {
-                list_.seekg(tmp.target + ((rightIndex + leftIndex) / 2) * sizeof(Node_));
-                list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-                if (tmpNode.key1 < key1) leftIndex = (rightIndex + leftIndex) / 2;
-                else rightIndex = (rightIndex + leftIndex) / 2;
-            }
+            if (index == tmp.count || !(array[index].key1 == key1)) return std::make_pair(-1, -1);
+            return std::make_pair(ptr, index);
+        }
+    }
 
-            list_.seekg(tmp.target + rightIndex * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-            if (tmpNode.key1 == key1) return std::make_pair(ptr, rightIndex);
-            else return std::make_pair(-1, -1);
+    /**
+     * Read the nodes in the array of a main node from the start with one
+     * read.  If the keys are front coded, the whole array is decoded.  The
+     * nodes are valid until the next call of this function in the same
+     * thread.
+     * @param mainNode
+     * @param start the index of the first node to read
+     * @return the pointer to the node at the start
+     */
+    const Node_* ReadArray_(const MainNode_& mainNode, SizeT start = 0) const {
+        static thread_local std::vector<Node_> buffer; // one for each thread to read in parallel
+        if (format_.restartInterval != 0) {
+            if (static_cast<SizeT>(buffer.size()) < mainNode.count) buffer.resize(mainNode.count);
+            if (mainNode.count > 0) DecodeFrontCoded_(ReadFrontCoded_(mainNode), mainNode.count, buffer.data());
+            return buffer.data() + start;
         }
+        SizeT count = mainNode.count - start;
+        if (static_cast<SizeT>(buffer.size()) < count) buffer.resize(count);
+        storage_.Read(reinterpret_cast<char*>(buffer.data()), mainNode.target + start * sizeof(Node_),
+                      count * sizeof(Node_));
+        return buffer.data();
+    }
+
+    /**
+     * Look up the value of the key pair in the cache first, and then in
+     * the file.  The pair found in the file will be cached.
+     * @param key1
+     * @param key2
+     * @param value the place to put the value
+     * @return whether there exists such a node
+     */
+    bool Lookup_(const KeyType1& key1, const KeyType2& key2, ValueType& value) const {
+        {
+            std::shared_lock<std::shared_mutex> lock(latches_->cache);
+            const ValueType* cachedValue = cache_.Get(std::make_pair(key1, key2));
+            if (cachedValue != nullptr) {
+                value = *cachedValue;
+                return true;
+            }
+        }
+
+        if (FindExact_(key1, key2, &value).first == -1) return false; // no such node
+        std::unique_lock<std::shared_mutex> lock(latches_->cache);
+        cache_.Put(std::make_pair(key1, key2), value);
+        return true;
     }
 
     /**
@@ -783,66 +1056,53 @@ private:
      */
     void DeleteNode_(MainNode_& mainNode, Ptr target) {
         MainNode_ pre, next;
+        Ptr prePtr = mainNode.pre, nextPtr = mainNode.next;
 
         // Change the node to be deleted
         mainNode.pre = 0;
         mainNode.next = head_.nextGarbage;
         mainNode.count = 0;
-        list_.seekp(target);
-        list_.write(reinterpret_cast<const char*>(&mainNode), sizeof(MainNode_));
+        WriteMainNode_(target, mainNode);
 
         // Change the first node
         head_.nextGarbage = target;
 
-
         // The case that the only main node is to be deleted
-        if (mainNode.pre == 0 && mainNode.next == 0) {
+        if (prePtr == 0 && nextPtr == 0) {
             head_.pre = 0;
             head_.next = 0;
-            list_.seekp(0);
-            list_.write(reinterpret_cast<const char*>(&head_), sizeof(FirstNode_));
+            WriteHead_();
             return;
         }
 
         // The case that the main node is the first main Node
-        if (mainNode.pre == 0) {
-            head_.next = mainNode.next;
-            list_.seekg(mainNode.next);
-            list_.read(reinterpret_cast<char*>(&next), sizeof(MainNode_));
+        if (prePtr == 0) {
+            head_.next = nextPtr;
+            ReadMainNode_(nextPtr, next);
             next.pre = 0;
-            list_.seekp(mainNode.next);
-            list_.write(reinterpret_cast<const char*>(&next), sizeof(MainNode_));
-            list_.seekp(0);
-            list_.write(reinterpret_cast<const char*>(&head_), sizeof(FirstNode_));
+            WriteMainNode_(nextPtr, next);
+            WriteHead_();
             return;
         }
 
         // The case that the main node is the last main node
-        if (mainNode.next == 0) {
-            head_.pre = mainNode.pre;
-            list_.seekp(mainNode.pre);
-            list_.read(reinterpret_cast<char*>(&pre), sizeof(MainNode_));
+        if (nextPtr == 0) {
+            head_.pre = prePtr;
+            ReadMainNode_(prePtr, pre);
             pre.next = 0;
-            list_.seekp(mainNode.pre);
-            list_.write(reinterpret_cast<const char*>(&pre), sizeof(MainNode_));
-            list_.seekp(0);
-            list_.write(reinterpret_cast<const char*>(&head_), sizeof(FirstNode_));
+            WriteMainNode_(prePtr, pre);
+            WriteHead_();
             return;
         }
 
         // The regular case
-        list_.seekg(mainNode.pre);
-        list_.read(reinterpret_cast<char*>(&pre), sizeof(MainNode_));
-        list_.seekg(mainNode.next);
-        list_.read(reinterpret_cast<char*>(&next), sizeof(MainNode_));
-        pre.next = mainNode.next;
-        next.pre = mainNode.pre;
-        list_.seekp(mainNode.pre);
-        list_.write(reinterpret_cast<const char*>(&pre), sizeof(MainNode_));
-        list_.seekp(mainNode.next);
-        list_.write(reinterpret_cast<const char*>(&next), sizeof(MainNode_));
-        list_.seekp(0);
-        list_.write(reinterpret_cast<const char*>(&head_), sizeof(FirstNode_));
+        ReadMainNode_(prePtr, pre);
+        ReadMainNode_(nextPtr, next);
+        pre.next = nextPtr;
+        next.pre = prePtr;
+        WriteMainNode_(prePtr, pre);
+        WriteMainNode_(nextPtr, next);
+        WriteHead_();
     }
 
     /**
@@ -858,120 +1118,96 @@ private:
     Ptr NewNode_(MainNode_& mainNode, Ptr target) {
         if (target != 0) { // for a not empty list
             MainNode_ pre, next;
-            list_.seekg(target);
-            list_.read(reinterpret_cast<char*>(&pre), sizeof(MainNode_));
+            ReadMainNode_(target, pre);
             if (pre.next != 0) { // the case that the next main node is not the first node
                 // Get the next
-                list_.seekg(pre.next);
-                list_.read(reinterpret_cast<char*>(&next), sizeof(MainNode_));
+                ReadMainNode_(pre.next, next);
 
                 // Set the previous and next node
                 if (head_.nextGarbage == 0) {
-                    list_.seekp(0, std::ios::end);
+                    // Get a new space for the node and its array
+                    Ptr newPtr = storage_.Allocate(BlockSize_());
                     mainNode.next = pre.next;
                     mainNode.pre = next.pre;
-                    pre.next = list_.tellp();
-                    next.pre = list_.tellp();
+                    pre.next = newPtr;
+                    next.pre = newPtr;
 
                     // Put the new node
-                    mainNode.target = pre.next + sizeof(MainNode_);
-                    list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-
-                    // Get a new space for its array
-                    list_.seekp(head_.maxNodeSize * sizeof(Node_), std::ios::end);
-                    list_.write(reinterpret_cast<char*>(&emptyNode_), sizeof(Node_));
+                    mainNode.target = newPtr + sizeof(MainNode_);
+                    WriteMainNode_(newPtr, mainNode);
 
                 } else {
                     MainNode_ tmpMainNode;
-                    list_.seekg(head_.nextGarbage);
-                    list_.read(reinterpret_cast<char*>(&tmpMainNode), sizeof(MainNode_));
+                    ReadMainNode_(head_.nextGarbage, tmpMainNode);
 
                     mainNode.next = pre.next;
                     mainNode.pre = next.pre;
                     mainNode.target = tmpMainNode.target;
                     pre.next = head_.nextGarbage;
                     next.pre = head_.nextGarbage;
-                    list_.seekp(head_.nextGarbage);
-                    list_.write(reinterpret_cast<const char*>(&mainNode), sizeof(MainNode_));
+                    WriteMainNode_(head_.nextGarbage, mainNode);
                     head_.nextGarbage = tmpMainNode.next;
-                    list_.seekp(0);
-                    list_.write(reinterpret_cast<const char*>(&head_), sizeof(FirstNode_));
+                    WriteHead_();
                 }
 
                 // Put back the previous and next main node
-                list_.seekp(mainNode.next);
-                list_.write(reinterpret_cast<char*>(&next), sizeof(MainNode_));
-                list_.seekp(mainNode.pre);
-                list_.write(reinterpret_cast<char*>(&pre), sizeof(MainNode_));
+                WriteMainNode_(mainNode.next, next);
+                WriteMainNode_(mainNode.pre, pre);
                 return pre.next;
             } else { // the case that the next main node is the first node
                 // Set the previous and next node
                 if (head_.nextGarbage == 0) {
-                    list_.seekp(0, std::ios::end);
+                    // Get a new space for the node and its array
+                    Ptr newPtr = storage_.Allocate(BlockSize_());
                     mainNode.next = 0;
                     mainNode.pre = target;
-                    pre.next = list_.tellp();
-                    head_.pre = list_.tellp();
+                    pre.next = newPtr;
+                    head_.pre = newPtr;
 
                     // Put the new node
-                    mainNode.target = pre.next + sizeof(MainNode_);
-                    list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-
-                    // Get a new space for its array
-                    list_.seekp(head_.maxNodeSize * sizeof(Node_), std::ios::end);
-                    list_.write(reinterpret_cast<char*>(&emptyNode_), sizeof(Node_));
+                    mainNode.target = newPtr + sizeof(MainNode_);
+                    WriteMainNode_(newPtr, mainNode);
 
                 } else {
                     MainNode_ tmpMainNode;
-                    list_.seekg(head_.nextGarbage);
-                    list_.read(reinterpret_cast<char*>(&tmpMainNode), sizeof(MainNode_));
+                    ReadMainNode_(head_.nextGarbage, tmpMainNode);
 
                     mainNode.next = 0;
                     mainNode.pre = target;
                     mainNode.target = tmpMainNode.target;
                     pre.next = head_.nextGarbage;
                     head_.pre = head_.nextGarbage;
-                    list_.seekp(head_.nextGarbage);
-                    list_.write(reinterpret_cast<const char*>(&mainNode), sizeof(MainNode_));
+                    WriteMainNode_(head_.nextGarbage, mainNode);
                     head_.nextGarbage = tmpMainNode.next;
                 }
 
                 // Put back the previous and next main node
-                list_.seekp(mainNode.pre);
-                list_.write(reinterpret_cast<char*>(&pre), sizeof(MainNode_));
-                list_.seekp(0);
-                list_.write(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
+                WriteMainNode_(mainNode.pre, pre);
+                WriteHead_();
                 return pre.next;
             }
         } else { // For an empty list
             if (head_.nextGarbage == 0) {
-                list_.seekp(0, std::ios::end);
-                head_.next = list_.tellp();
-                head_.pre = list_.tellp();
+                // Get a new space for the node and its array
+                head_.next = storage_.Allocate(BlockSize_());
+                head_.pre = head_.next;
                 mainNode.target = head_.next + sizeof(MainNode_);
                 mainNode.next = 0;
                 mainNode.pre = 0;
-                list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-
-                // to reserve the space for the array of the main node
-                list_.seekp(head_.maxNodeSize * sizeof(Node_), std::ios::end);
-                list_.write(reinterpret_cast<const char*>(&emptyNode_), sizeof(Node_));
+                WriteMainNode_(head_.next, mainNode);
             } else {
                 MainNode_ tmpMainNode;
-                list_.seekg(head_.nextGarbage);
-                list_.read(reinterpret_cast<char*>(&tmpMainNode), sizeof(MainNode_));
+                ReadMainNode_(head_.nextGarbage, tmpMainNode);
 
                 head_.next = head_.nextGarbage;
                 head_.pre = head_.nextGarbage;
                 mainNode.next = 0;
                 mainNode.pre = 0;
                 mainNode.target = tmpMainNode.target;
-                list_.seekp(head_.nextGarbage);
-                list_.write(reinterpret_cast<const char*>(&mainNode), sizeof(MainNode_));
+                WriteMainNode_(head_.nextGarbage, mainNode);
                 head_.nextGarbage = tmpMainNode.next;
             }
-            list_.seekp(0);
-            list_.write(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
+            WriteHead_();
             return head_.next;
         }
     }
@@ -985,10 +1221,8 @@ private:
     Ptr Split_(MainNode_& mainNode, Ptr mainNodePtr) {
         // Copy the extra string of nodes
         auto* nodeBuffer = new Node_[mainNode.count - head_.nodeSize];
-        for (SizeT i = 0; i < mainNode.count - head_.nodeSize; ++i) {
-            list_.seekg(mainNode.target + sizeof(Node_) * (head_.nodeSize + i));
-            list_.read(reinterpret_cast<char*>(&nodeBuffer[i]), sizeof(Node_));
-        }
+        storage_.Read(reinterpret_cast<char*>(nodeBuffer), mainNode.target + sizeof(Node_) * head_.nodeSize,
+                      sizeof(Node_) * (mainNode.count - head_.nodeSize));
 
         // Create a new node
         Ptr newMainNodePtr;
@@ -999,54 +1233,655 @@ private:
         newMainNodePtr = NewNode_(newMainNode, mainNodePtr);
 
         // Change the count of the original node
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+        ReadMainNode_(mainNodePtr, mainNode);
         mainNode.count = head_.nodeSize;
-        list_.seekp(mainNodePtr);
-        list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+        WriteMainNode_(mainNodePtr, mainNode);
 
         // Get the new main node
-        list_.seekg(newMainNodePtr);
-        list_.read(reinterpret_cast<char*>(&newMainNode), sizeof(MainNode_));
+        ReadMainNode_(newMainNodePtr, newMainNode);
 
         // write the extra string of nodes
-        list_.seekp(newMainNode.target);
-        for (SizeT i = 1; i <= newMainNode.count; ++i) {
-            list_.write(reinterpret_cast<char*>(&nodeBuffer[i]), sizeof(Node_));
-        }
+        Preserve_(newMainNode.target, sizeof(Node_) * newMainNode.count);
+        storage_.Write(reinterpret_cast<const char*>(nodeBuffer + 1), newMainNode.target,
+                       sizeof(Node_) * newMainNode.count);
         delete[] nodeBuffer;
         return newMainNodePtr;
     }
 
     /**
-     * This function reads a string of stuff and returns a pointer to the string.
-     * @param target the place to get the data
-     * @param length
-     * @return a pointer to the string
+     * Read a main node.
+     * @param ptr the place of the main node
+     * @param mainNode the place to put the main node
+     */
+    void ReadMainNode_(Ptr ptr, MainNode_& mainNode) const {
+        storage_.Read(reinterpret_cast<char*>(&mainNode), ptr, sizeof(MainNode_));
+    }
+
+    /**
+     * Write a main node.
+     * @param ptr the place of the main node
+     * @param mainNode
+     */
+    void WriteMainNode_(Ptr ptr, const MainNode_& mainNode) {
+        Preserve_(ptr, sizeof(MainNode_));
+        storage_.Write(reinterpret_cast<const char*>(&mainNode), ptr, sizeof(MainNode_));
+    }
+
+    /**
+     * Read a node in an array.
+     * @param ptr the place of the node
+     * @param node the place to put the node
+     */
+    void ReadNode_(Ptr ptr, Node_& node) const {
+        storage_.Read(reinterpret_cast<char*>(&node), ptr, sizeof(Node_));
+    }
+
+    /**
+     * Write a node in an array.
+     * @param ptr the place of the node
+     * @param node
      */
-    char* Read_(Ptr target, SizeT length) {
-        char* buffer = new char[length];
-        list_.seekg(target);
-        list_.read(buffer, length);
-        return buffer;
+    void WriteNode_(Ptr ptr, const Node_& node) {
+        Preserve_(ptr, sizeof(Node_));
+        storage_.Write(reinterpret_cast<const char*>(&node), ptr, sizeof(Node_));
     }
 
     /**
-     * This function writes a string of stuff.
-     * @param source the source pointer
-     * @param target the place to place the data
+     * @struct FrontCodedArray_{restarts, records}
+     *
+     * An array whose keys are front coded, read into memory.  In the file,
+     * the array starts with the number of bytes of the records, followed by
+     * the offsets of the records at the restart points and the records in
+     * the order of the keys.  A record is the number of bytes its key
+     * shares with the key before it (0 at a restart point), the other
+     * bytes of the key and the value, where the bytes of a key are the
+     * bytes of key1 followed by the bytes of key2.
+     */
+    struct FrontCodedArray_ {
+        const char* restarts;
+        const char* records;
+    };
+
+    /**
+     * Insert a new key-value pair into a list whose keys are front coded.
+     * The array of the main node is decoded and encoded again as a whole.
+     * @param node the new pair
+     * @return whether the operation is successful or not
+     */
+    bool InsertFrontCoded_(const Node_& node) {
+        MainNode_ mainNode;
+        Ptr mainNodePtr = Locate_(node.key1, node.key2, mainNode);
+        if (mainNodePtr == 0) { // the case of no nodes at all
+            mainNode = MainNode_{node.key1, node.key2, node.value, 0, 0, 0, 0};
+            NewNode_(mainNode, 0);
+        } else {
+            std::vector<Node_> nodes;
+            ReadBlock_(mainNode, nodes);
+            auto iter = LowerBound_(nodes, node.key1, node.key2);
+            if (iter != nodes.end() && iter->key1 == node.key1 && iter->key2 == node.key2) return false;
+            nodes.insert(iter, node);
+            PutFrontCoded_(mainNodePtr, mainNode, nodes.data(), nodes.data() + nodes.size());
+        }
+
+        // put the new node into cache (store the data in memory to boost efficiency)
+        cache_.Put(std::make_pair(node.key1, node.key2), node.value);
+
+        storage_.EndOperation();
+        return true;
+    }
+
+    /**
+     * Erase a key-value pair from a list whose keys are front coded.  The
+     * array of the main node is decoded and encoded again as a whole.
+     * @param key1
+     * @param key2
+     * @return whether the operation is successful or not
+     */
+    bool EraseFrontCoded_(const KeyType1& key1, const KeyType2& key2) {
+        MainNode_ mainNode;
+        Ptr mainNodePtr = Locate_(key1, key2, mainNode);
+        if (mainNodePtr == 0) return false; // no nodes at all
+        std::vector<Node_> nodes;
+        ReadBlock_(mainNode, nodes);
+        auto iter = LowerBound_(nodes, key1, key2);
+        if (iter == nodes.end() || !(iter->key1 == key1 && iter->key2 == key2)) return false; // no such node
+        nodes.erase(iter);
+
+        // The keys after the erased one are coded again, so the array may even grow
+        if (nodes.empty()) DeleteNode_(mainNode, mainNodePtr);
+        else PutFrontCoded_(mainNodePtr, mainNode, nodes.data(), nodes.data() + nodes.size());
+
+        storage_.EndOperation();
+        return true;
+    }
+
+    /**
+     * Modify the value of a key-value pair in a list whose keys are front
+     * coded.
+     * @param key1
+     * @param key2
+     * @param value
+     * @return whether the operation is successful or not
+     */
+    bool ModifyFrontCoded_(const KeyType1& key1, const KeyType2& key2, const ValueType& value) {
+        MainNode_ mainNode;
+        Ptr mainNodePtr = Locate_(key1, key2, mainNode);
+        if (mainNodePtr == 0) return false; // no nodes at all
+        std::vector<Node_> nodes;
+        ReadBlock_(mainNode, nodes);
+        auto iter = LowerBound_(nodes, key1, key2);
+        if (iter == nodes.end() || !(iter->key1 == key1 && iter->key2 == key2)) return false; // no such node
+        iter->value = value;
+
+        // Change the node in cache
+        cache_.Put(std::make_pair(key1, key2), value);
+
+        PutFrontCoded_(mainNodePtr, mainNode, nodes.data(), nodes.data() + nodes.size());
+        storage_.EndOperation();
+        return true;
+    }
+
+    /**
+     * Get the first node that is not less than the key pair.
+     * @param nodes the nodes in the order of the keys
+     * @param key1
+     * @param key2
+     * @return the iterator of the node
+     */
+    static typename std::vector<Node_>::iterator LowerBound_(std::vector<Node_>& nodes, const KeyType1& key1,
+                                                             const KeyType2& key2) {
+        return std::partition_point(nodes.begin(), nodes.end(), [&key1, &key2](const Node_& node) {
+            return node.key1 < key1 || (node.key1 == key1 && node.key2 < key2);
+        });
+    }
+
+    /**
+     * Read and decode the nodes of a main node whose keys are front coded,
+     * with the node in the main node first.
+     * @param mainNode
+     * @param nodes the place to put the nodes
+     */
+    void ReadBlock_(const MainNode_& mainNode, std::vector<Node_>& nodes) const {
+        nodes.resize(mainNode.count + 1);
+        nodes[0] = Node_{mainNode.key1, mainNode.key2, mainNode.value};
+        if (mainNode.count > 0) DecodeFrontCoded_(ReadFrontCoded_(mainNode), mainNode.count, nodes.data() + 1);
+    }
+
+    /**
+     * Write the nodes of a main node whose keys are front coded: the first
+     * node is kept in the main node, and the others are encoded into its
+     * array.  If they do not fit in one array, they are split in halves,
+     * and the second half is put into a new main node after it.
+     * @param mainNodePtr
+     * @param mainNode the main node, whose links MUST be up to date
+     * @param first the first node, which MUST not be the last one
+     * @param last the end of the nodes
+     */
+    void PutFrontCoded_(Ptr mainNodePtr, MainNode_& mainNode, const Node_* first, const Node_* last) {
+        SizeT bytes = EncodeFrontCoded_(first + 1, last);
+        if (bytes > ArraySize_()) {
+            const Node_* middle = first + (last - first) / 2;
+            MainNode_ newMainNode{middle->key1, middle->key2, middle->value, 0, 0, 0, 0};
+            Ptr newMainNodePtr = NewNode_(newMainNode, mainNodePtr);
+            PutFrontCoded_(newMainNodePtr, newMainNode, middle, last);
+            ReadMainNode_(mainNodePtr, mainNode); // linked to the new main node
+            PutFrontCoded_(mainNodePtr, mainNode, first, middle);
+            return;
+        }
+
+        mainNode.key1 = first->key1;
+        mainNode.key2 = first->key2;
+        mainNode.value = first->value;
+        mainNode.count = last - first - 1;
+        WriteMainNode_(mainNodePtr, mainNode);
+        if (mainNode.count == 0) return;
+        Preserve_(mainNode.target, bytes);
+        storage_.Write(codeBuffer_.data(), mainNode.target, bytes);
+    }
+
+    /**
+     * Encode the nodes into an array whose keys are front coded in the
+     * buffer of the list.
+     * @param first
+     * @param last
+     * @return the number of bytes of the array
+     */
+    SizeT EncodeFrontCoded_(const Node_* first, const Node_* last) {
+        auto count = static_cast<SizeT>(last - first);
+        SizeT restartBytes = Restarts_(count) * static_cast<SizeT>(sizeof(Length_));
+        SizeT recordBytes = VarintBytes_(kKeyBytes_) + kKeyBytes_ + static_cast<SizeT>(sizeof(ValueType)); // at most
+        codeBuffer_.resize(sizeof(SizeT) + restartBytes + count * recordBytes);
+        char* restarts = codeBuffer_.data() + sizeof(SizeT);
+        char* records = restarts + restartBytes;
+        char* record = records;
+        char key[kKeyBytes_], previous[kKeyBytes_];
+        for (SizeT i = 0; i < count; ++i) {
+            StoreKey_(key, first[i]);
+            SizeT shared = 0;
+            if (i % format_.restartInterval == 0) {
+                StoreLength_(restarts + i / format_.restartInterval * sizeof(Length_), record - records);
+            } else {
+                shared = SharedPrefix_(previous, key);
+            }
+            record = StoreVarint_(record, shared);
+            std::memcpy(record, key + shared, kKeyBytes_ - shared);
+            record += kKeyBytes_ - shared;
+            std::memcpy(record, reinterpret_cast<const char*>(&first[i].value), sizeof(ValueType));
+            record += sizeof(ValueType);
+            std::memcpy(previous, key, kKeyBytes_);
+        }
+        auto bytes = static_cast<SizeT>(record - records);
+        std::memcpy(codeBuffer_.data(), &bytes, sizeof(SizeT));
+        return static_cast<SizeT>(record - codeBuffer_.data());
+    }
+
+    /**
+     * Read an array whose keys are front coded with one read after its
+     * size.  The array is valid until the next call of this function in
+     * the same thread.
+     * @param mainNode the main node, which MUST have nodes in its array
+     * @return the array in memory
+     */
+    FrontCodedArray_ ReadFrontCoded_(const MainNode_& mainNode) const {
+        static thread_local std::vector<char> buffer; // one for each thread to read in parallel
+        SizeT bytes;
+        storage_.Read(reinterpret_cast<char*>(&bytes), mainNode.target, sizeof(SizeT));
+        SizeT restartBytes = Restarts_(mainNode.count) * static_cast<SizeT>(sizeof(Length_));
+        if (static_cast<SizeT>(buffer.size()) < restartBytes + bytes) buffer.resize(restartBytes + bytes);
+        storage_.Read(buffer.data(), mainNode.target + sizeof(SizeT), restartBytes + bytes);
+        return FrontCodedArray_{buffer.data(), buffer.data() + restartBytes};
+    }
+
+    /**
+     * Decode all the nodes of an array whose keys are front coded.
+     * @param array
+     * @param count the number of nodes in the array
+     * @param nodes the place to put the nodes
+     */
+    static void DecodeFrontCoded_(FrontCodedArray_ array, SizeT count, Node_* nodes) {
+        char key[kKeyBytes_];
+        const char* record = array.records;
+        for (SizeT i = 0; i < count; ++i) record = LoadRecord_(record, key, nodes[i]);
+    }
+
+    /**
+     * Find the first node in an array whose keys are front coded that is
+     * not less than a key.  The restart points, whose keys are whole, are
+     * binary searched first, so only the nodes from the restart point
+     * before the node are decoded.
+     * @tparam Less a function that tells whether a node is less than the
+     * key
+     * @param array
+     * @param count the number of nodes in the array, which MUST be positive
+     * @param less
+     * @param node the place to put the node found
+     * @return the index of the node found, or count if all the nodes are
+     * less than the key
+     */
+    template <class Less>
+    SizeT PartitionFrontCoded_(FrontCodedArray_ array, SizeT count, Less&& less, Node_& node) const {
+        char key[kKeyBytes_];
+        SizeT left = 0, right = Restarts_(count);
+        while (left < right) {
+            SizeT middle = (left + right) / 2;
+            LoadRecord_(array.records + LoadLength_(array.restarts + middle * sizeof(Length_)), key, node);
+            if (less(node)) left = middle + 1;
+            else right = middle;
+        }
+        if (left == 0) { // not less than the first node
+            LoadRecord_(array.records, key, node);
+            return 0;
+        }
+
+        const char* record = array.records + LoadLength_(array.restarts + (left - 1) * sizeof(Length_));
+        SizeT end = std::min(count, left * format_.restartInterval);
+        for (SizeT i = (left - 1) * format_.restartInterval; i < end; ++i) {
+            record = LoadRecord_(record, key, node);
+            if (!less(node)) return i;
+        }
+        if (end < count) LoadRecord_(record, key, node); // the next restart point
+        return end;
+    }
+
+    /**
+     * Decode a record of an array whose keys are front coded.
+     * @param record
+     * @param key the bytes of the key before it, which are replaced by the
+     * bytes of its key
+     * @param node the place to put the node
+     * @return the record after it
+     */
+    static const char* LoadRecord_(const char* record, char* key, Node_& node) {
+        SizeT shared;
+        record = LoadVarint_(record, shared);
+        std::memcpy(key + shared, record, kKeyBytes_ - shared);
+        record += kKeyBytes_ - shared;
+        std::memcpy(reinterpret_cast<char*>(&node.key1), key, sizeof(KeyType1));
+        std::memcpy(reinterpret_cast<char*>(&node.key2), key + sizeof(KeyType1), sizeof(KeyType2));
+        std::memcpy(reinterpret_cast<char*>(&node.value), record, sizeof(ValueType));
+        return record + sizeof(ValueType);
+    }
+
+    static void StoreKey_(char* target, const Node_& node) {
+        std::memcpy(target, reinterpret_cast<const char*>(&node.key1), sizeof(KeyType1));
+        std::memcpy(target + sizeof(KeyType1), reinterpret_cast<const char*>(&node.key2), sizeof(KeyType2));
+    }
+
+    static SizeT SharedPrefix_(const char* lhs, const char* rhs) {
+        return std::mismatch(lhs, lhs + kKeyBytes_, rhs).first - lhs;
+    }
+
+    /**
+     * Get the number of restart points of an array whose keys are front
+     * coded.
+     * @param count the number of nodes in the array
+     * @return the number of restart points
+     */
+    [[nodiscard]] SizeT Restarts_(SizeT count) const {
+        return (count + format_.restartInterval - 1) / format_.restartInterval;
+    }
+
+    static SizeT VarintBytes_(SizeT value) {
+        SizeT bytes = 1;
+        for (; value >= 128; value >>= 7) ++bytes;
+        return bytes;
+    }
+
+    /**
+     * Store a non-negative integer in 7-bit groups, where the highest bit
+     * of a byte tells whether there are more bytes.
+     * @param target
+     * @param value
+     * @return the end of the stored bytes
+     */
+    static char* StoreVarint_(char* target, SizeT value) {
+        for (; value >= 128; value >>= 7) *target++ = static_cast<char>(value | 128);
+        *target++ = static_cast<char>(value);
+        return target;
+    }
+
+    static const char* LoadVarint_(const char* source, SizeT& value) {
+        value = 0;
+        for (int shift = 0;; shift += 7) {
+            auto byte = static_cast<unsigned char>(*source++);
+            value |= static_cast<SizeT>(byte & 127) << shift;
+            if (byte < 128) return source;
+        }
+    }
+
+    static Length_ LoadLength_(const char* source) {
+        Length_ length;
+        std::memcpy(&length, source, sizeof(Length_));
+        return length;
+    }
+
+    static void StoreLength_(char* target, SizeT length) {
+        auto value = static_cast<Length_>(length);
+        std::memcpy(target, &value, sizeof(Length_));
+    }
+
+    /**
+     * @struct Latches_{list, cache}
+     *
+     * The latches to read the list in several threads.  The cache latch
+     * is shared by the readers getting from the cache, and exclusive to
+     * the readers putting a pair into it.  They are kept in the heap so
+     * that the list can be moved.
+     */
+    struct Latches_ {
+        ReaderWriterLatch list;
+        std::shared_mutex cache;
+    };
+
+    /**
+     * Lock the list for a function that only reads the list.
+     * @return the shared lock of the list
+     */
+    std::shared_lock<std::shared_mutex> ReadLock_() const {
+        return latches_->list.ReadLock();
+    }
+
+    /**
+     * Lock the list for a function that modifies the list.
+     * @return the exclusive lock of the list
+     */
+    std::unique_lock<std::shared_mutex> WriteLock_() const {
+        return latches_->list.WriteLock();
+    }
+
+    /**
+     * @struct Preimage_{version, data}
+     *
+     * The copy of a page of the file before it is modified, which is read
+     * by the snapshots not newer than the version and newer than the
+     * version of the copy before it.
+     */
+    struct Preimage_ {
+        SizeT                   version;
+        std::unique_ptr<char[]> data;
+    };
+
+    /**
+     * @struct Versions_{last, pinned, preimages}
+     *
+     * The versions of the snapshots and the copies of the pages modified
+     * after them.  The copies of a page are sorted by their versions.  It
+     * is kept in the heap so that the list can be moved.
+     */
+    struct Versions_ {
+        SizeT                                           last = 0; // the version of the last snapshot
+        std::set<SizeT>                                 pinned;   // the versions of the snapshots that exist
+        std::unordered_map<Ptr, std::vector<Preimage_>> preimages; // the copies of each page
+    };
+
+    /**
+     * Copy the pages in the range before they are modified if a snapshot
+     * needs them, which is the case if the pages have not been copied
+     * since the newest snapshot was taken.
+     * @param position the start of the range
+     * @param length the length of the range
+     */
+    void Preserve_(Ptr position, SizeT length) {
+        if (versions_->pinned.empty()) return;
+        SizeT newest = *(versions_->pinned.rbegin());
+        Ptr end = storage_.Allocate(0); // the end of the file
+        for (Ptr page = position - position % kPageSize_; page < position + length; page += kPageSize_) {
+            auto& copies = versions_->preimages[page];
+            if (!copies.empty() && copies.back().version >= newest) continue; // copied for the newest snapshot
+            Preimage_ copy{newest, std::make_unique<char[]>(kPageSize_)};
+            storage_.Read(copy.data.get(), page, std::min(kPageSize_, end - page));
+            copies.push_back(std::move(copy));
+        }
+    }
+
+    /**
+     * Move the data in the file, copying the pages of the target first if
+     * a snapshot needs them.
+     * @param source
+     * @param target
      * @param length
      */
-    void Write_(char* source, Ptr target, SizeT length) {
-        list_.seekp(target);
-        list_.write(source, length);
+    void Move_(Ptr source, Ptr target, SizeT length) {
+        Preserve_(target, length);
+        storage_.Move(source, target, length);
+    }
+
+    /**
+     * Read the data in the file as it was when a snapshot was taken.  The
+     * list is locked only in this function.
+     * @param buffer the place to put the data
+     * @param position the position of the data
+     * @param length the length of the data
+     * @param version the version of the snapshot
+     */
+    void ReadView_(char* buffer, Ptr position, SizeT length, SizeT version) const {
+        if (length <= 0) return; // the buffer may be nullptr (e.g. an empty array)
+        auto lock = ReadLock_();
+        const auto& preimages = versions_->preimages;
+        Ptr end = position + length;
+        Ptr current = position; // the start of the data not read yet
+        if (!preimages.empty()) {
+            for (Ptr page = position - position % kPageSize_; page < end; page += kPageSize_) {
+                auto copies = preimages.find(page);
+                if (copies == preimages.end()) continue;
+                auto copy = std::lower_bound(copies->second.begin(), copies->second.end(), version,
+                                             [](const Preimage_& lhs, SizeT rhs) { return lhs.version < rhs; });
+                if (copy == copies->second.end()) continue; // not modified since the snapshot was taken
+
+                Ptr from = std::max(page, position);
+                Ptr to = std::min(page + kPageSize_, end);
+                if (current < from) storage_.Read(buffer + (current - position), current, from - current);
+                std::memcpy(buffer + (from - position), copy->data.get() + (from - page), to - from);
+                current = to;
+            }
+        }
+        if (current < end) storage_.Read(buffer + (current - position), current, end - current);
+    }
+
+    /**
+     * Visit the nodes of a snapshot in order from the first node that is
+     * not less than the start of the range.  The main nodes whose arrays
+     * are all less than the start are skipped without reading the arrays.
+     * @tparam Less a function that tells whether a node is less than the
+     * start of the range
+     * @tparam Visit a function that is called with each node and returns
+     * whether to visit the next node
+     * @param version the version of the snapshot
+     * @param first the first main node of the snapshot
+     * @param less
+     * @param visit
+     */
+    template <class Less, class Visit>
+    void ReadSnapshot_(SizeT version, Ptr first, Less&& less, Visit&& visit) const {
+        if (first == 0) return;
+        MainNode_ mainNode, next;
+        ReadView_(reinterpret_cast<char*>(&mainNode), first, sizeof(MainNode_), version);
+
+        // Skip the main nodes before the one that the range starts in
+        while (mainNode.next != 0) {
+            ReadView_(reinterpret_cast<char*>(&next), mainNode.next, sizeof(MainNode_), version);
+            if (!less(Node_{next.key1, next.key2, next.value})) break;
+            mainNode = next;
+        }
+
+        std::vector<Node_> array;
+        std::vector<char> buffer; // the array whose keys are front coded
+        while (true) {
+            ReadViewArray_(mainNode, version, array, buffer);
+            auto node = array.begin();
+            if (less(Node_{mainNode.key1, mainNode.key2, mainNode.value})) {
+                node = std::partition_point(array.begin(), array.end(), less);
+            } else if (!visit(Node_{mainNode.key1, mainNode.key2, mainNode.value})) {
+                return;
+            }
+            for (; node != array.end(); ++node) {
+                if (!visit(*node)) return;
+            }
+
+            if (mainNode.next == 0) return;
+            ReadView_(reinterpret_cast<char*>(&mainNode), mainNode.next, sizeof(MainNode_), version);
+        }
+    }
+
+    /**
+     * Read the array of a main node as it was when a snapshot was taken.
+     * @param mainNode the main node in the snapshot
+     * @param version the version of the snapshot
+     * @param array the place to put the nodes
+     * @param buffer the place to put the array if the keys are front coded
+     */
+    void ReadViewArray_(const MainNode_& mainNode, SizeT version, std::vector<Node_>& array,
+                        std::vector<char>& buffer) const {
+        array.resize(mainNode.count);
+        if (format_.restartInterval == 0) {
+            ReadView_(reinterpret_cast<char*>(array.data()), mainNode.target, mainNode.count * sizeof(Node_), version);
+            return;
+        }
+        if (mainNode.count == 0) return;
+        SizeT bytes;
+        ReadView_(reinterpret_cast<char*>(&bytes), mainNode.target, sizeof(SizeT), version);
+        SizeT restartBytes = Restarts_(mainNode.count) * static_cast<SizeT>(sizeof(Length_));
+        buffer.resize(restartBytes + bytes);
+        ReadView_(buffer.data(), mainNode.target + sizeof(SizeT), restartBytes + bytes, version);
+        DecodeFrontCoded_(FrontCodedArray_{buffer.data(), buffer.data() + restartBytes}, mainNode.count, array.data());
+    }
+
+    /**
+     * Release a snapshot, freeing the copies of the pages that no other
+     * snapshot needs.
+     * @param version the version of the snapshot
+     */
+    void Release_(SizeT version) const {
+        auto lock = WriteLock_();
+        auto& pinned = versions_->pinned;
+        auto& preimages = versions_->preimages;
+        pinned.erase(version);
+        if (pinned.empty()) {
+            preimages.clear();
+            return;
+        }
+        for (auto page = preimages.begin(); page != preimages.end();) {
+            std::vector<Preimage_> needed;
+            SizeT lower = 0; // the version of the copy before
+            for (auto& copy : page->second) {
+                auto snapshot = pinned.upper_bound(lower);
+                lower = copy.version;
+                if (snapshot != pinned.end() && *snapshot <= copy.version) needed.push_back(std::move(copy));
+            }
+            if (needed.empty()) {
+                page = preimages.erase(page);
+            } else {
+                page->second = std::move(needed);
+                ++page;
+            }
+        }
+    }
+
+    /**
+     * Write the first node (the head of the list).
+     */
+    void WriteHead_() {
+        Preserve_(HeadPtr_(), sizeof(FirstNode_));
+        storage_.Write(reinterpret_cast<const char*>(&head_), HeadPtr_(), sizeof(FirstNode_));
+    }
+
+    /**
+     * Get the place of the first node, which is after the format node if
+     * the keys are front coded.
+     * @return the place of the first node
+     */
+    [[nodiscard]] Ptr HeadPtr_() const {
+        return format_.restartInterval == 0 ? 0 : static_cast<Ptr>(sizeof(FormatNode_));
+    }
+
+    /**
+     * Get the size of a main node with its array.
+     * @return the size of a main node with its array
+     */
+    [[nodiscard]] SizeT BlockSize_() const {
+        return sizeof(MainNode_) + ArraySize_();
+    }
+
+    /**
+     * Get the size of an array.  If the keys are front coded, the array is
+     * as large as the other arrays, but large enough for two nodes whose
+     * keys share no bytes.
+     * @return the size of an array
+     */
+    [[nodiscard]] SizeT ArraySize_() const {
+        auto size = static_cast<SizeT>((head_.maxNodeSize + 1) * sizeof(Node_));
+        if (format_.restartInterval == 0) return size;
+        auto recordBytes = static_cast<SizeT>(VarintBytes_(0) + kKeyBytes_ + sizeof(ValueType) + sizeof(Length_));
+        return std::max(size, static_cast<SizeT>(sizeof(SizeT)) + 2 * recordBytes);
     }
 
-    mutable std::fstream list_;
+    mutable Storage storage_;
+    FormatNode_ format_;
     FirstNode_ head_;
-    Node_ emptyNode_;
-    mutable Node_ cachedNode_;
-    mutable bool cached = false;
+    mutable ClockCache<std::pair<KeyType1, KeyType2>, ValueType> cache_;
+    std::unique_ptr<Latches_> latches_ = std::make_unique<Latches_>();
+    std::unique_ptr<Versions_> versions_ = std::make_unique<Versions_>();
+    std::vector<char> codeBuffer_; // the buffer to encode an array whose keys are front coded
 };
 
 }
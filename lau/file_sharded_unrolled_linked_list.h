@@ -0,0 +1,554 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/file_sharded_unrolled_linked_list.h
+ *
+ * This is a external header file, including a
+ * <code>lau::FileShardedUnrolledLinkedList</code> class.
+ */
+
+#ifndef LAU_CPP_LIB_LAU_FILE_SHARDED_UNROLLED_LINKED_LIST_H
+#define LAU_CPP_LIB_LAU_FILE_SHARDED_UNROLLED_LINKED_LIST_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "exception.h"
+#include "file_storage.h"
+#include "file_unrolled_linked_list.h"
+#include "type_traits.h"
+
+namespace lau {
+
+/**
+ * @class FileShardedUnrolledLinkedList
+ *
+ * This is a template class of a map on disk storage whose keys are
+ * partitioned by their hash values into several
+ * <code>lau::FileUnrolledLinkedList</code>s (the shards), each kept in
+ * its own file.  Each shard has its own writer thread with a queue of
+ * modifications, so the shards are modified in parallel.
+ *
+ * @tparam KeyType Type of Key
+ * @tparam ValueType Type of Value
+ * @tparam Storage Type of the storage of each shard,
+ * <code>lau::FileStorage</code> by default
+ * @tparam Hash Type of the hash function of the keys,
+ * <code>std::hash<KeyType></code> by default
+ *
+ * WARNING:
+ * <br>
+ * 1. The requirements of <code>lau::FileUnrolledLinkedList</code> on the
+ * key and value types apply.
+ * <br>
+ * 2. A key is always put in the same shard, so the number of shards and
+ * the hash function MUST NOT be changed once the list is created.
+ * <br>
+ * 3. The modifications of a shard are applied in the order they are
+ * added, but the shards are modified independently, so a function that
+ * reads several shards (e.g. <code>Traverse</code>) may see some of the
+ * modifications that are not finished yet.
+ */
+template<class KeyType, class ValueType, class Storage = FileStorage, class Hash = std::hash<KeyType>>
+class FileShardedUnrolledLinkedList {
+public:
+    using List = FileUnrolledLinkedList<KeyType, ValueType, Storage>;
+    using Node = typename List::Node;
+
+    /**
+     * Construct the list with a file keeping the number of shards.  The
+     * shards are kept in the files named <code>fileName</code> followed
+     * by a dot and the index of the shard (e.g. <code>data.0</code>),
+     * which are created if they do not exist.
+     * @param fileName the file keeping the number of shards, which MUST
+     * exist
+     * @param shardCount the number of shards
+     * @param nodeSize the node size of each shard
+     * @param cacheSize the number of key-value pairs cached in memory for
+     * each shard
+     * @param filterBits the number of bits per key of the Bloom filters of
+     * each shard
+     * @throw lau::InvalidArgument if <code>shardCount</code> is not
+     * positive or is not the number of shards in the file
+     * @throw lau::RuntimeError if the file is not a sharded list
+     */
+    explicit FileShardedUnrolledLinkedList(const std::string& fileName, SizeT shardCount, SizeT nodeSize = 316,
+                                           SizeT cacheSize = 64, SizeT filterBits = 0) {
+        if (shardCount <= 0) throw lau::InvalidArgument("Invalid Argument: the number of shards must be positive");
+        ReadManifest_(fileName, shardCount);
+        shards_.reserve(shardCount);
+        for (SizeT i = 0; i < shardCount; ++i) {
+            std::string shardName = fileName + "." + std::to_string(i);
+            std::ofstream(shardName, std::ios::out | std::ios::binary | std::ios::app).close(); // create the file
+            shards_.push_back(std::make_unique<Shard_>(shardName, nodeSize, cacheSize, filterBits));
+        }
+    }
+
+    explicit FileShardedUnrolledLinkedList(const char* fileName, SizeT shardCount, SizeT nodeSize = 316,
+                                           SizeT cacheSize = 64, SizeT filterBits = 0)
+        : FileShardedUnrolledLinkedList(std::string(fileName), shardCount, nodeSize, cacheSize, filterBits) {}
+
+    FileShardedUnrolledLinkedList(FileShardedUnrolledLinkedList&&) noexcept = default;
+
+    FileShardedUnrolledLinkedList(const FileShardedUnrolledLinkedList&) = delete;
+
+    FileShardedUnrolledLinkedList& operator=(FileShardedUnrolledLinkedList&&) noexcept = default;
+
+    FileShardedUnrolledLinkedList& operator=(const FileShardedUnrolledLinkedList&) = delete;
+
+    /**
+     * Wait for the modifications in the queues and stop the writer
+     * threads.
+     */
+    ~FileShardedUnrolledLinkedList() = default;
+
+    /**
+     * Insert a new key-value pair, waiting until it is inserted.
+     * @param key the new key
+     * @param value the value of the new key
+     * @return whether the operation is successful or not
+     */
+    bool Insert(const KeyType& key, const ValueType& value) {
+        return AsyncInsert(key, value).get();
+    }
+
+    /**
+     * Erase the corresponding key-value pair of the input key, waiting
+     * until it is erased.
+     * @param key
+     * @return whether the operation is successful or not
+     */
+    bool Erase(const KeyType& key) {
+        return AsyncErase(key).get();
+    }
+
+    /**
+     * Modify the value of an existing key-value pair, waiting until it is
+     * modified.
+     * @param key
+     * @param value
+     * @return whether the operation is successful or not
+     */
+    bool Modify(const KeyType& key, const ValueType& value) {
+        return AsyncModify(key, value).get();
+    }
+
+    /**
+     * Add an insertion of a new key-value pair to the queue of its shard
+     * without waiting for it.
+     * @param key the new key
+     * @param value the value of the new key
+     * @return the future of whether the operation is successful or not
+     */
+    std::future<bool> AsyncInsert(const KeyType& key, const ValueType& value) {
+        return ShardOf_(key).Submit([key, value](List& list) { return list.Insert(key, value); });
+    }
+
+    /**
+     * Add an erasure of the key-value pair of a key to the queue of its
+     * shard without waiting for it.
+     * @param key
+     * @return the future of whether the operation is successful or not
+     */
+    std::future<bool> AsyncErase(const KeyType& key) {
+        return ShardOf_(key).Submit([key](List& list) { return list.Erase(key); });
+    }
+
+    /**
+     * Add a modification of the value of an existing key-value pair to the
+     * queue of its shard without waiting for it.
+     * @param key
+     * @param value
+     * @return the future of whether the operation is successful or not
+     */
+    std::future<bool> AsyncModify(const KeyType& key, const ValueType& value) {
+        return ShardOf_(key).Submit([key, value](List& list) { return list.Modify(key, value); });
+    }
+
+    /**
+     * Insert the key-value pairs in a range.  The pairs are grouped by
+     * their shards, and each group is applied to its shard as one
+     * <code>WriteBatch</code> by the writer thread of the shard, so the
+     * shards are modified in parallel.
+     * @tparam InputIterator an iterator of the pairs, whose
+     * <code>first</code> is the key and <code>second</code> is the value
+     * (e.g. <code>std::pair<KeyType, ValueType></code>)
+     * @param first
+     * @param last
+     * @return the number of pairs inserted
+     */
+    template<class InputIterator>
+    SizeT InsertRange(InputIterator first, InputIterator last) {
+        std::vector<typename List::WriteBatch> batches(shards_.size());
+        for (; first != last; ++first) batches[ShardIndex_(first->first)].Insert(first->first, first->second);
+
+        std::vector<std::future<SizeT>> results;
+        for (SizeT i = 0; i < static_cast<SizeT>(shards_.size()); ++i) {
+            if (batches[i].Empty()) continue;
+            results.push_back(shards_[i]->Submit(
+                [batch = std::move(batches[i])](List& list) { return list.Apply(batch); }));
+        }
+        SizeT inserted = 0;
+        for (auto& result : results) inserted += result.get();
+        return inserted;
+    }
+
+    /**
+     * Clear all the data in the shards.
+     * @return reference of the current class
+     */
+    FileShardedUnrolledLinkedList& Clear() {
+        ForEachShard_([](List& list) { list.Clear(); });
+        return *this;
+    }
+
+    /**
+     * Compact the shards in parallel (see <code>Compact</code> of
+     * <code>lau::FileUnrolledLinkedList</code>).
+     * @return reference of the current class
+     */
+    FileShardedUnrolledLinkedList& Compact() {
+        ForEachShard_([](List& list) { list.Compact(); });
+        return *this;
+    }
+
+    /**
+     * Wait for the modifications in the queues and flush the shards.
+     * @return reference of the current class
+     */
+    FileShardedUnrolledLinkedList& Flush() {
+        ForEachShard_([](List& list) { list.Flush(); });
+        return *this;
+    }
+
+    /**
+     * Check the structure and the checksums of all the shards.
+     * @return whether all the shards are intact
+     */
+    [[nodiscard]] bool Verify() const {
+        for (const auto& shard : shards_) {
+            if (!shard->list.Verify()) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Tell whether all the shards are empty.
+     * @return the boolean of whether the list is empty
+     */
+    [[nodiscard]] bool Empty() const {
+        for (const auto& shard : shards_) {
+            if (!shard->list.Empty()) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Get the number of shards.
+     * @return the number of shards
+     */
+    [[nodiscard]] SizeT ShardCount() const noexcept {
+        return static_cast<SizeT>(shards_.size());
+    }
+
+    /**
+     * Get the shard that a key belongs to, which can be read directly.
+     * Modifying it while the writer thread of the shard is running is
+     * undefined behaviour.
+     * @param key
+     * @return the shard of the key
+     */
+    [[nodiscard]] const List& Shard(const KeyType& key) const {
+        return shards_[ShardIndex_(key)]->list;
+    }
+
+    /**
+     * Check whether there exists a node with a certain key or not.  The
+     * modifications in the queue of the shard may not be seen.
+     * @param key
+     * @return The boolean of whether there exists a node with a certain key
+     * or not
+     */
+    [[nodiscard]] bool Exist(const KeyType& key) const {
+        return Shard(key).Exist(key);
+    }
+
+    /**
+     * Get the corresponding value of the key.  If there is no such node,
+     * it will return the default value (using the default constructor).
+     * The modifications in the queue of the shard may not be seen.
+     * @param key
+     * @return the corresponding value of the key.
+     */
+    [[nodiscard]] ValueType Get(const KeyType& key) const {
+        return Shard(key).Get(key);
+    }
+
+    /**
+     * Get the corresponding values of a batch of keys.  The keys are
+     * grouped by their shards, and each group is looked up with
+     * <code>MultiGet</code> of its shard.
+     * @param keys the keys to search (not necessarily sorted or distinct)
+     * @return the values in the order of the keys.
+     * <br>
+     * If there is no such node, the value will be the default value
+     * (calling the default constructor).
+     */
+    [[nodiscard]] std::vector<ValueType> MultiGet(const std::vector<KeyType>& keys) const {
+        std::vector<std::vector<KeyType>> groups(shards_.size());
+        std::vector<std::vector<SizeT>> positions(shards_.size());
+        for (SizeT i = 0; i < static_cast<SizeT>(keys.size()); ++i) {
+            SizeT shard = ShardIndex_(keys[i]);
+            groups[shard].push_back(keys[i]);
+            positions[shard].push_back(i);
+        }
+
+        std::vector<ValueType> values(keys.size());
+        for (SizeT shard = 0; shard < static_cast<SizeT>(shards_.size()); ++shard) {
+            if (groups[shard].empty()) continue;
+            std::vector<ValueType> found = shards_[shard]->list.MultiGet(groups[shard]);
+            for (SizeT i = 0; i < static_cast<SizeT>(found.size()); ++i) values[positions[shard][i]] = found[i];
+        }
+        return values;
+    }
+
+    /**
+     * Get all the key-value pair in the list in the order of the keys.
+     * Each shard is traversed by its writer thread after the modifications
+     * before in its queue, and the shards are merged.
+     * @return the <code>std::vector</code> class containing all the
+     * <code>Node</code>s in the list
+     */
+    std::vector<Node> Traverse() const {
+        return Merge_([](List& list) { return list.Traverse(); });
+    }
+
+    /**
+     * Get the key-value pairs whose keys are in the range
+     * [<code>lowKey</code>, <code>highKey</code>] in the order of the
+     * keys.  Each shard is scanned by its writer thread after the
+     * modifications before in its queue, and the shards are merged.
+     * @param lowKey
+     * @param highKey
+     * @return the <code>std::vector</code> class containing the
+     * <code>Node</code>s in the range
+     */
+    std::vector<Node> Traverse(const KeyType& lowKey, const KeyType& highKey) const {
+        return Merge_([lowKey, highKey](List& list) {
+            std::vector<Node> nodes;
+            for (const Node& node : list.Scan(lowKey, highKey)) nodes.push_back(node);
+            return nodes;
+        });
+    }
+
+private:
+    constexpr static std::uint64_t kMagic_ = 0x4c41555348415244ULL; // "LAUSHARD"
+
+    /**
+     * @struct Manifest_{magic, shardCount}
+     *
+     * The content of the file keeping the number of shards.
+     */
+    struct Manifest_ {
+        std::uint64_t magic;
+        SizeT         shardCount;
+    };
+
+    /**
+     * @struct Shard_{list, latch, ready, tasks, stop, writer}
+     *
+     * A shard with its writer thread, which runs the tasks in the queue in
+     * order.  The queue is emptied before the thread stops.
+     */
+    struct Shard_ {
+        Shard_(const std::string& fileName, SizeT nodeSize, SizeT cacheSize, SizeT filterBits)
+            : list(fileName, nodeSize, cacheSize, filterBits), writer([this]() { Run(); }) {}
+
+        Shard_(const Shard_&) = delete;
+
+        Shard_& operator=(const Shard_&) = delete;
+
+        ~Shard_() {
+            {
+                std::lock_guard<std::mutex> lock(latch);
+                stop = true;
+            }
+            ready.notify_one();
+            writer.join();
+        }
+
+        /**
+         * Add a task to the queue.
+         * @tparam Function a function that can be called with
+         * <code>List&</code>
+         * @param function
+         * @return the future of the result of the function
+         */
+        template<class Function>
+        std::future<std::invoke_result_t<Function&, List&>> Submit(Function&& function) {
+            using Result = std::invoke_result_t<Function&, List&>;
+            auto task = std::make_shared<std::packaged_task<Result()>>(
+                [this, function = std::forward<Function>(function)]() mutable { return function(list); });
+            std::future<Result> result = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(latch);
+                tasks.emplace_back([task]() { (*task)(); });
+            }
+            ready.notify_one();
+            return result;
+        }
+
+        /**
+         * Run the tasks in the queue until the shard is stopped.
+         */
+        void Run() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(latch);
+                    ready.wait(lock, [this]() { return stop || !tasks.empty(); });
+                    if (tasks.empty()) return; // stopped
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        List                              list;
+        std::mutex                        latch;
+        std::condition_variable           ready;
+        std::deque<std::function<void()>> tasks;
+        bool                              stop = false;
+        std::thread                       writer; // started last, after the other members
+    };
+
+    /**
+     * Check the file keeping the number of shards, writing it if it is
+     * empty.
+     * @param fileName
+     * @param shardCount
+     */
+    static void ReadManifest_(const std::string& fileName, SizeT shardCount) {
+        FileStorage file(fileName);
+        Manifest_ manifest{kMagic_, shardCount};
+        if (file.Empty()) {
+            file.Write(reinterpret_cast<const char*>(&manifest), 0, sizeof(Manifest_));
+            file.Flush();
+            return;
+        }
+        if (file.Allocate(0) < static_cast<SizeT>(sizeof(Manifest_))) {
+            throw lau::RuntimeError("Runtime Error: the file is not a sharded list");
+        }
+        file.Read(reinterpret_cast<char*>(&manifest), 0, sizeof(Manifest_));
+        if (manifest.magic != kMagic_) throw lau::RuntimeError("Runtime Error: the file is not a sharded list");
+        if (manifest.shardCount != shardCount) {
+            throw lau::InvalidArgument("Invalid Argument: the number of shards is not the one in the file");
+        }
+    }
+
+    /**
+     * Get the index of the shard of a key.
+     * @param key
+     * @return the index of the shard
+     */
+    [[nodiscard]] SizeT ShardIndex_(const KeyType& key) const {
+        return static_cast<SizeT>(hash_(key) % static_cast<std::size_t>(shards_.size()));
+    }
+
+    /**
+     * Get the shard of a key.
+     * @param key
+     * @return the shard
+     */
+    Shard_& ShardOf_(const KeyType& key) const {
+        return *shards_[ShardIndex_(key)];
+    }
+
+    /**
+     * Run a function on all the shards by their writer threads in parallel
+     * and wait for them.
+     * @tparam Function a function that can be called with
+     * <code>List&</code>
+     * @param function
+     */
+    template<class Function>
+    void ForEachShard_(Function function) const {
+        std::vector<std::future<void>> results;
+        for (const auto& shard : shards_) results.push_back(shard->Submit(function));
+        for (auto& result : results) result.get();
+    }
+
+    /**
+     * Get the nodes of all the shards by their writer threads in parallel
+     * and merge them in the order of the keys.
+     * @tparam Function a function that can be called with
+     * <code>List&</code>, returning the sorted nodes of the shard
+     * @param function
+     * @return the merged nodes
+     */
+    template<class Function>
+    std::vector<Node> Merge_(Function function) const {
+        std::vector<std::future<std::vector<Node>>> results;
+        for (const auto& shard : shards_) results.push_back(shard->Submit(function));
+        std::vector<std::vector<Node>> runs;
+        SizeT total = 0;
+        for (auto& result : results) {
+            runs.push_back(result.get());
+            total += static_cast<SizeT>(runs.back().size());
+        }
+
+        // The cursor {run, position} with the least key is at the top of the heap
+        using Cursor = std::pair<SizeT, SizeT>;
+        auto greater = [&runs](const Cursor& lhs, const Cursor& rhs) {
+            return runs[rhs.first][rhs.second].key < runs[lhs.first][lhs.second].key;
+        };
+        std::priority_queue<Cursor, std::vector<Cursor>, decltype(greater)> heap(greater);
+        for (SizeT i = 0; i < static_cast<SizeT>(runs.size()); ++i) {
+            if (!runs[i].empty()) heap.emplace(i, 0);
+        }
+
+        std::vector<Node> nodes;
+        nodes.reserve(total);
+        while (!heap.empty()) {
+            auto [run, position] = heap.top();
+            heap.pop();
+            nodes.push_back(runs[run][position]);
+            if (position + 1 < static_cast<SizeT>(runs[run].size())) heap.emplace(run, position + 1);
+        }
+        return nodes;
+    }
+
+    std::vector<std::unique_ptr<Shard_>> shards_;
+    Hash hash_;
+};
+
+}
+
+#endif // LAU_CPP_LIB_LAU_FILE_SHARDED_UNROLLED_LINKED_LIST_H
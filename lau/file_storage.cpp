@@ -0,0 +1,108 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/file_storage.cpp
+ *
+ * This is a internal source file, including the implementation of the
+ * <code>lau::FileStorage</code> class.
+ */
+
+#include "file_storage.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "async_reader.h"
+#include "type_traits.h"
+
+lau::FileStorage::FileStorage(const std::string& fileName)
+    : fileName_(fileName), file_(fileName, std::ios::in | std::ios::out | std::ios::binary),
+      reader_(std::make_unique<AsyncReader>(fileName)) {
+    file_.seekg(0, std::ios::end);
+    end_ = file_.tellg();
+    if (end_ < 0) end_ = 0;
+}
+
+void lau::FileStorage::Read(char* buffer, Ptr position, SizeT length) {
+    // The stream is only dirty within an operation that writes, when no
+    // other thread is reading
+    if (dirty_) FlushStream_();
+    ReadRequest request{buffer, position, length};
+    reader_->Read(&request, 1);
+}
+
+void lau::FileStorage::ReadBatch(ReadRequest* requests, SizeT count) {
+    if (dirty_) FlushStream_();
+    reader_->Read(requests, count);
+}
+
+void lau::FileStorage::Write(const char* source, Ptr position, SizeT length) {
+    file_.seekp(position);
+    file_.write(source, length);
+    dirty_ = true;
+    if (position + length > end_) end_ = position + length;
+}
+
+void lau::FileStorage::Move(Ptr source, Ptr target, SizeT length) {
+    if (length <= 0) return;
+    if (static_cast<SizeT>(buffer_.size()) < length) buffer_.resize(length);
+    Read(buffer_.data(), source, length);
+    Write(buffer_.data(), target, length);
+}
+
+void lau::FileStorage::Prefetch(Ptr, SizeT) {}
+
+lau::FileStorage::Ptr lau::FileStorage::Allocate(SizeT length) {
+    Ptr position = end_;
+    if (length > 0) {
+        // Write the last byte so that the space really exists in the file
+        char zero = 0;
+        file_.seekp(position + length - 1);
+        file_.write(&zero, 1);
+        dirty_ = true;
+        end_ = position + length;
+    }
+    return position;
+}
+
+void lau::FileStorage::EndOperation() {
+    if (dirty_) FlushStream_();
+}
+
+void lau::FileStorage::Flush() {
+    file_.flush();
+    dirty_ = false;
+}
+
+bool lau::FileStorage::Empty() const noexcept {
+    return end_ == 0;
+}
+
+SizeT lau::FileStorage::Alignment() const noexcept {
+    return 1;
+}
+
+const std::string& lau::FileStorage::FileName() const noexcept {
+    return fileName_;
+}
+
+void lau::FileStorage::FlushStream_() {
+    file_.flush();
+    dirty_ = false;
+}
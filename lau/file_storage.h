@@ -0,0 +1,172 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/file_storage.h
+ *
+ * This is a external header file, including a
+ * <code>lau::FileStorage</code> class.
+ */
+
+#ifndef LAU_CPP_LIB_LAU_FILE_STORAGE_H
+#define LAU_CPP_LIB_LAU_FILE_STORAGE_H
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "async_reader.h"
+#include "type_traits.h"
+
+namespace lau {
+
+/**
+ * @class FileStorage
+ *
+ * The default storage of the data structures based on files.  Every write
+ * is sent to <code>std::fstream</code> directly, and every read is sent to
+ * the file with <code>pread</code>, so the reads need no latch.
+ * <br><br>
+ * A storage class MUST have the same public member functions as this
+ * class, so that it can be used by the data structures based on files.
+ * <code>Read</code>, <code>ReadBatch</code> and <code>Prefetch</code> MAY be
+ * called by several threads at the same time, while the other functions are
+ * never called together with any other function.
+ */
+class FileStorage {
+public:
+    using Ptr = long;
+
+    /**
+     * Open the file.  Please make sure that the file does exist.
+     * @param fileName
+     * @throw lau::RuntimeError if the file cannot be opened
+     */
+    explicit FileStorage(const std::string& fileName);
+
+    FileStorage(FileStorage&&) noexcept = default;
+
+    FileStorage(const FileStorage&) = delete;
+
+    FileStorage& operator=(FileStorage&&) noexcept = default;
+
+    FileStorage& operator=(const FileStorage&) = delete;
+
+    ~FileStorage() = default;
+
+    /**
+     * Read a string of stuff from the file with <code>pread</code>.  It is
+     * safe to read in several threads at the same time.  The part beyond the
+     * end of the file is filled with 0.
+     * @param buffer the place to put the data
+     * @param position the place to get the data
+     * @param length
+     */
+    void Read(char* buffer, Ptr position, SizeT length);
+
+    /**
+     * Read a batch of strings of stuff from the file, keeping the reads in
+     * flight at the same time (see <code>lau::AsyncReader</code>).  It is
+     * safe to read in several threads at the same time.
+     * @param requests
+     * @param count the number of requests
+     */
+    void ReadBatch(ReadRequest* requests, SizeT count);
+
+    /**
+     * Write a string of stuff to the file.
+     * @param source the source pointer
+     * @param position the place to place the data
+     * @param length
+     */
+    void Write(const char* source, Ptr position, SizeT length);
+
+    /**
+     * Move a string of stuff to another place of the file.  The source
+     * and the target may overlap.
+     * @param source the place of the data
+     * @param target the new place of the data
+     * @param length
+     */
+    void Move(Ptr source, Ptr target, SizeT length);
+
+    /**
+     * Tell the storage that the data will be read soon.  Nothing needs
+     * to be done for this storage.
+     * @param position the place of the data
+     * @param length
+     */
+    void Prefetch(Ptr position, SizeT length);
+
+    /**
+     * Get a new space at the end of the file.
+     * @param length the length of the new space
+     * @return the place of the new space
+     */
+    Ptr Allocate(SizeT length);
+
+    /**
+     * Mark the end of an operation.  The data in the buffer of the stream
+     * is written to the file, so that the reads (which do not go through the
+     * stream) can see it.
+     */
+    void EndOperation();
+
+    /**
+     * Flush to make everything in the buffer stored in the file.
+     */
+    void Flush();
+
+    /**
+     * Tell whether the file is empty.
+     * @return the boolean of whether the file is empty
+     */
+    [[nodiscard]] bool Empty() const noexcept;
+
+    /**
+     * Get the size that the places and the lengths of the data are best
+     * aligned to, so that the data structures based on files can align
+     * their blocks to it.  There is no need to align for this storage.
+     * @return 1
+     */
+    [[nodiscard]] SizeT Alignment() const noexcept;
+
+    /**
+     * Get the name of the file, so that the data structures based on files
+     * can find the files they keep beside it.
+     * @return the name of the file
+     */
+    [[nodiscard]] const std::string& FileName() const noexcept;
+
+private:
+    /**
+     * Write the data in the buffer of the stream to the file if there is
+     * any.  This is only called when no other thread is reading.
+     */
+    void FlushStream_();
+
+    std::string fileName_;
+    std::fstream file_;
+    std::unique_ptr<AsyncReader> reader_; // reads the file with another descriptor
+    bool dirty_ = false; // whether the stream may hold data not in the file
+    Ptr end_ = 0; // the end of the file
+    std::vector<char> buffer_; // the buffer for moving data
+};
+
+} // namespace lau
+
+#endif // LAU_CPP_LIB_LAU_FILE_STORAGE_H
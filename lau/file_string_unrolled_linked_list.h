@@ -0,0 +1,961 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/file_string_unrolled_linked_list.h
+ *
+ * This is a external header file, including a
+ * <code>lau::FileStringUnrolledLinkedList</code> class.
+ */
+
+#ifndef LAU_CPP_LIB_LAU_FILE_STRING_UNROLLED_LINKED_LIST_H
+#define LAU_CPP_LIB_LAU_FILE_STRING_UNROLLED_LINKED_LIST_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "exception.h"
+#include "file_storage.h"
+#include "reader_writer_latch.h"
+#include "type_traits.h"
+
+namespace lau {
+
+/**
+ * @class FileStringUnrolledLinkedList
+ *
+ * This is a template class of unrolled linked list on disk storage whose
+ * keys and values are strings of any length.  Each block is a page of a
+ * fixed size in the slotted-page layout: the offsets of the records are
+ * at the front of the page in the order of the keys, and the records
+ * (the key and the value with their lengths) are at the back of the page,
+ * so the pages hold as many pairs as their bytes allow.  The first key of
+ * each page is kept in memory to find the page of a key without reading
+ * the file.
+ * <br>
+ * The keys can also be front coded if they share long prefixes: each key
+ * only keeps the part that differs from the key before it, except the
+ * keys at the restart points (one in every several records), which are
+ * kept whole for the binary search.  Two keys (e.g. an id and a time)
+ * can be put into one key: the id with a separator, and then the time in
+ * big-endian bytes, so that the keys compare as the pairs of keys do.
+ * @tparam Compare Type of the function object to compare two keys as
+ * <code>std::string_view</code>, <code>std::less<std::string_view></code>
+ * by default
+ * @tparam Storage Type of the storage, <code>lau::FileStorage</code> by default
+ *
+ * CAUTION:
+ * <br>
+ * 1. A key-value pair MUST fit in a page, or a lau::InvalidArgument will
+ * be thrown.
+ * <br>
+ * 2. The functions that only read the list (e.g. <code>Get</code>) can
+ * be called by several threads at the same time, and the functions that
+ * modify the list wait until no other function is running.
+ */
+template <class Compare = std::less<std::string_view>, class Storage = FileStorage>
+class FileStringUnrolledLinkedList {
+public:
+    using Ptr = long;
+
+    /**
+     * @struct Node{key, value}
+     *
+     * This is the Node to store data.
+     */
+    struct Node {
+        std::string key;
+        std::string value;
+    };
+
+    explicit FileStringUnrolledLinkedList(const std::string& fileName, SizeT pageSize = 4096,
+                                          SizeT restartInterval = 0)
+        : FileStringUnrolledLinkedList(Storage(fileName), pageSize, restartInterval) {}
+
+    explicit FileStringUnrolledLinkedList(const char* fileName, SizeT pageSize = 4096, SizeT restartInterval = 0)
+        : FileStringUnrolledLinkedList(Storage(fileName), pageSize, restartInterval) {}
+
+    /**
+     * Construct the list with a storage, which decides how the file is
+     * accessed (e.g. <code>lau::BufferPool</code> caches the file in
+     * memory).
+     * @param storage
+     * @param pageSize the size of a page in bytes, which is ignored if the
+     * file is not empty (the size in the file is used instead)
+     * @param restartInterval the number of records from one restart point
+     * to the next one if the keys are front coded, or 0 not to front code
+     * the keys, which is ignored if the file is not empty
+     * @param compare the function object to compare two keys
+     * @throw lau::InvalidArgument if the page is smaller than 64 bytes or
+     * the restart interval is negative
+     */
+    explicit FileStringUnrolledLinkedList(Storage&& storage, SizeT pageSize = 4096, SizeT restartInterval = 0,
+                                          const Compare& compare = Compare())
+        : storage_(std::move(storage)), head_{0, 0, pageSize, restartInterval}, compare_(compare) {
+        if (storage_.Empty()) {
+            if (head_.pageSize < 64) throw lau::InvalidArgument("Invalid Argument: the page is too small");
+            if (head_.restartInterval < 0) {
+                throw lau::InvalidArgument("Invalid Argument: the restart interval is negative");
+            }
+            WriteHead_();
+            storage_.EndOperation();
+        } else {
+            storage_.Read(reinterpret_cast<char*>(&head_), 0, sizeof(FirstNode_));
+            BuildIndex_();
+        }
+        pageBuffer_.resize(head_.pageSize);
+    }
+
+    FileStringUnrolledLinkedList(FileStringUnrolledLinkedList&&) noexcept = default;
+
+    FileStringUnrolledLinkedList(const FileStringUnrolledLinkedList&) = delete;
+
+    FileStringUnrolledLinkedList& operator=(FileStringUnrolledLinkedList&&) noexcept = default;
+
+    FileStringUnrolledLinkedList& operator=(const FileStringUnrolledLinkedList&) = delete;
+
+    ~FileStringUnrolledLinkedList() = default;
+
+    /**
+     * Insert a new key-value pair.  The page is split if the pair does not
+     * fit in it.
+     * @param key the new key
+     * @param value the value of the new key
+     * @return whether the operation is successful or not
+     * @throw lau::InvalidArgument if the pair cannot fit in a page
+     */
+    bool Insert(const std::string& key, const std::string& value) {
+        auto lock = WriteLock_();
+        CheckSize_(key, value);
+
+        // The case of no pages at all
+        if (index_.empty()) {
+            Ptr ptr = NewPage_();
+            Node node{key, value};
+            WritePage_(ptr, 0, &node, &node + 1);
+            head_.next = ptr;
+            WriteHead_();
+            index_.push_back(IndexEntry_{key, ptr});
+            storage_.EndOperation();
+            return true;
+        }
+
+        SizeT position = LocateIndex_(key);
+        Page_ page;
+        ReadPage_(index_[position].ptr, page);
+        auto iter = LowerBound_(page.nodes, key);
+        if (iter != page.nodes.end() && Equal_(iter->key, key)) return false;
+        page.nodes.insert(iter, Node{key, value});
+        PutPage_(position, page);
+        storage_.EndOperation();
+        return true;
+    }
+
+    /**
+     * Erase the corresponding key-value pair of the input key.  A page
+     * with few bytes in use is merged with its neighbour if they fit in
+     * one page.
+     * @param key
+     * @return whether the operation is successful or not
+     */
+    bool Erase(const std::string& key) {
+        auto lock = WriteLock_();
+        if (index_.empty()) return false;
+
+        SizeT position = LocateIndex_(key);
+        Page_ page;
+        ReadPage_(index_[position].ptr, page);
+        auto iter = LowerBound_(page.nodes, key);
+        if (iter == page.nodes.end() || !Equal_(iter->key, key)) return false;
+        page.nodes.erase(iter);
+
+        if (page.nodes.empty()) {
+            DeletePage_(position);
+        } else {
+            PutPage_(position, page);
+            if (PageBytes_(page.nodes.data(), page.nodes.data() + page.nodes.size()) < head_.pageSize / 4) {
+                Rebalance_(position, page);
+            }
+        }
+        storage_.EndOperation();
+        return true;
+    }
+
+    /**
+     * Modify the value of an existing key-value pair.  The page is split
+     * if the new value does not fit in it.
+     * @param key
+     * @param value
+     * @return whether the operation is successful or not
+     * @throw lau::InvalidArgument if the pair cannot fit in a page
+     */
+    bool Modify(const std::string& key, const std::string& value) {
+        auto lock = WriteLock_();
+        CheckSize_(key, value);
+        if (index_.empty()) return false;
+
+        SizeT position = LocateIndex_(key);
+        Page_ page;
+        ReadPage_(index_[position].ptr, page);
+        auto iter = LowerBound_(page.nodes, key);
+        if (iter == page.nodes.end() || !Equal_(iter->key, key)) return false;
+        iter->value = value;
+        PutPage_(position, page);
+        storage_.EndOperation();
+        return true;
+    }
+
+    /**
+     * Clear all the data in the list.  The pages are reused later.
+     * @return reference of the current class
+     */
+    FileStringUnrolledLinkedList& Clear() {
+        auto lock = WriteLock_();
+        if (index_.empty()) return *this;
+
+        // Put all the pages before the garbage pages
+        Ptr last = index_.back().ptr;
+        PageHeader_ header;
+        ReadHeader_(last, header);
+        header.next = head_.nextGarbage;
+        WriteHeader_(last, header);
+        head_.nextGarbage = head_.next;
+        head_.next = 0;
+        WriteHead_();
+        storage_.EndOperation();
+        index_.clear();
+        return *this;
+    }
+
+    /**
+     * Tell whether there exists a node with a certain key or not.
+     * @param key the key to search
+     * @return The boolean of whether there exists a node with a certain key
+     * or not
+     */
+    [[nodiscard]] bool Exist(const std::string& key) const {
+        auto lock = ReadLock_();
+        return FindValue_(key).first;
+    }
+
+    /**
+     * Get the corresponding value of the key.  If there is no such node,
+     * it will return an empty string.
+     * @param key
+     * @return the corresponding value of the key.
+     * <br>
+     * If there is no such node, it will return an empty string.
+     */
+    [[nodiscard]] std::string Get(const std::string& key) const {
+        auto lock = ReadLock_();
+        auto [found, value] = FindValue_(key);
+        if (!found) return std::string(); // no such node
+        return std::string(value);
+    }
+
+    /**
+     * Get the point of the value of a certain key.
+     * If the key doesn't exist, a nullptr will be returned instead.
+     * <br><br>
+     * WARNING: If the function doesn't return a nullptr, ALWAYS free
+     * the memory whenever you don't need it to avoid memory leak.
+     * @param key
+     * @return the point of the value of a certain key.
+     * <br>
+     * If the key doesn't exist, a nullptr will be returned instead.
+     */
+    [[nodiscard]] std::string* GetWithPointer(const std::string& key) const {
+        auto lock = ReadLock_();
+        auto [found, value] = FindValue_(key);
+        if (!found) return nullptr; // no such node
+        return new std::string(value);
+    }
+
+    /**
+     * Get all the key-value pair in the list.
+     * @return the <code>std::vector</code> class containing all the
+     * <code>Node</code>s in the list
+     */
+    std::vector<Node> Traverse() const {
+        auto lock = ReadLock_();
+        std::vector<Node> values;
+        Page_ page;
+        for (const auto& entry : index_) {
+            ReadPage_(entry.ptr, page);
+            for (auto& node : page.nodes) values.push_back(std::move(node));
+        }
+        return values;
+    }
+
+    /**
+     * Flush to make everything in the buffer stored in the file
+     * @return reference of the current class
+     */
+    FileStringUnrolledLinkedList& Flush() {
+        auto lock = WriteLock_();
+        storage_.Flush();
+        return *this;
+    }
+
+    /**
+     * Tell whether the list is empty.
+     * @return the boolean of whether the list is empty
+     */
+    [[nodiscard]] bool Empty() const {
+        auto lock = ReadLock_();
+        return (head_.next == 0);
+    }
+
+private:
+    using Length_ = std::uint32_t;
+
+    /**
+     * @struct FirstNode_{next, nextGarbage, pageSize, restartInterval}
+     *
+     * This is the node to pointer to the data, and metadata of the list
+     */
+    struct FirstNode_ {
+        Ptr   next; // the first page
+        Ptr   nextGarbage; // the first garbage page
+        SizeT pageSize;
+        SizeT restartInterval; // 0 if the keys are not front coded
+    };
+
+    /**
+     * @struct PageHeader_{next, count, heap}
+     *
+     * The header at the front of a page, which is followed by the offsets
+     * of the records.  The records are at [heap, pageSize) of the page.
+     * <br>
+     * If the keys are front coded, the header is followed by the records
+     * instead, which are at [sizeof(PageHeader_), heap) of the page, and
+     * the offsets of the records at the restart points are at the end of
+     * the page.
+     */
+    struct PageHeader_ {
+        Ptr   next; // the next page (or the next garbage page)
+        SizeT count; // the number of records
+        SizeT heap; // the offset of the first record (or the end of the records if front coded) in the page
+    };
+
+    /**
+     * @struct Page_{header, nodes}
+     *
+     * A page decoded in memory.
+     */
+    struct Page_ {
+        PageHeader_       header;
+        std::vector<Node> nodes;
+    };
+
+    /**
+     * @struct Entry_{shared, suffix, value, next}
+     *
+     * A record decoded from a page whose keys are front coded.  The key is
+     * the first shared bytes of the key before it followed by the suffix.
+     */
+    struct Entry_ {
+        SizeT            shared;
+        std::string_view suffix;
+        std::string_view value;
+        const char*      next; // the record after it
+    };
+
+    /**
+     * @struct IndexEntry_{key, ptr}
+     *
+     * The first key of a page and the place of the page, which are kept
+     * in memory in the order of the keys.
+     */
+    struct IndexEntry_ {
+        std::string key;
+        Ptr         ptr;
+    };
+
+    /**
+     * Lock the list for a function that only reads the list.
+     * @return the shared lock of the list
+     */
+    std::shared_lock<std::shared_mutex> ReadLock_() const {
+        return latch_->ReadLock();
+    }
+
+    /**
+     * Lock the list for a function that modifies the list.
+     * @return the exclusive lock of the list
+     */
+    std::unique_lock<std::shared_mutex> WriteLock_() {
+        return latch_->WriteLock();
+    }
+
+    [[nodiscard]] bool Equal_(std::string_view lhs, std::string_view rhs) const {
+        return !compare_(lhs, rhs) && !compare_(rhs, lhs);
+    }
+
+    /**
+     * Get the number of bytes a key-value pair takes in a page, including
+     * its offset.
+     * @param key
+     * @param value
+     * @return the number of bytes
+     */
+    static SizeT RecordSize_(const std::string& key, const std::string& value) {
+        return static_cast<SizeT>(3 * sizeof(Length_) + key.size() + value.size());
+    }
+
+    /**
+     * Get the number of bytes a node takes in a page, which depends on the
+     * node before it if the keys are front coded.
+     * @param first the first node of the page
+     * @param node
+     * @return the number of bytes
+     */
+    SizeT NodeBytes_(const Node* first, const Node* node) const {
+        if (head_.restartInterval == 0) return RecordSize_(node->key, node->value);
+        SizeT shared = 0, bytes = 0;
+        if ((node - first) % head_.restartInterval == 0) bytes += static_cast<SizeT>(sizeof(Length_));
+        else shared = SharedPrefix_((node - 1)->key, node->key);
+        SizeT unshared = static_cast<SizeT>(node->key.size()) - shared;
+        SizeT valueSize = static_cast<SizeT>(node->value.size());
+        return bytes + VarintBytes_(shared) + VarintBytes_(unshared) + VarintBytes_(valueSize) + unshared + valueSize;
+    }
+
+    /**
+     * Get the number of bytes a page of the nodes takes.
+     * @param first
+     * @param last
+     * @return the number of bytes
+     */
+    SizeT PageBytes_(const Node* first, const Node* last) const {
+        SizeT bytes = sizeof(PageHeader_);
+        for (const Node* node = first; node != last; ++node) bytes += NodeBytes_(first, node);
+        return bytes;
+    }
+
+    /**
+     * Check whether a key-value pair fits in a page.
+     * @param key
+     * @param value
+     * @throw lau::InvalidArgument if the pair cannot fit in a page
+     */
+    void CheckSize_(const std::string& key, const std::string& value) const {
+        SizeT bytes = RecordSize_(key, value);
+        if (head_.restartInterval != 0) {
+            auto keySize = static_cast<SizeT>(key.size()), valueSize = static_cast<SizeT>(value.size());
+            bytes = static_cast<SizeT>(sizeof(Length_)) + VarintBytes_(0) + VarintBytes_(keySize)
+                    + VarintBytes_(valueSize) + keySize + valueSize;
+        }
+        if (static_cast<SizeT>(sizeof(PageHeader_)) + bytes > head_.pageSize) {
+            throw lau::InvalidArgument("Invalid Argument: the key-value pair is too large for a page");
+        }
+    }
+
+    static SizeT SharedPrefix_(const std::string& lhs, const std::string& rhs) {
+        return std::mismatch(lhs.begin(), lhs.begin() + std::min(lhs.size(), rhs.size()), rhs.begin()).first
+               - lhs.begin();
+    }
+
+    static SizeT VarintBytes_(SizeT value) {
+        SizeT bytes = 1;
+        for (; value >= 128; value >>= 7) ++bytes;
+        return bytes;
+    }
+
+    /**
+     * Store a non-negative integer in 7-bit groups, where the highest bit
+     * of a byte tells whether there are more bytes.
+     * @param target
+     * @param value
+     * @return the end of the stored bytes
+     */
+    static char* StoreVarint_(char* target, SizeT value) {
+        for (; value >= 128; value >>= 7) *target++ = static_cast<char>(value | 128);
+        *target++ = static_cast<char>(value);
+        return target;
+    }
+
+    static const char* LoadVarint_(const char* source, SizeT& value) {
+        value = 0;
+        for (int shift = 0;; shift += 7) {
+            auto byte = static_cast<unsigned char>(*source++);
+            value |= static_cast<SizeT>(byte & 127) << shift;
+            if (byte < 128) return source;
+        }
+    }
+
+    /**
+     * Decode a record in a page whose keys are front coded.
+     * @param record
+     * @return the decoded record
+     */
+    static Entry_ LoadEntry_(const char* record) {
+        SizeT shared, unshared, valueSize;
+        record = LoadVarint_(record, shared);
+        record = LoadVarint_(record, unshared);
+        record = LoadVarint_(record, valueSize);
+        return Entry_{shared, std::string_view(record, unshared), std::string_view(record + unshared, valueSize),
+                      record + unshared + valueSize};
+    }
+
+    /**
+     * Get the number of restart points of a page whose keys are front
+     * coded.
+     * @param count the number of records in the page
+     * @return the number of restart points
+     */
+    [[nodiscard]] SizeT Restarts_(SizeT count) const {
+        return (count + head_.restartInterval - 1) / head_.restartInterval;
+    }
+
+    static Length_ LoadLength_(const char* source) {
+        Length_ length;
+        std::memcpy(&length, source, sizeof(Length_));
+        return length;
+    }
+
+    static void StoreLength_(char* target, SizeT length) {
+        auto value = static_cast<Length_>(length);
+        std::memcpy(target, &value, sizeof(Length_));
+    }
+
+    /**
+     * Get the key of a record in a page read into memory.
+     * @param page
+     * @param index the index of the record in the order of the keys
+     * @return the key
+     */
+    static std::string_view Key_(const char* page, SizeT index) {
+        const char* record = page + LoadLength_(page + sizeof(PageHeader_) + index * sizeof(Length_));
+        return std::string_view(record + 2 * sizeof(Length_), LoadLength_(record));
+    }
+
+    /**
+     * Get the value of a record in a page read into memory.
+     * @param page
+     * @param index the index of the record in the order of the keys
+     * @return the value
+     */
+    static std::string_view Value_(const char* page, SizeT index) {
+        const char* record = page + LoadLength_(page + sizeof(PageHeader_) + index * sizeof(Length_));
+        return std::string_view(record + 2 * sizeof(Length_) + LoadLength_(record),
+                                LoadLength_(record + sizeof(Length_)));
+    }
+
+    /**
+     * Read a page into the buffer of the thread.  The page is valid until
+     * the next call of this function in the same thread.
+     * @param ptr the place of the page
+     * @return the page in memory
+     */
+    const char* ReadRawPage_(Ptr ptr) const {
+        static thread_local std::vector<char> buffer; // one for each thread to read in parallel
+        if (static_cast<SizeT>(buffer.size()) < head_.pageSize) buffer.resize(head_.pageSize);
+        storage_.Read(buffer.data(), ptr, head_.pageSize);
+        return buffer.data();
+    }
+
+    /**
+     * Get the first key of a page read into memory.
+     * @param page
+     * @return the first key
+     */
+    [[nodiscard]] std::string_view FirstKey_(const char* page) const {
+        if (head_.restartInterval == 0) return Key_(page, 0);
+        return LoadEntry_(page + sizeof(PageHeader_)).suffix; // the first record is a restart point
+    }
+
+    /**
+     * Read a page and decode all its records.
+     * @param ptr the place of the page
+     * @param page the place to put the page
+     */
+    void ReadPage_(Ptr ptr, Page_& page) const {
+        const char* buffer = ReadRawPage_(ptr);
+        std::memcpy(&page.header, buffer, sizeof(PageHeader_));
+        page.nodes.clear();
+        page.nodes.reserve(page.header.count);
+        if (head_.restartInterval == 0) {
+            for (SizeT i = 0; i < page.header.count; ++i) {
+                page.nodes.push_back(Node{std::string(Key_(buffer, i)), std::string(Value_(buffer, i))});
+            }
+            return;
+        }
+
+        const char* record = buffer + sizeof(PageHeader_);
+        for (SizeT i = 0; i < page.header.count; ++i) {
+            Entry_ entry = LoadEntry_(record);
+            std::string key = i == 0 ? std::string() : page.nodes.back().key.substr(0, entry.shared);
+            key.append(entry.suffix);
+            page.nodes.push_back(Node{std::move(key), std::string(entry.value)});
+            record = entry.next;
+        }
+    }
+
+    /**
+     * Encode the nodes into a page and write it.  The nodes MUST fit in a
+     * page.
+     * @param ptr the place of the page
+     * @param next the next page
+     * @param first the first node
+     * @param last the end of the nodes
+     */
+    void WritePage_(Ptr ptr, Ptr next, const Node* first, const Node* last) {
+        if (head_.restartInterval != 0) {
+            WriteFrontCodedPage_(ptr, next, first, last);
+            return;
+        }
+        PageHeader_ header{next, static_cast<SizeT>(last - first), head_.pageSize};
+        char* buffer = pageBuffer_.data();
+        for (SizeT i = 0; first + i != last; ++i) {
+            const Node& node = first[i];
+            header.heap -= static_cast<SizeT>(2 * sizeof(Length_) + node.key.size() + node.value.size());
+            char* record = buffer + header.heap;
+            StoreLength_(record, static_cast<SizeT>(node.key.size()));
+            StoreLength_(record + sizeof(Length_), static_cast<SizeT>(node.value.size()));
+            std::memcpy(record + 2 * sizeof(Length_), node.key.data(), node.key.size());
+            std::memcpy(record + 2 * sizeof(Length_) + node.key.size(), node.value.data(), node.value.size());
+            StoreLength_(buffer + sizeof(PageHeader_) + i * sizeof(Length_), header.heap);
+        }
+        std::memcpy(buffer, &header, sizeof(PageHeader_));
+
+        // Only the used parts are written
+        SizeT slotEnd = static_cast<SizeT>(sizeof(PageHeader_) + header.count * sizeof(Length_));
+        storage_.Write(buffer, ptr, slotEnd);
+        storage_.Write(buffer + header.heap, ptr + header.heap, head_.pageSize - header.heap);
+    }
+
+    /**
+     * Encode the nodes into a page with the keys front coded and write it.
+     * The nodes MUST fit in a page.
+     * @param ptr the place of the page
+     * @param next the next page
+     * @param first the first node
+     * @param last the end of the nodes
+     */
+    void WriteFrontCodedPage_(Ptr ptr, Ptr next, const Node* first, const Node* last) {
+        PageHeader_ header{next, static_cast<SizeT>(last - first), static_cast<SizeT>(sizeof(PageHeader_))};
+        char* buffer = pageBuffer_.data();
+        SizeT restartBytes = Restarts_(header.count) * static_cast<SizeT>(sizeof(Length_));
+        char* restarts = buffer + head_.pageSize - restartBytes;
+        for (SizeT i = 0; i < header.count; ++i) {
+            const Node& node = first[i];
+            SizeT shared = 0;
+            if (i % head_.restartInterval == 0) {
+                StoreLength_(restarts + i / head_.restartInterval * sizeof(Length_), header.heap);
+            } else {
+                shared = SharedPrefix_(first[i - 1].key, node.key);
+            }
+            char* record = buffer + header.heap;
+            record = StoreVarint_(record, shared);
+            record = StoreVarint_(record, static_cast<SizeT>(node.key.size()) - shared);
+            record = StoreVarint_(record, static_cast<SizeT>(node.value.size()));
+            std::memcpy(record, node.key.data() + shared, node.key.size() - shared);
+            record += node.key.size() - shared;
+            std::memcpy(record, node.value.data(), node.value.size());
+            header.heap = static_cast<SizeT>(record + node.value.size() - buffer);
+        }
+        std::memcpy(buffer, &header, sizeof(PageHeader_));
+
+        // Only the used parts are written
+        storage_.Write(buffer, ptr, header.heap);
+        storage_.Write(restarts, ptr + head_.pageSize - restartBytes, restartBytes);
+    }
+
+    void ReadHeader_(Ptr ptr, PageHeader_& header) const {
+        storage_.Read(reinterpret_cast<char*>(&header), ptr, sizeof(PageHeader_));
+    }
+
+    void WriteHeader_(Ptr ptr, const PageHeader_& header) {
+        storage_.Write(reinterpret_cast<const char*>(&header), ptr, sizeof(PageHeader_));
+    }
+
+    /**
+     * Find the value of a key.
+     * @param key
+     * @return whether the key exists and the value in the page read into
+     * memory
+     */
+    std::pair<bool, std::string_view> FindValue_(const std::string& key) const {
+        if (index_.empty()) return std::make_pair(false, std::string_view());
+        const char* page = ReadRawPage_(index_[LocateIndex_(key)].ptr);
+        PageHeader_ header;
+        std::memcpy(&header, page, sizeof(PageHeader_));
+        if (head_.restartInterval != 0) return FindFrontCoded_(page, header.count, key);
+
+        // Binary search on the offsets without decoding the records
+        SizeT left = 0, right = header.count;
+        while (left < right) {
+            SizeT middle = (left + right) / 2;
+            if (compare_(Key_(page, middle), key)) left = middle + 1;
+            else right = middle;
+        }
+        if (left == header.count || !Equal_(Key_(page, left), key)) return std::make_pair(false, std::string_view());
+        return std::make_pair(true, Value_(page, left));
+    }
+
+    /**
+     * Find the value of a key in a page whose keys are front coded.  Only
+     * the keys from the restart point before the key are decoded.
+     * @param page the page read into memory
+     * @param count the number of records in the page
+     * @param key
+     * @return whether the key exists and the value in the page
+     */
+    std::pair<bool, std::string_view> FindFrontCoded_(const char* page, SizeT count, const std::string& key) const {
+        const char* restarts = page + head_.pageSize - Restarts_(count) * static_cast<SizeT>(sizeof(Length_));
+
+        // Binary search on the restart points, whose keys are whole
+        SizeT left = 0, right = Restarts_(count);
+        while (left < right) {
+            SizeT middle = (left + right) / 2;
+            if (compare_(key, LoadEntry_(page + LoadLength_(restarts + middle * sizeof(Length_))).suffix)) {
+                right = middle;
+            } else {
+                left = middle + 1;
+            }
+        }
+        if (left == 0) return std::make_pair(false, std::string_view()); // less than all the keys
+
+        const char* record = page + LoadLength_(restarts + (left - 1) * sizeof(Length_));
+        SizeT end = std::min(count, left * head_.restartInterval);
+        std::string current;
+        for (SizeT i = (left - 1) * head_.restartInterval; i < end; ++i) {
+            Entry_ entry = LoadEntry_(record);
+            current.resize(entry.shared);
+            current.append(entry.suffix);
+            if (!compare_(current, key)) {
+                if (compare_(key, current)) break;
+                return std::make_pair(true, entry.value);
+            }
+            record = entry.next;
+        }
+        return std::make_pair(false, std::string_view());
+    }
+
+    /**
+     * Get the first node whose key is not less than the key.
+     * @param nodes
+     * @param key
+     * @return the iterator of the node
+     */
+    typename std::vector<Node>::iterator LowerBound_(std::vector<Node>& nodes, const std::string& key) const {
+        return std::lower_bound(nodes.begin(), nodes.end(), key,
+                                [this](const Node& lhs, const std::string& rhs) { return compare_(lhs.key, rhs); });
+    }
+
+    /**
+     * Get the position in the index of the page whose range may contain
+     * the key, i.e. the last page whose first key is not greater than the
+     * key.  If the key is less than all the keys, 0 will be returned.  The
+     * index MUST NOT be empty.
+     * @param key
+     * @return the position in the index
+     */
+    SizeT LocateIndex_(const std::string& key) const {
+        auto iter = std::upper_bound(index_.begin(), index_.end(), key,
+                                     [this](const std::string& lhs, const IndexEntry_& rhs) {
+                                         return compare_(lhs, rhs.key);
+                                     });
+        return iter == index_.begin() ? 0 : iter - index_.begin() - 1;
+    }
+
+    /**
+     * Build the index of pages by walking through the pages once.
+     */
+    void BuildIndex_() {
+        index_.clear();
+        PageHeader_ header;
+        for (Ptr ptr = head_.next; ptr != 0; ptr = header.next) {
+            const char* page = ReadRawPage_(ptr);
+            std::memcpy(&header, page, sizeof(PageHeader_));
+            index_.push_back(IndexEntry_{std::string(FirstKey_(page)), ptr});
+        }
+    }
+
+    /**
+     * Get the first nodes of the pieces that the nodes are split into, so
+     * that each piece fits in a page.  The nodes are split into two pieces
+     * of about the same size if possible.
+     * @param nodes
+     * @return the indexes of the first nodes of the pieces
+     */
+    std::vector<SizeT> SplitPoints_(const std::vector<Node>& nodes) const {
+        const Node* first = nodes.data();
+        SizeT count = static_cast<SizeT>(nodes.size());
+
+        // Try two pieces of about the same size
+        SizeT total = PageBytes_(first, first + count);
+        SizeT middle = 0;
+        for (SizeT bytes = sizeof(PageHeader_); middle < count && bytes < total / 2; ++middle) {
+            bytes += NodeBytes_(first, first + middle);
+        }
+        for (SizeT split : {middle, middle - 1, middle + 1}) {
+            if (split <= 0 || split >= count) continue;
+            if (PageBytes_(first, first + split) <= head_.pageSize
+                && PageBytes_(first + split, first + count) <= head_.pageSize) {
+                return {0, split};
+            }
+        }
+
+        // Put as many nodes as possible in each piece otherwise
+        std::vector<SizeT> points{0};
+        SizeT bytes = PageBytes_(first, first + 1);
+        for (SizeT i = 1; i < count; ++i) {
+            SizeT nodeBytes = NodeBytes_(first + points.back(), first + i);
+            if (bytes + nodeBytes <= head_.pageSize) {
+                bytes += nodeBytes;
+            } else {
+                points.push_back(i);
+                bytes = PageBytes_(first + i, first + i + 1);
+            }
+        }
+        return points;
+    }
+
+    /**
+     * Write a page modified in memory back, and split it into as many
+     * pages as needed if it is too large.
+     * @param position the position of the page in the index
+     * @param page
+     */
+    void PutPage_(SizeT position, const Page_& page) {
+        const Node* nodes = page.nodes.data();
+        SizeT count = static_cast<SizeT>(page.nodes.size());
+        Ptr ptr = index_[position].ptr;
+        if (PageBytes_(nodes, nodes + count) <= head_.pageSize) {
+            WritePage_(ptr, page.header.next, nodes, nodes + count);
+            index_[position].key = nodes[0].key;
+            return;
+        }
+
+        // Write the new pages from the last one, so that each of them is
+        // linked to the one after it
+        std::vector<SizeT> points = SplitPoints_(page.nodes);
+        Ptr next = page.header.next;
+        SizeT end = count;
+        for (SizeT i = static_cast<SizeT>(points.size()) - 1; i > 0; --i) {
+            Ptr newPtr = NewPage_();
+            WritePage_(newPtr, next, nodes + points[i], nodes + end);
+            index_.insert(index_.begin() + position + 1, IndexEntry_{nodes[points[i]].key, newPtr});
+            next = newPtr;
+            end = points[i];
+        }
+        WritePage_(ptr, next, nodes, nodes + end);
+        index_[position].key = nodes[0].key;
+    }
+
+    /**
+     * Merge a page with few bytes in use with its neighbour (the next one,
+     * or the previous one for the last page) if they fit in one page.
+     * @param position the position of the page in the index
+     * @param page the page, which has been written and is no longer
+     * needed
+     */
+    void Rebalance_(SizeT position, Page_& page) {
+        if (index_.size() == 1) return;
+        SizeT left = position, right = position + 1;
+        if (right == static_cast<SizeT>(index_.size())) {
+            left = position - 1;
+            right = position;
+        }
+
+        Page_ other;
+        ReadPage_(index_[left == position ? right : left].ptr, other);
+        std::vector<Node>& leftNodes = left == position ? page.nodes : other.nodes;
+        std::vector<Node>& rightNodes = left == position ? other.nodes : page.nodes;
+        leftNodes.insert(leftNodes.end(), std::make_move_iterator(rightNodes.begin()),
+                         std::make_move_iterator(rightNodes.end()));
+        if (PageBytes_(leftNodes.data(), leftNodes.data() + leftNodes.size()) > head_.pageSize) return;
+
+        Ptr rightNext = (left == position ? other : page).header.next;
+        WritePage_(index_[left].ptr, rightNext, leftNodes.data(), leftNodes.data() + leftNodes.size());
+        FreePage_(index_[right].ptr);
+        index_.erase(index_.begin() + right);
+    }
+
+    /**
+     * Remove a page from the list and put it into the garbage pages.
+     * @param position the position of the page in the index
+     */
+    void DeletePage_(SizeT position) {
+        Ptr ptr = index_[position].ptr;
+        PageHeader_ header;
+        ReadHeader_(ptr, header);
+        if (position == 0) {
+            head_.next = header.next;
+            WriteHead_();
+        } else {
+            PageHeader_ pre;
+            ReadHeader_(index_[position - 1].ptr, pre);
+            pre.next = header.next;
+            WriteHeader_(index_[position - 1].ptr, pre);
+        }
+        FreePage_(ptr);
+        index_.erase(index_.begin() + position);
+    }
+
+    /**
+     * Put a page that is no longer linked into the garbage pages.
+     * @param ptr the place of the page
+     */
+    void FreePage_(Ptr ptr) {
+        WriteHeader_(ptr, PageHeader_{head_.nextGarbage, 0, head_.pageSize});
+        head_.nextGarbage = ptr;
+        WriteHead_();
+    }
+
+    /**
+     * Get a page from the garbage pages, or a new page at the end of the
+     * file if there are no garbage pages.
+     * @return the place of the page
+     */
+    Ptr NewPage_() {
+        if (head_.nextGarbage == 0) return storage_.Allocate(head_.pageSize);
+        Ptr ptr = head_.nextGarbage;
+        PageHeader_ header;
+        ReadHeader_(ptr, header);
+        head_.nextGarbage = header.next;
+        WriteHead_();
+        return ptr;
+    }
+
+    /**
+     * Write the first node (the head of the list).
+     */
+    void WriteHead_() {
+        storage_.Write(reinterpret_cast<const char*>(&head_), 0, sizeof(FirstNode_));
+    }
+
+    mutable Storage storage_;
+    FirstNode_ head_;
+    Compare compare_;
+    std::vector<IndexEntry_> index_; // the first keys of the pages in order
+    std::vector<char> pageBuffer_; // the buffer to encode a page
+    std::unique_ptr<ReaderWriterLatch> latch_ = std::make_unique<ReaderWriterLatch>(); // in the heap to be movable
+};
+
+}
+
+#endif // LAU_CPP_LIB_LAU_FILE_STRING_UNROLLED_LINKED_LIST_H
@@ -24,10 +24,32 @@
 #ifndef LAU_CPP_LIB_LAU_FILE_UNROLLED_LINKED_LIST_H
 #define LAU_CPP_LIB_LAU_FILE_UNROLLED_LINKED_LIST_H
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "async_reader.h"
+#include "clock_cache.h"
+#include "crc32c.h"
+#include "exception.h"
+#include "file_storage.h"
+#include "reader_writer_latch.h"
 #include "type_traits.h"
 
 namespace lau {
@@ -38,6 +60,7 @@ namespace lau {
  * This is a template class of unrolled linked list on disk storage.
  * @tparam KeyType Type of Key
  * @tparam ValueType Type of Value
+ * @tparam Storage Type of the storage, <code>lau::FileStorage</code> by default
  *
  * CAUTION:
  * <br>
@@ -45,8 +68,23 @@ namespace lau {
  * <br>
  * 2. The key and value type must have default constructor and trivial
  * move and copy constructor.
+ * <br>
+ * 3. The functions that only read the list (e.g. <code>Get</code>) can
+ * be called by several threads at the same time, and the functions that
+ * modify the list wait until no other function is running.
+ * <br>
+ * 4. The Bloom filters hash the bytes of the keys, so they can only be
+ * used if equal keys always have the same bytes.
+ * <br>
+ * 5. The file begins with a head with a magic number, the version of the
+ * format and the sizes of the keys and values, and each main node keeps
+ * the CRC-32C of itself and its array, which is checked whenever the array
+ * is read to look up or traverse the list.  The head also keeps the
+ * statistics of the list (see <code>Stats</code>) and the number of
+ * modifications.  A file made before the head had a version, or of an
+ * older version, is upgraded when it is opened with its name.
  */
-template <class KeyType, class ValueType>
+template <class KeyType, class ValueType, class Storage = FileStorage>
 class FileUnrolledLinkedList {
 public:
     using Ptr = long;
@@ -61,31 +99,324 @@ public:
         ValueType value;
     };
 
-    explicit FileUnrolledLinkedList(const std::string& fileName, SizeT nodeSize = 316) noexcept
-        : list_(fileName), head_{0, 0, 0, nodeSize, 2 * nodeSize} {
-        list_.seekg(0);
-        list_.seekp(0);
-        if (list_.peek() == EOF) {
-            list_.seekg(0, std::ios::beg);
-            list_.seekp(0, std::ios::beg);
-            list_.write(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
-        } else {
-            list_.read(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
+    /**
+     * @struct Statistics{size, blockCount, garbageCount, minKey, maxKey,
+     * fillFactor}
+     *
+     * The statistics of the list.  The keys are the default ones if the
+     * list is empty, and the fill factor is the ratio of the number of
+     * key-value pairs to the capacity of the main nodes with
+     * <code>nodeSize</code> nodes in their arrays.
+     */
+    struct Statistics {
+        SizeT   size; // the number of key-value pairs
+        SizeT   blockCount; // the number of main nodes
+        SizeT   garbageCount; // the number of deleted main nodes to be reused
+        KeyType minKey;
+        KeyType maxKey;
+        double  fillFactor;
+    };
+
+    /**
+     * @class ScanIterator
+     *
+     * The iterator of the nodes in a range, which reads the list lazily.
+     * The main nodes with their arrays are read in windows with the reads
+     * in flight at the same time (see <code>ReadBatch</code> of the
+     * storages).  The first window has one main node, and each window is
+     * twice as large as the last one (up to 64 main nodes), so a short
+     * scan reads little and a long scan keeps the device busy.
+     * <br><br>
+     * The iterator is invalid once the list is modified.
+     */
+    class ScanIterator {
+        friend FileUnrolledLinkedList;
+
+    public:
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = Node;
+        using pointer           = const Node*;
+        using reference         = const Node&;
+        using iterator_category = std::input_iterator_tag;
+
+        ScanIterator() noexcept = default;
+        ScanIterator(const ScanIterator& obj) = default;
+        ScanIterator(ScanIterator&& obj) noexcept = default;
+
+        ScanIterator& operator=(const ScanIterator& obj) = default;
+        ScanIterator& operator=(ScanIterator&& obj) noexcept = default;
+
+        ~ScanIterator() = default;
+
+        ScanIterator operator++(int) {
+            ScanIterator tmp = *this;
+            ++(*this);
+            return tmp;
         }
-    }
 
-    explicit FileUnrolledLinkedList(const char* fileName, SizeT nodeSize = 316) noexcept
-        : list_(fileName), head_{0, 0, 0, nodeSize, 2 * nodeSize} {
-        list_.seekg(0);
-        list_.seekp(0);
-        if (list_.peek() == EOF) {
-            list_.seekg(0, std::ios::beg);
-            list_.seekp(0, std::ios::beg);
-            list_.write(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
-        } else {
-            list_.read(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
+        ScanIterator& operator++() {
+            ++position_;
+            if (position_ == static_cast<SizeT>(block_.size()) && list_ != nullptr) {
+                auto lock = list_->ReadLock_();
+                LoadBlock_(next_);
+            }
+            if (list_ != nullptr && highKey_ < block_[position_].key) list_ = nullptr; // out of range
+            return *this;
         }
-    }
+
+        bool operator==(const ScanIterator& rhs) const noexcept {
+            if (list_ == nullptr || rhs.list_ == nullptr) return list_ == rhs.list_;
+            return mainNodePtr_ == rhs.mainNodePtr_ && position_ == rhs.position_;
+        }
+
+        bool operator!=(const ScanIterator& rhs) const noexcept { return !(*this == rhs); }
+
+        const Node& operator*()  const { return block_[position_]; }
+        const Node* operator->() const { return &(block_[position_]); }
+
+    private:
+        ScanIterator(const FileUnrolledLinkedList* list, const KeyType& lowKey, const KeyType& highKey)
+            : list_(list), highKey_(highKey) {
+            auto lock = list_->ReadLock_();
+            if (list_->index_.empty() || highKey < lowKey || highKey < list_->head_.minKey
+                || list_->head_.maxKey < lowKey) {
+                list_ = nullptr;
+                return;
+            }
+
+            // Skip the nodes less than the lower key in the first main node
+            LoadBlock_(list_->LocateIndex_(lowKey));
+            position_ = std::lower_bound(block_.begin(), block_.end(), lowKey,
+                                         [](const Node& lhs, const KeyType& rhs) { return lhs.key < rhs; })
+                        - block_.begin();
+            if (position_ == static_cast<SizeT>(block_.size())) LoadBlock_(next_);
+            if (list_ != nullptr && highKey_ < block_[position_].key) list_ = nullptr;
+        }
+
+        /**
+         * Get the main node and its array into the buffer, reading a new
+         * window if it is not in the current one.  If the position is the
+         * end of the index, the iterator becomes the end.
+         * @param position the position of the main node in the index
+         */
+        void LoadBlock_(SizeT position) {
+            if (position == static_cast<SizeT>(list_->index_.size())) {
+                list_ = nullptr;
+                return;
+            }
+            if (window_ == nullptr || position < windowFirst_ || position >= windowFirst_ + windowCount_) {
+                ReadWindow_(position);
+            }
+            MainNode_ mainNode;
+            Ptr ptr = list_->index_[position].ptr;
+            const Node_* array = list_->ParseBlock_(window_->data() + (position - windowFirst_) * list_->BlockSize_(),
+                                                    ptr, mainNode);
+            block_.resize(mainNode.count + 1);
+            block_[0] = Node{mainNode.key, mainNode.value};
+            std::copy(array, array + mainNode.count, block_.begin() + 1);
+            mainNodePtr_ = ptr;
+            next_ = position + 1;
+            position_ = 0;
+        }
+
+        /**
+         * Read a window of main nodes from the position, leaving out the
+         * main nodes whose keys are greater than the high key.
+         * @param position the position of the first main node in the index
+         */
+        void ReadWindow_(SizeT position) {
+            const auto& index = list_->index_;
+            SizeT count = 1;
+            while (count < readAhead_ && position + count < static_cast<SizeT>(index.size())
+                   && !(highKey_ < index[position + count].key)) {
+                ++count;
+            }
+            readAhead_ = std::min(readAhead_ * 2, kBlocksInFlight_);
+            std::vector<Ptr> ptrs(count);
+            for (SizeT i = 0; i < count; ++i) ptrs[i] = index[position + i].ptr;
+            auto window = std::make_shared<std::vector<char>>();
+            list_->ReadBlocks_(ptrs.data(), count, *window);
+            window_ = std::move(window); // shared by the copies of the iterator
+            windowFirst_ = position;
+            windowCount_ = count;
+        }
+
+        const FileUnrolledLinkedList* list_ = nullptr; // nullptr for the end
+        KeyType highKey_{};
+        std::vector<Node> block_; // the nodes of the current main node
+        Ptr mainNodePtr_ = 0;
+        SizeT next_ = 0; // the position of the next main node in the index
+        SizeT position_ = 0;
+        std::shared_ptr<const std::vector<char>> window_; // the main nodes read together
+        SizeT windowFirst_ = 0; // the position of the first main node of the window in the index
+        SizeT windowCount_ = 0;
+        SizeT readAhead_ = 1; // the number of main nodes in the next window
+    };
+
+    /**
+     * @class ScanRange
+     *
+     * The range of nodes returned by <code>Scan</code>, which can be used
+     * in a range-based for loop.
+     */
+    class ScanRange {
+        friend FileUnrolledLinkedList;
+
+    public:
+        [[nodiscard]] ScanIterator begin() const { return begin_; }
+        [[nodiscard]] ScanIterator end()   const { return ScanIterator(); }
+
+    private:
+        explicit ScanRange(ScanIterator&& begin) : begin_(std::move(begin)) {}
+
+        ScanIterator begin_;
+    };
+
+    /**
+     * @class WriteBatch
+     *
+     * A batch of insertions, erasures and modifications, which are
+     * applied to the list at once by <code>Apply</code>.  The operations
+     * are applied in the order they are added, just as the corresponding
+     * member functions of the list are called one by one.
+     */
+    class WriteBatch {
+        friend FileUnrolledLinkedList;
+
+    public:
+        WriteBatch() = default;
+        WriteBatch(const WriteBatch& obj) = default;
+        WriteBatch(WriteBatch&& obj) noexcept = default;
+
+        WriteBatch& operator=(const WriteBatch& obj) = default;
+        WriteBatch& operator=(WriteBatch&& obj) noexcept = default;
+
+        ~WriteBatch() = default;
+
+        /**
+         * Add an insertion of a new key-value pair.
+         * @param key
+         * @param value
+         * @return reference of the current batch
+         */
+        WriteBatch& Insert(const KeyType& key, const ValueType& value) {
+            operations_.push_back(Operation_{insert, key, value});
+            return *this;
+        }
+
+        /**
+         * Add an erasure of the key-value pair of a key.
+         * @param key
+         * @return reference of the current batch
+         */
+        WriteBatch& Erase(const KeyType& key) {
+            operations_.push_back(Operation_{erase, key, ValueType()});
+            return *this;
+        }
+
+        /**
+         * Add a modification of the value of an existing key-value pair.
+         * @param key
+         * @param value
+         * @return reference of the current batch
+         */
+        WriteBatch& Modify(const KeyType& key, const ValueType& value) {
+            operations_.push_back(Operation_{modify, key, value});
+            return *this;
+        }
+
+        /**
+         * Remove all the operations.
+         * @return reference of the current batch
+         */
+        WriteBatch& Clear() {
+            operations_.clear();
+            return *this;
+        }
+
+        [[nodiscard]] SizeT Size() const noexcept { return static_cast<SizeT>(operations_.size()); }
+
+        [[nodiscard]] bool Empty() const noexcept { return operations_.empty(); }
+
+    private:
+        enum Type_ {insert, erase, modify};
+
+        /**
+         * @struct Operation_{type, key, value}
+         *
+         * An operation in the batch.
+         */
+        struct Operation_ {
+            Type_     type;
+            KeyType   key;
+            ValueType value;
+        };
+
+        std::vector<Operation_> operations_;
+    };
+
+    /**
+     * Construct the list with a file.  The Bloom filters of the main
+     * nodes are kept in a file whose name is the file name with a
+     * <code>.bloom</code> suffix when the list is destructed, and they are
+     * loaded from it (and the file is removed) when the list is
+     * constructed again.  If there is no such file (e.g. the program was
+     * not closed normally), or the list has been modified since they were
+     * kept, they are built by reading the whole list.
+     * @param fileName
+     * @param nodeSize
+     * @param cacheSize the number of key-value pairs cached in memory
+     * @param filterBits the number of bits of the Bloom filters for each
+     * node, or 0 not to use Bloom filters
+     * @throw lau::InvalidArgument if <code>filterBits</code> is negative,
+     * or it is positive but the keys may have padding bits
+     */
+    explicit FileUnrolledLinkedList(const std::string& fileName, SizeT nodeSize = 316, SizeT cacheSize = 64,
+                                    SizeT filterBits = 0)
+        : FileUnrolledLinkedList(fileName, [](const std::string& name) { return Storage(name); },
+                                 nodeSize, cacheSize, filterBits) {}
+
+    explicit FileUnrolledLinkedList(const char* fileName, SizeT nodeSize = 316, SizeT cacheSize = 64,
+                                    SizeT filterBits = 0)
+        : FileUnrolledLinkedList(std::string(fileName), nodeSize, cacheSize, filterBits) {}
+
+    /**
+     * Construct the list with a file and a function to open the storage
+     * of a file by its name, so that the storage can be opened with other
+     * arguments (e.g. the budget of <code>lau::BufferPool</code>) and the
+     * list can still be compacted, since <code>Compact</code> makes and
+     * reopens the file with the same function.  The Bloom filters are kept
+     * in a file as the constructor with only a file name does.
+     * @param fileName
+     * @param openStorage the function to open the storage of a file
+     * @param nodeSize
+     * @param cacheSize the number of key-value pairs cached in memory
+     * @param filterBits the number of bits of the Bloom filters for each
+     * node, or 0 not to use Bloom filters
+     * @throw lau::InvalidArgument if <code>filterBits</code> is negative,
+     * or it is positive but the keys may have padding bits
+     */
+    FileUnrolledLinkedList(const std::string& fileName, std::function<Storage(const std::string&)> openStorage,
+                           SizeT nodeSize = 316, SizeT cacheSize = 64, SizeT filterBits = 0)
+        : FileUnrolledLinkedList(openStorage(fileName), nodeSize, cacheSize, filterBits, fileName, openStorage) {}
+
+    /**
+     * Construct the list with a storage, which decides how the file is
+     * accessed (e.g. <code>lau::BufferPool</code> caches the file in
+     * memory).  The Bloom filters (if any) are built by reading the whole
+     * list, and the file that keeps them (see the constructor with a file
+     * name) is removed, since the list may be modified without them.
+     * @param storage
+     * @param nodeSize
+     * @param cacheSize the number of key-value pairs cached in memory
+     * @param filterBits the number of bits of the Bloom filters for each
+     * node, or 0 not to use Bloom filters
+     * @throw lau::InvalidArgument if <code>filterBits</code> is negative,
+     * or it is positive but the keys may have padding bits
+     */
+    explicit FileUnrolledLinkedList(Storage&& storage, SizeT nodeSize = 316, SizeT cacheSize = 64,
+                                    SizeT filterBits = 0)
+        : FileUnrolledLinkedList(std::move(storage), nodeSize, cacheSize, filterBits, std::string(), nullptr) {}
 
     FileUnrolledLinkedList(FileUnrolledLinkedList&&) noexcept = default;
 
@@ -95,7 +426,9 @@ public:
 
     FileUnrolledLinkedList& operator=(const FileUnrolledLinkedList&) = delete;
 
-    ~FileUnrolledLinkedList() = default;
+    ~FileUnrolledLinkedList() {
+        if (latches_ != nullptr && !broken_) SaveFilters_(); // not moved
+    }
 
     /**
      * Insert a new key-value pair.
@@ -104,46 +437,44 @@ public:
      * @return whether the operation is successful or not
      */
     bool Insert(const KeyType& key, const ValueType& value) {
+        auto lock = WriteLock_();
         // Search the place to accommodate to new pair
         auto [mainNodePtr, index] = Find_(key);
 
         // The case of no nodes at all
         if (mainNodePtr == 0) {
-            MainNode_ mainNode{key, value, 0, 0, 0, 0};
+            MainNode_ mainNode{key, value, 0, 0, 0, 0, 0};
             NewNode_(mainNode, 0);
 
             // Put the new node into cache (store the data in memory to boost efficiency)
-            cachedNode_.key = key;
-            cachedNode_.value = value;
-            cached = true;
+            cache_.Put(key, value);
 
+            head_.maxKey = key;
+            ++(head_.size);
+            EndOperation_();
             return true;
         }
 
         // Get the main node
         MainNode_ mainNode; // the place to place the new node
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+        ReadMainNode_(mainNodePtr, mainNode);
 
         Node_ tmpNode;
         if (mainNode.pre == 0 && key < mainNode.key) {
             // Push back the data
-            char* buffer = Read_(mainNode.target, mainNode.count * sizeof(Node_));
-            Write_(buffer, mainNode.target + sizeof(Node_), mainNode.count * sizeof(Node_));
-            delete[] buffer;
+            storage_.Move(mainNode.target, mainNode.target + sizeof(Node_), mainNode.count * sizeof(Node_));
 
             // Move the data in main node to the first node of its array
             tmpNode.key = mainNode.key;
             tmpNode.value = mainNode.value;
-            list_.seekp(mainNode.target);
-            list_.write(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+            WriteNode_(mainNode.target, tmpNode);
 
             // set the new data in the main node
             mainNode.key = key;
             mainNode.value = value;
             ++(mainNode.count);
-            list_.seekp(mainNodePtr);
-            list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+            WriteMainNode_(mainNodePtr, mainNode);
+            index_.front().key = key;
 
         } else {
             // Rule out the case of the same node
@@ -151,97 +482,254 @@ public:
                 return false;
             }
             if (index != -1) {
-                list_.seekg(mainNode.target + index * sizeof(Node_));
-                list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+                ReadNode_(mainNode.target + index * sizeof(Node_), tmpNode);
                 if (tmpNode.key == key) return false;
             }
 
             // Move the node(s) after the node to be inserted
-            char* buffer = Read_(mainNode.target + (index + 1) * sizeof(Node_),
-                                 (mainNode.count - index - 1) * sizeof(Node_));
-            Write_(buffer, mainNode.target + (index + 2) * sizeof(Node_),
-                   (mainNode.count - index - 1) * sizeof(Node_));
-            delete[] buffer;
+            storage_.Move(mainNode.target + (index + 1) * sizeof(Node_), mainNode.target + (index + 2) * sizeof(Node_),
+                          (mainNode.count - index - 1) * sizeof(Node_));
 
             // Put the new node
             Node_ newNode{key, value};
-            list_.seekp(mainNode.target + (index + 1) * sizeof(Node_));
-            list_.write(reinterpret_cast<char*>(&newNode), sizeof(Node_));
+            WriteNode_(mainNode.target + (index + 1) * sizeof(Node_), newNode);
 
             // Change the main node
             ++(mainNode.count);
-            list_.seekp(mainNodePtr);
-            list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+            WriteMainNode_(mainNodePtr, mainNode);
         }
 
+        AddToFilter_(index_[LocateIndex_(key)].filter, key);
+
         // Split the main node if it is larger its expected size
         if (mainNode.count >= head_.maxNodeSize) {
             Split_(mainNode, mainNodePtr);
         }
 
         // Put the new node into cache (store the data in memory to boost efficiency)
-        cachedNode_.key = key;
-        cachedNode_.value = value;
-        cached = true;
+        cache_.Put(key, value);
 
+        if (head_.maxKey < key) head_.maxKey = key;
+        ++(head_.size);
+        EndOperation_();
         return true;
     }
 
+    /**
+     * Load a sorted sequence of key-value pairs into the list.  The pairs
+     * are packed into full main nodes (with <code>nodeSize</code> nodes in
+     * the array) that are written one after another at the end of the
+     * file, and the header is written only once at the end.
+     * <br><br>
+     * The keys MUST be strictly increasing and greater than all the keys
+     * in the list, so that the pairs can be appended to the list.
+     * @tparam InputIterator an iterator of elements with the members
+     * <code>key</code> and <code>value</code> (e.g. <code>Node</code>)
+     * @param first
+     * @param last
+     * @return the number of pairs loaded
+     * @throw lau::InvalidArgument if a key is not greater than the keys
+     * before it (the pairs before it are loaded)
+     */
+    template <class InputIterator>
+    SizeT BulkLoad(InputIterator first, InputIterator last) {
+        auto lock = WriteLock_();
+        SizeT loaded = 0;
+        bool failed = false;
+
+        // Continue from the last main node
+        Ptr mainNodePtr = head_.pre;
+        MainNode_ mainNode;
+        SizeT written = 0; // the number of nodes in the array already in the file
+        KeyType maxKey{};
+        if (mainNodePtr != 0) {
+            ReadMainNode_(mainNodePtr, mainNode);
+            written = mainNode.count;
+            if (mainNode.count == 0) {
+                maxKey = mainNode.key;
+            } else {
+                Node_ tmpNode;
+                ReadNode_(mainNode.target + (mainNode.count - 1) * sizeof(Node_), tmpNode);
+                maxKey = tmpNode.key;
+            }
+        }
+
+        arrayBuffer_.clear();
+        for (; first != last; ++first) {
+            if (mainNodePtr != 0 && !(maxKey < first->key)) {
+                failed = true;
+                break;
+            }
+
+            if (mainNodePtr != 0 && mainNode.count < head_.nodeSize) {
+                // Put the node into the array of the current main node
+                arrayBuffer_.push_back(Node_{first->key, first->value});
+                ++(mainNode.count);
+            } else {
+                // Start a new main node right after the current one
+                Ptr newPtr = storage_.Allocate(BlockSize_());
+                if (mainNodePtr == 0) {
+                    head_.next = newPtr;
+                } else {
+                    mainNode.next = newPtr;
+                    PutBlock_(mainNodePtr, mainNode, written);
+                }
+                mainNode = MainNode_{first->key, first->value, newPtr + static_cast<Ptr>(sizeof(MainNode_)),
+                                     0, 0, mainNodePtr, 0};
+                mainNodePtr = newPtr;
+                written = 0;
+                index_.push_back(IndexEntry_{first->key, newPtr, NewFilter_()});
+            }
+            AddToFilter_(index_.back().filter, first->key);
+            maxKey = first->key;
+            ++loaded;
+        }
+
+        // Put the last main node and the header
+        if (mainNodePtr != 0) {
+            PutBlock_(mainNodePtr, mainNode, written);
+            head_.pre = mainNodePtr;
+            head_.maxKey = maxKey;
+        }
+        head_.size += loaded;
+        WriteHead_();
+        EndOperation_();
+
+        if (failed) {
+            throw lau::InvalidArgument("Invalid Argument: the keys are not increasing or not greater than "
+                                       "the keys in the list");
+        }
+        return loaded;
+    }
+
+    /**
+     * Apply the operations in a batch.  The operations are grouped by the
+     * main nodes they fall in, and each of these main nodes is rewritten
+     * only once (and split into as many main nodes as needed), instead of
+     * shifting its array for every operation.
+     * <br><br>
+     * The result is the same as calling <code>Insert</code>,
+     * <code>Erase</code> and <code>Modify</code> in the order of the
+     * operations.  The changed keys are removed from the cache.
+     * @param batch
+     * @return the number of successful operations
+     */
+    SizeT Apply(const WriteBatch& batch) {
+        auto lock = WriteLock_();
+        using Operation = typename WriteBatch::Operation_;
+        if (batch.operations_.empty()) return 0;
+
+        // Sort the operations by key, keeping the order of those with the
+        // same key
+        std::vector<Operation> operations(batch.operations_);
+        std::stable_sort(operations.begin(), operations.end(),
+                         [](const Operation& lhs, const Operation& rhs) { return lhs.key < rhs.key; });
+        for (const auto& operation : operations) cache_.Erase(operation.key);
+
+        SizeT done = 0;
+        std::vector<Node_> nodes, result;
+        if (index_.empty()) {
+            done = MergeOperations_(nodes, operations.data(), operations.data() + operations.size(), result);
+            if (!result.empty()) RewriteBlock_(-1, 0, result, false);
+            head_.size = static_cast<SizeT>(result.size());
+            maxStale_ = true;
+            EndOperation_();
+            return done;
+        }
+
+        // Group the operations by the main nodes they fall in
+        std::vector<std::pair<SizeT, SizeT>> groups; // the position in the index and the first operation
+        for (SizeT i = 0; i < static_cast<SizeT>(operations.size()); ++i) {
+            SizeT position = LocateIndex_(operations[i].key);
+            if (groups.empty() || groups.back().first != position) groups.emplace_back(position, i);
+        }
+
+        // Rewrite the main nodes from the last one, so that the positions
+        // in the index of the main nodes before are not changed
+        SizeT end = static_cast<SizeT>(operations.size());
+        MainNode_ mainNode;
+        for (SizeT i = static_cast<SizeT>(groups.size()) - 1; i >= 0; --i) {
+            auto [position, begin] = groups[i];
+            Ptr mainNodePtr = index_[position].ptr;
+            ReadMainNode_(mainNodePtr, mainNode);
+            nodes.clear();
+            nodes.push_back(Node_{mainNode.key, mainNode.value});
+            const Node_* array = ReadArray_(mainNode);
+            nodes.insert(nodes.end(), array, array + mainNode.count);
+
+            result.clear();
+            done += MergeOperations_(nodes, operations.data() + begin, operations.data() + end, result);
+            head_.size += static_cast<SizeT>(result.size()) - static_cast<SizeT>(nodes.size());
+            if (result.empty()) {
+                DeleteNode_(mainNode, mainNodePtr);
+            } else {
+                // The previous main node is still to be rewritten, so the
+                // last main node cannot be merged with it now
+                bool rebalance = mainNode.next != 0 || i == 0 || groups[i - 1].first != position - 1;
+                RewriteBlock_(position, mainNodePtr, result, rebalance);
+            }
+            end = begin;
+        }
+        maxStale_ = true;
+        EndOperation_();
+        return done;
+    }
+
     /**
      * Erase the corresponding key-value pair of the input key.
      * @param key
      * @return whether the operation is successful or not
      */
     bool Erase(const KeyType& key) {
+        auto lock = WriteLock_();
         // De-cache the node if it is really in cache
-        if (cached && cachedNode_.key == key) {
-            cached = false;
-        }
+        cache_.Erase(key);
 
         // Find the exact place of the node to be erased
-        auto [mainNodePtr, index] = FindExact_(key);
+        MainNode_ mainNode;
+        auto [mainNodePtr, index] = FindExact_(key, mainNode);
         if (mainNodePtr == -1) return false; // no such node
 
-        // Get the main node
-        MainNode_ mainNode;
         Node_ tmpNode;
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
 
         if (index == -1) { // the case that the target is in the main node
             if (mainNode.count == 0) { // the case that there is only one key-value pair
                 DeleteNode_(mainNode, mainNodePtr);
+                --(head_.size);
+                if (key == head_.maxKey) maxStale_ = true;
+                EndOperation_();
+                return true;
             } else { // the case that there is more than one key-value pair
                 // Set the main node
-                list_.seekg(mainNode.target);
-                list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+                ReadNode_(mainNode.target, tmpNode);
                 mainNode.key = tmpNode.key;
                 mainNode.value = tmpNode.value;
                 --(mainNode.count);
+                index_[LocateIndex_(key)].key = mainNode.key;
 
                 // Put the main Node
-                list_.seekp(mainNodePtr);
-                list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+                WriteMainNode_(mainNodePtr, mainNode);
 
                 // Move forward the other nodes
-                char* buffer = Read_(mainNode.target + sizeof(Node_), mainNode.count * sizeof(Node_));
-                Write_(buffer, mainNode.target, mainNode.count * sizeof(Node_));
-                delete[] buffer;
+                storage_.Move(mainNode.target + sizeof(Node_), mainNode.target,
+                              mainNode.count * sizeof(Node_));
             }
         } else { // the case that the target is not in the main node
             // Set and put the main node
             --(mainNode.count);
-            list_.seekp(mainNodePtr);
-            list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+            WriteMainNode_(mainNodePtr, mainNode);
 
             // Move forward the other nodes
-            char* buffer = Read_(mainNode.target + (index + 1) * sizeof(Node_),
-                                 (mainNode.count - index) * sizeof(Node_));
-            Write_(buffer, mainNode.target + index * sizeof(Node_),
-                   (mainNode.count - index) * sizeof(Node_));
-            delete[] buffer;
+            storage_.Move(mainNode.target + (index + 1) * sizeof(Node_), mainNode.target + index * sizeof(Node_),
+                          (mainNode.count - index) * sizeof(Node_));
         }
 
+        // Merge or balance the main node if it has too few nodes
+        if (mainNode.count + 1 < head_.nodeSize / 2) Rebalance_(mainNode, mainNodePtr);
+
+        --(head_.size);
+        if (key == head_.maxKey) maxStale_ = true;
+        EndOperation_();
         return true;
     }
 
@@ -252,31 +740,27 @@ public:
      * @return whether the operation is successful or not
      */
     bool Modify(const KeyType& key, const ValueType& value) {
-        // Change cache the node if it is really in cache
-        if (cached && cachedNode_.key == key) {
-            cachedNode_.value = value;
-        }
-
+        auto lock = WriteLock_();
         // Find the Node
-        auto [mainNodePtr, index] = FindExact_(key);
+        MainNode_ mainNode;
+        auto [mainNodePtr, index] = FindExact_(key, mainNode);
         if (mainNodePtr == -1) return false; // no such node
 
-        MainNode_ mainNode;
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+        // Change the node in cache
+        cache_.Put(key, value);
+
         if (index == -1) {
             mainNode.value = value;
-            list_.seekp(mainNodePtr);
-            list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+            WriteMainNode_(mainNodePtr, mainNode);
         } else {
             Node_ tmpNode;
-            list_.seekg(mainNode.target + index * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+            ReadNode_(mainNode.target + index * sizeof(Node_), tmpNode);
             tmpNode.value = value;
-            list_.seekp(mainNode.target + index * sizeof(Node_));
-            list_.write(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+            WriteNode_(mainNode.target + index * sizeof(Node_), tmpNode);
+            dirty_.push_back(mainNodePtr);
         }
 
+        EndOperation_();
         return true;
     }
 
@@ -284,50 +768,185 @@ public:
      * The function clears all the data in the unrolled linked list
      */
     FileUnrolledLinkedList& Clear() {
+        auto lock = WriteLock_();
         head_.nextGarbage = head_.next;
         head_.next = 0;
         head_.pre = 0;
-        list_.seekp(0);
-        list_.write(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
-        cached = false;
+        head_.size = 0;
+        head_.garbageCount = static_cast<SizeT>(index_.size());
+        index_.clear();
+        cache_.Clear();
+        WriteHead_();
+        EndOperation_();
         return *this;
     }
 
     /**
-     * Tell whether there exists a node with a certain key
-     * or not.
-     * @param key the key to search
-     * @return The boolean of whether there exists a node with a certain key
-     * or not
+     * Rewrite the list into a new file, whose name is the file name with
+     * a <code>.compact</code> suffix, and then replace the file with it.
+     * The pairs are packed into main nodes with <code>nodeSize</code>
+     * nodes in the array, which are placed in the order of their keys,
+     * and the deleted main nodes are dropped, so the file becomes smaller
+     * and traversing the list reads the file sequentially.
+     * <br><br>
+     * The file is replaced by renaming, so it is never partially
+     * rewritten.  The new file is made and opened by the function to open
+     * the storage, or with the default arguments of the storage if the
+     * list is constructed with only a file name.  If the file cannot be
+     * opened again after it is replaced, every later call of the list
+     * throws a <code>lau::RuntimeError</code>.
+     * @return reference of the current class
+     * @throw lau::RuntimeError if the list is not constructed with a file
+     * name, or the file cannot be replaced or opened again
      */
-    [[nodiscard]] bool Exist(const KeyType& key) const {
-        // Check if it is cached
-        if (cached && cachedNode_.key == key) {
-            return true;
+    FileUnrolledLinkedList& Compact() {
+        auto lock = WriteLock_();
+        if (fileName_.empty()) {
+            throw lau::RuntimeError("Runtime Error: the list is not constructed with a file name");
         }
+        Rewrite_([this](auto&& put) {
+            ForEachBlock_([&put](SizeT, const MainNode_& mainNode, const Node_* array) {
+                put(mainNode.key, mainNode.value, array, mainNode.count);
+            });
+        });
+        return *this;
+    }
 
-        auto [mainNodePtr, offset] = FindExact_(key);
-        if (mainNodePtr == -1) return false; // no such node
+    /**
+     * Do a bounded part of compaction in place, so that the list can be
+     * compacted without blocking other operations for a long time.
+     * <br><br>
+     * Each call continues from where the last call stopped, and visits at
+     * most <code>maxBlocks</code> main nodes in the order of their keys.
+     * A main node is merged with the main nodes after it as long as the
+     * merged array has no more than <code>nodeSize</code> nodes, and then
+     * it is swapped with another main node so that the main nodes are
+     * placed in the order of their keys.  The file does not become
+     * smaller (see <code>Compact</code>), but the deleted main nodes are
+     * reused by later insertions.
+     * @param maxBlocks the maximum number of main nodes to be visited
+     * (merging a main node counts as a visit)
+     * @return whether the whole list has been visited (the next call will
+     * start from the beginning again)
+     */
+    bool CompactStep(SizeT maxBlocks) {
+        auto lock = WriteLock_();
+        if (compactCursor_ >= static_cast<SizeT>(index_.size())) compactCursor_ = 0;
+
+        // The main nodes are placed in the order of their keys among the
+        // places of the main nodes, so find the places in order and the
+        // position in the index of the main node at each place
+        std::vector<Ptr> places;
+        std::unordered_map<Ptr, SizeT> positions;
+        places.reserve(index_.size());
+        positions.reserve(index_.size());
+        for (SizeT i = 0; i < static_cast<SizeT>(index_.size()); ++i) {
+            places.push_back(index_[i].ptr);
+            positions[index_[i].ptr] = i;
+        }
+        std::sort(places.begin(), places.end());
 
         MainNode_ mainNode;
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-        if (offset == -1) {
-            cachedNode_.key = mainNode.key;
-            cachedNode_.value = mainNode.value;
-            cached = true;
-            return true;
+        for (SizeT visited = 0; visited < maxBlocks && compactCursor_ < static_cast<SizeT>(index_.size());) {
+            Ptr mainNodePtr = index_[compactCursor_].ptr;
+            ReadMainNode_(mainNodePtr, mainNode);
+            ++visited;
+
+            // Merge the underfull neighbours, whose places are no longer
+            // used, and the main nodes after them move forward in the index
+            while (visited < maxBlocks && mainNode.next != 0) {
+                Ptr nextPtr = mainNode.next;
+                MainNode_ next;
+                ReadMainNode_(nextPtr, next);
+                if (mainNode.count + next.count + 1 > head_.nodeSize) break;
+                Merge_(mainNode, mainNodePtr);
+                places.erase(std::lower_bound(places.begin(), places.end(), nextPtr));
+                positions.erase(nextPtr);
+                for (SizeT i = compactCursor_ + 1; i < static_cast<SizeT>(index_.size()); ++i) {
+                    positions[index_[i].ptr] = i;
+                }
+                ++visited;
+            }
 
-        } else {
-            Node_ tmpNode;
-            list_.seekg(mainNode.target + offset * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
+            Ptr place = places[compactCursor_];
+            if (place != mainNodePtr) {
+                SizeT other = positions[place];
+                Swap_(compactCursor_, other);
+                positions[place] = compactCursor_;
+                positions[mainNodePtr] = other;
+            }
+            ++compactCursor_;
+        }
 
-            cachedNode_.key = tmpNode.key;
-            cachedNode_.value = tmpNode.key;
-            cached = true;
-            return true;
+        if (compactCursor_ < static_cast<SizeT>(index_.size())) {
+            EndOperation_();
+            return false;
         }
+        compactCursor_ = 0;
+        EndOperation_();
+        return true;
+    }
+
+    /**
+     * Check the whole list in several threads: the checksum of each main
+     * node and its array, the links between the main nodes, the order of
+     * the keys, and the statistics in the head.  It reads all the main
+     * nodes once, and can be called after opening the file to find a
+     * broken file before using it.
+     * @return whether the list is intact
+     */
+    [[nodiscard]] bool Verify() const {
+        auto lock = ReadLock_();
+        auto count = static_cast<SizeT>(index_.size());
+        if (head_.blockCount != count || (count == 0 && head_.size != 0)) return false;
+        SizeT threads = std::max<SizeT>(1, std::min<SizeT>(std::thread::hardware_concurrency(), count / 64));
+        std::atomic<bool> intact(true);
+        std::atomic<SizeT> size(0);
+        auto work = [this, count, threads, &intact, &size](SizeT first) {
+            for (SizeT i = first; i < count && intact.load(std::memory_order_relaxed); i += threads) {
+                if (!VerifyBlock_(i, size)) intact.store(false, std::memory_order_relaxed);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (SizeT i = 1; i < threads; ++i) workers.emplace_back(work, i);
+        work(0);
+        for (auto& worker : workers) worker.join();
+        return intact.load() && size.load() == head_.size;
+    }
+
+    /**
+     * Get the number of key-value pairs in the list, which is kept in the
+     * head of the file.
+     * @return the number of key-value pairs
+     */
+    [[nodiscard]] SizeT Size() const {
+        auto lock = ReadLock_();
+        return head_.size;
+    }
+
+    /**
+     * Get the statistics of the list, which are kept in the head of the
+     * file, so that no main nodes are read.
+     * @return the statistics
+     */
+    [[nodiscard]] Statistics Stats() const {
+        auto lock = ReadLock_();
+        double capacity = static_cast<double>(head_.blockCount) * static_cast<double>(head_.nodeSize + 1);
+        return Statistics{head_.size, head_.blockCount, head_.garbageCount, head_.minKey, head_.maxKey,
+                          head_.blockCount == 0 ? 0.0 : static_cast<double>(head_.size) / capacity};
+    }
+
+    /**
+     * Tell whether there exists a node with a certain key
+     * or not.
+     * @param key the key to search
+     * @return The boolean of whether there exists a node with a certain key
+     * or not
+     */
+    [[nodiscard]] bool Exist(const KeyType& key) const {
+        auto lock = ReadLock_();
+        ValueType value;
+        return Lookup_(key, value);
     }
 
     /**
@@ -340,33 +959,10 @@ public:
      * default constructor).
      */
     [[nodiscard]] ValueType Get(const KeyType& key) const {
-        // Check if it is cached
-        if (cached && cachedNode_.key == key) {
-            return cachedNode_.value;
-        }
-
-        auto [mainNodePtr, offset] = FindExact_(key);
-        if (mainNodePtr == -1) return ValueType(); // no such node
-
-        MainNode_ mainNode;
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-        if (offset == -1) {
-            cachedNode_.key = mainNode.key;
-            cachedNode_.value = mainNode.value;
-            cached = true;
-            return cachedNode_.value;
-
-        } else {
-            Node_ tmpNode;
-            list_.seekg(mainNode.target + offset * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-
-            cachedNode_.key = tmpNode.key;
-            cachedNode_.value = tmpNode.key;
-            cached = true;
-            return cachedNode_.value;
-        }
+        auto lock = ReadLock_();
+        ValueType value;
+        if (!Lookup_(key, value)) return ValueType(); // no such node
+        return value;
     }
 
     /**
@@ -381,31 +977,71 @@ public:
      * If the key doesn't exist, a nullptr will be returned instead.
      */
     [[nodiscard]] ValueType* GetWithPointer(const KeyType& key) const {
-        // Check if it is cached
-        if (cached && cachedNode_.key == key) {
-            return new ValueType(cachedNode_.value);
+        auto lock = ReadLock_();
+        ValueType value;
+        if (!Lookup_(key, value)) return nullptr; // no such node
+        return new ValueType(value);
+    }
+
+    /**
+     * Get the corresponding values of a batch of keys.  The keys are
+     * sorted and looked up in one forward pass over the main nodes, so
+     * the array of each main node is read at most once.  The cache is
+     * neither checked nor filled.
+     * @param keys the keys to search (not necessarily sorted or distinct)
+     * @return the values in the order of the keys.
+     * <br>
+     * If there is no such node, the value will be the default value
+     * (calling the default constructor).
+     */
+    [[nodiscard]] std::vector<ValueType> MultiGet(const std::vector<KeyType>& keys) const {
+        auto lock = ReadLock_();
+        std::vector<ValueType> values(keys.size());
+        if (index_.empty()) return values;
+
+        // Find the main nodes that may have the keys in order
+        std::vector<SizeT> order(keys.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&keys](SizeT lhs, SizeT rhs) { return keys[lhs] < keys[rhs]; });
+        std::vector<std::pair<SizeT, SizeT>> lookups; // the positions in the index with the keys
+        for (SizeT i : order) {
+            if (OutOfRange_(keys[i])) continue;
+            SizeT position = LocateIndex_(keys[i]);
+            if (MayContain_(index_[position].filter, keys[i])) lookups.emplace_back(position, i);
         }
 
-        auto [mainNodePtr, offset] = FindExact_(key);
-        if (mainNodePtr == -1) return nullptr; // no such node
+        // Read the main nodes with the reads in flight at the same time,
+        // at most kBlocksInFlight_ main nodes at a time
+        std::vector<Ptr> ptrs;
+        std::vector<char> buffer;
         MainNode_ mainNode;
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-        if (offset == -1) {
-            cachedNode_.key = mainNode.key;
-            cachedNode_.value = mainNode.value;
-            cached = true;
-            return new ValueType(mainNode.value);
-        } else {
-            Node_ tmpNode;
-            list_.seekg(mainNode.target + offset * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-
-            cachedNode_.key = tmpNode.key;
-            cachedNode_.value = tmpNode.key;
-            cached = true;
-            return new ValueType(tmpNode.value);
+        for (SizeT begin = 0, end = 0; begin < static_cast<SizeT>(lookups.size()); begin = end) {
+            ptrs.clear();
+            for (; end < static_cast<SizeT>(lookups.size()); ++end) {
+                if (end > begin && lookups[end].first == lookups[end - 1].first) continue;
+                if (static_cast<SizeT>(ptrs.size()) == kBlocksInFlight_) break;
+                ptrs.push_back(index_[lookups[end].first].ptr);
+            }
+            ReadBlocks_(ptrs.data(), static_cast<SizeT>(ptrs.size()), buffer);
+
+            SizeT block = -1;
+            const Node_* array = nullptr;
+            for (SizeT j = begin; j < end; ++j) {
+                if (j == begin || lookups[j].first != lookups[j - 1].first) {
+                    ++block;
+                    array = ParseBlock_(buffer.data() + block * BlockSize_(), ptrs[block], mainNode);
+                }
+                const KeyType& key = keys[lookups[j].second];
+                if (key < mainNode.key) continue; // less than all the keys
+                if (key == mainNode.key) {
+                    values[lookups[j].second] = mainNode.value;
+                    continue;
+                }
+                SizeT index = UpperBound_(array, mainNode.count, key) - 1;
+                if (index != -1 && array[index].key == key) values[lookups[j].second] = array[index].value;
+            }
         }
+        return values;
     }
 
     /**
@@ -414,22 +1050,27 @@ public:
      * <code>Node</code>s in the list
      */
     std::vector<Node> Traverse() const {
+        auto lock = ReadLock_();
         std::vector<Node> values; // can be optimized
-        MainNode_ mainNode;
-        Node node;
-        Ptr mainPtr = head_.next;
-        while (mainPtr != 0) {
-            list_.seekg(mainPtr);
-            list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+        ForEachBlock_([&values](SizeT, const MainNode_& mainNode, const Node_* array) {
             values.emplace_back(Node{mainNode.key, mainNode.value});
-            for (SizeT i = 0; i < mainNode.count; ++i) {
-                list_.seekg(mainNode.target + i * sizeof(Node_));
-                list_.read(reinterpret_cast<char*>(&node), sizeof(Node_));
-                values.emplace_back(node);
-            }
-            mainPtr = mainNode.next;
-        }
-        return std::move(values);
+            values.insert(values.end(), array, array + mainNode.count);
+        });
+        return values;
+    }
+
+    /**
+     * Get the nodes whose keys are in [lowKey, highKey] lazily, so that
+     * only the nodes of one main node are kept in memory at a time.
+     * <br><br>
+     * The range is invalid once the list is modified.
+     * @param lowKey
+     * @param highKey
+     * @return the range of the nodes, which can be used in a range-based
+     * for loop
+     */
+    ScanRange Scan(const KeyType& lowKey, const KeyType& highKey) const {
+        return ScanRange(ScanIterator(this, lowKey, highKey));
     }
 
     /**
@@ -437,7 +1078,8 @@ public:
      * @return reference of the current class
      */
     FileUnrolledLinkedList& Flush() {
-        list_.flush();
+        auto lock = WriteLock_();
+        storage_.Flush();
         return *this;
     }
 
@@ -446,32 +1088,177 @@ public:
      * @return the boolean of whether the list is empty
      */
     [[nodiscard]] bool Empty() const {
+        auto lock = ReadLock_();
         return (head_.next == 0);
     }
 
+    /**
+     * Get the cache of the key-value pairs, which tells the numbers of
+     * hits and misses.
+     * @return the cache
+     */
+    [[nodiscard]] const ClockCache<KeyType, ValueType>& Cache() const noexcept {
+        return cache_;
+    }
+
+    /**
+     * Change the number of key-value pairs cached in memory.
+     * @param cacheSize the number of pairs (0 to disable the cache)
+     * @return reference of the current class
+     */
+    FileUnrolledLinkedList& ResizeCache(SizeT cacheSize) {
+        auto lock = WriteLock_();
+        cache_.Resize(cacheSize);
+        return *this;
+    }
+
 private:
     typedef Node Node_;
 
+    constexpr static std::uint64_t kMagic_ = 0x4c415546554c5354ULL; // "LAUFULST"
+    constexpr static SizeT kVersion_ = 4;
+    constexpr static SizeT kBlocksInFlight_ = 64; // the number of main nodes read at once
+
     /**
-     * @struct FirstNode_{next, pre, nextGarbage, nodeSize, maxNodeSize}
+     * @struct FirstNode_{magic, version, keySize, valueSize, next, pre,
+     * nextGarbage, nodeSize, maxNodeSize, blockSize, size, blockCount,
+     * garbageCount, minKey, maxKey, modifications, checksum}
      *
-     * This is the node to pointer to the data, and metadata of the list
+     * This is the node to pointer to the data, and metadata of the list.
+     * The block size is the size of a main node with its array, which is
+     * padded to a multiple of the alignment of the storage.  The
+     * statistics are updated at the end of each operation, and the keys
+     * are the default ones if the list is empty.  The number of
+     * modifications tells whether the Bloom filters saved with a head are
+     * still valid.  The checksum is the CRC-32C of the members before it.
      */
     struct FirstNode_ {
-        Ptr   next; // the first main node
-        Ptr   pre; // the last main node
-        Ptr   nextGarbage; // the first garbage node
-        SizeT nodeSize;
-        SizeT maxNodeSize;
+        std::uint64_t magic;
+        SizeT         version;
+        SizeT         keySize;
+        SizeT         valueSize;
+        Ptr           next; // the first main node
+        Ptr           pre; // the last main node
+        Ptr           nextGarbage; // the first garbage node
+        SizeT         nodeSize;
+        SizeT         maxNodeSize;
+        SizeT         blockSize; // the size of a main node with its array
+        SizeT         size; // the number of key-value pairs
+        SizeT         blockCount; // the number of main nodes
+        SizeT         garbageCount; // the number of garbage nodes
+        KeyType       minKey;
+        KeyType       maxKey;
+        std::uint64_t modifications; // the number of operations that modified the list
+        std::uint64_t checksum;
+    };
+
+    /**
+     * @struct FirstNodeV1_{magic, version, keySize, valueSize, next, pre,
+     * nextGarbage, nodeSize, maxNodeSize, checksum}
+     *
+     * The head of the files of version 1, which has no statistics.
+     */
+    struct FirstNodeV1_ {
+        std::uint64_t magic;
+        SizeT         version;
+        SizeT         keySize;
+        SizeT         valueSize;
+        Ptr           next;
+        Ptr           pre;
+        Ptr           nextGarbage;
+        SizeT         nodeSize;
+        SizeT         maxNodeSize;
+        std::uint64_t checksum;
+    };
+
+    /**
+     * @struct FirstNodeV2_{magic, version, keySize, valueSize, next, pre,
+     * nextGarbage, nodeSize, maxNodeSize, size, blockCount, garbageCount,
+     * minKey, maxKey, checksum}
+     *
+     * The head of the files of version 2, which has no block size.
+     */
+    struct FirstNodeV2_ {
+        std::uint64_t magic;
+        SizeT         version;
+        SizeT         keySize;
+        SizeT         valueSize;
+        Ptr           next;
+        Ptr           pre;
+        Ptr           nextGarbage;
+        SizeT         nodeSize;
+        SizeT         maxNodeSize;
+        SizeT         size;
+        SizeT         blockCount;
+        SizeT         garbageCount;
+        KeyType       minKey;
+        KeyType       maxKey;
+        std::uint64_t checksum;
     };
 
     /**
-     * @struct MainNode_{key, value, target, count, next, pre}
+     * @struct FirstNodeV3_{magic, version, keySize, valueSize, next, pre,
+     * nextGarbage, nodeSize, maxNodeSize, blockSize, size, blockCount,
+     * garbageCount, minKey, maxKey, checksum}
+     *
+     * The head of the files of version 3, which has no number of
+     * modifications.
+     */
+    struct FirstNodeV3_ {
+        std::uint64_t magic;
+        SizeT         version;
+        SizeT         keySize;
+        SizeT         valueSize;
+        Ptr           next;
+        Ptr           pre;
+        Ptr           nextGarbage;
+        SizeT         nodeSize;
+        SizeT         maxNodeSize;
+        SizeT         blockSize;
+        SizeT         size;
+        SizeT         blockCount;
+        SizeT         garbageCount;
+        KeyType       minKey;
+        KeyType       maxKey;
+        std::uint64_t checksum;
+    };
+
+    /**
+     * @struct MainNode_{key, value, target, count, next, pre, checksum}
      *
      * This is the node to store the pointer and data, and
-     * link other main nodes.
+     * link other main nodes.  The checksum is the CRC-32C of the main node
+     * (except the checksum) and the nodes in its array.
      */
     struct MainNode_ {
+        KeyType       key;
+        ValueType     value;
+        Ptr           target;
+        SizeT         count;
+        Ptr           next;
+        Ptr           pre;
+        std::uint64_t checksum;
+    };
+
+    /**
+     * @struct LegacyFirstNode_{next, pre, nextGarbage, nodeSize, maxNodeSize}
+     *
+     * The head of the files made before the head had a version.
+     */
+    struct LegacyFirstNode_ {
+        Ptr   next;
+        Ptr   pre;
+        Ptr   nextGarbage;
+        SizeT nodeSize;
+        SizeT maxNodeSize;
+    };
+
+    /**
+     * @struct LegacyMainNode_{key, value, target, count, next, pre}
+     *
+     * The main nodes of the files made before the head had a version.
+     */
+    struct LegacyMainNode_ {
         KeyType   key;
         ValueType value;
         Ptr       target;
@@ -480,6 +1267,63 @@ private:
         Ptr       pre;
     };
 
+    /**
+     * @struct IndexEntry_{key, ptr, filter}
+     *
+     * This is the entry of the in-memory index of main nodes, storing the
+     * key of the main node, its place in the file and the Bloom filter of
+     * the keys in it.  The filter may also have the bits of the keys that
+     * were erased, and it has <code>filterWords_</code> words (none if
+     * there are no Bloom filters).
+     */
+    struct IndexEntry_ {
+        KeyType                    key;
+        Ptr                        ptr;
+        std::vector<std::uint64_t> filter;
+    };
+
+    /**
+     * Construct the list with a storage, the name of its file and the
+     * function to open it (empty if they are unknown).
+     */
+    FileUnrolledLinkedList(Storage&& storage, SizeT nodeSize, SizeT cacheSize, SizeT filterBits,
+                           std::string fileName, std::function<Storage(const std::string&)> openStorage)
+        : storage_(std::move(storage)), head_(NewHead_(nodeSize, 2 * nodeSize, storage_.Alignment())),
+          cache_(cacheSize), fileName_(std::move(fileName)), openStorage_(std::move(openStorage)),
+          filterBits_(filterBits) {
+        if (filterBits_ < 0) throw lau::InvalidArgument("Invalid Argument: the number of bits is negative");
+        if (filterBits_ > 0 && !std::has_unique_object_representations_v<KeyType>) {
+            throw lau::InvalidArgument("Invalid Argument: the keys may have padding bits");
+        }
+        filterWords_ = FilterWords_(head_.maxNodeSize);
+        if (storage_.Empty()) {
+            storage_.Allocate(HeadSize_(storage_.Alignment()));
+            WriteHead_();
+            EndOperation_();
+        } else {
+            std::uint64_t magic[2] = {0, 0}; // the magic number and the version
+            storage_.Read(reinterpret_cast<char*>(magic), 0, sizeof(magic));
+            if (magic[0] != kMagic_) {
+                Upgrade_();
+            } else if (magic[1] == 1) {
+                UpgradeVersioned_<FirstNodeV1_>();
+            } else if (magic[1] == 2) {
+                UpgradeVersioned_<FirstNodeV2_>();
+            } else if (magic[1] == 3) {
+                UpgradeVersioned_<FirstNodeV3_>();
+            } else {
+                ReadHead_();
+                BuildIndex_();
+            }
+            if (filterBits_ > 0 && !LoadFilters_()) BuildFilters_();
+        }
+
+        // The filters saved are no longer valid once the list is modified,
+        // even if the list is constructed with a storage and never saves
+        // them
+        std::remove((storage_.FileName() + ".bloom").c_str());
+    }
+
     /**
      * This function return a pair of the pointer to the main node
      * and the index number of node the target is right after.  For the case
@@ -491,46 +1335,19 @@ private:
      * @return a pair of the pointer to the main node and the offset (0-based)
      */
     std::pair<Ptr, SizeT> Find_(const KeyType& key) const {
-        if (head_.next == 0) return std::make_pair(0, -1);
-        MainNode_ tmp;
-        Ptr Ptr = head_.pre;
-        list_.seekg(head_.pre);
-        list_.read(reinterpret_cast<char*>(&tmp), sizeof(MainNode_));
+        if (index_.empty()) return std::make_pair(0, -1);
 
         // Searching for the approximate place (only the main node)
-        while (key < tmp.key && tmp.pre != 0) {
-            Ptr = tmp.pre;
-            list_.seekg(Ptr);
-            list_.read(reinterpret_cast<char*>(&tmp), sizeof(MainNode_));
-        }
+        Ptr ptr = index_[LocateIndex_(key)].ptr;
+        MainNode_ tmp;
+        ReadMainNode_(ptr, tmp);
 
         // Searching for the exact place
 
-        if (tmp.pre == 0 && key < tmp.key) return std::make_pair(Ptr, -1);
-
-        if (key == tmp.key || tmp.count == 0) return std::make_pair(Ptr, -1);
-
-        Node_ tmpNode;
-        SizeT leftIndex = 0, rightIndex = tmp.count - 1;
-
-        // the case that the key is between the main node and the first node
-        list_.seekg(tmp.target);
-        list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-        if (key < tmpNode.key) return std::make_pair(Ptr, -1);
-
-        // the case that the key is right after the last node
-        list_.seekg(tmp.target + (tmp.count - 1) * sizeof(Node_));
-        list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-        if (tmpNode.key < key || tmpNode.key == key) return std::make_pair(Ptr, tmp.count - 1);
-
-        while (rightIndex - leftIndex > 1) {
-            list_.seekg(tmp.target + ((rightIndex + leftIndex) / 2) * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-            if (key < tmpNode.key) rightIndex = (rightIndex + leftIndex) / 2;
-            else leftIndex = (rightIndex + leftIndex) / 2;
-        }
+        if (key < tmp.key || key == tmp.key || tmp.count == 0) return std::make_pair(ptr, -1);
 
-        return std::make_pair(Ptr, leftIndex);
+        const Node_* array = ReadCheckedArray_(tmp);
+        return std::make_pair(ptr, UpperBound_(array, tmp.count, key) - 1);
     }
 
     /**
@@ -540,57 +1357,398 @@ private:
      * key doesn't belongs to the unrolled linked list, it will return
      * {-1, -1}.
      * @param key
+     * @param mainNode the place to put the main node read, so that the
+     *                 caller need not read it again
+     * @param value the place to put the value found (if not nullptr)
      * @return a pair of the pointer to the main node and the offset
      */
-    std::pair<Ptr, SizeT> FindExact_(const KeyType& key) const {
-        if (head_.next == 0) return std::make_pair(-1, -1);
+    std::pair<Ptr, SizeT> FindExact_(const KeyType& key, MainNode_& mainNode,
+                                     ValueType* value = nullptr) const {
+        if (OutOfRange_(key)) return std::make_pair(-1, -1);
 
-        MainNode_ tmp;
-        Ptr ptr = head_.pre;
-        list_.seekg(head_.pre);
-        list_.read(reinterpret_cast<char*>(&tmp), sizeof(MainNode_));
+        // Searching for the approximate place (only the main node), which
+        // is not read if the Bloom filter tells the key is not there
+        const IndexEntry_& entry = index_[LocateIndex_(key)];
+        if (!MayContain_(entry.filter, key)) return std::make_pair(-1, -1);
+        Ptr ptr = entry.ptr;
+        ReadMainNode_(ptr, mainNode);
 
-        // Searching for the approximate place (only the main node)
-        while (key < tmp.key && tmp.pre != 0) {
-            ptr = tmp.pre;
-            list_.seekg(ptr);
-            list_.read(reinterpret_cast<char*>(&tmp), sizeof(MainNode_));
+        // Searching for the exact place
+
+        if (key < mainNode.key) return std::make_pair(-1, -1);
+
+        if (key == mainNode.key) {
+            if (value != nullptr) *value = mainNode.value;
+            return std::make_pair(ptr, -1);
         }
 
-        // Searching for the exact place
+        if (mainNode.count == 0) return std::make_pair(-1, -1);
+
+        const Node_* array = ReadCheckedArray_(mainNode);
+        SizeT index = UpperBound_(array, mainNode.count, key) - 1;
+        if (index == -1 || !(array[index].key == key)) return std::make_pair(-1, -1);
+        if (value != nullptr) *value = array[index].value;
+        return std::make_pair(ptr, index);
+    }
+
+    /**
+     * Look up the value of the key in the cache first, and then in the
+     * file.  The pair found in the file will be cached.
+     * @param key
+     * @param value the place to put the value
+     * @return whether there exists such a node
+     */
+    bool Lookup_(const KeyType& key, ValueType& value) const {
+        {
+            std::shared_lock<std::shared_mutex> lock(latches_->cache);
+            const ValueType* cachedValue = cache_.Get(key);
+            if (cachedValue != nullptr) {
+                value = *cachedValue;
+                return true;
+            }
+        }
+
+        MainNode_ mainNode;
+        if (FindExact_(key, mainNode, &value).first == -1) return false; // no such node
 
-        if (tmp.pre == 0 && key < tmp.key) return std::make_pair(-1, -1);
+        std::unique_lock<std::shared_mutex> lock(latches_->cache);
+        cache_.Put(key, value);
+        return true;
+    }
 
-        if (key == tmp.key) return std::make_pair(ptr, -1);
+    /**
+     * Get the position in the index of the main node whose range may
+     * contain the key, i.e. the last main node whose key is not greater
+     * than the key.  If the key is less than all the keys, 0 will be
+     * returned.  The index MUST NOT be empty.
+     * @param key
+     * @return the position in the index
+     */
+    SizeT LocateIndex_(const KeyType& key) const {
+        auto iter = std::upper_bound(index_.begin(), index_.end(), key,
+                                     [](const KeyType& lhs, const IndexEntry_& rhs) { return lhs < rhs.key; });
+        return iter == index_.begin() ? 0 : iter - index_.begin() - 1;
+    }
 
-        if (tmp.count == 0) return std::make_pair(-1, -1);
+    /**
+     * Get the number of nodes in the array whose key is not greater than
+     * the key.
+     * @param array
+     * @param count the number of nodes in the array
+     * @param key
+     * @return the index of the first node whose key is greater than the key
+     */
+    static SizeT UpperBound_(const Node_* array, SizeT count, const KeyType& key) {
+        return std::upper_bound(array, array + count, key,
+                                [](const KeyType& lhs, const Node_& rhs) { return lhs < rhs.key; }) - array;
+    }
 
-        Node_ tmpNode;
-        SizeT leftIndex = 0, rightIndex = tmp.count - 1;
+    /**
+     * Read the whole array of a main node with one read.  The array is
+     * valid until the next call of this function in the same thread.
+     * @param mainNode
+     * @return the pointer to the array
+     */
+    const Node_* ReadArray_(const MainNode_& mainNode) const {
+        static thread_local std::vector<Node_> buffer; // one for each thread to read in parallel
+        if (static_cast<SizeT>(buffer.size()) < mainNode.count) buffer.resize(mainNode.count);
+        storage_.Read(reinterpret_cast<char*>(buffer.data()), mainNode.target, mainNode.count * sizeof(Node_));
+        return buffer.data();
+    }
+
+    /**
+     * Read several whole blocks (main nodes with their arrays) at once
+     * with <code>ReadBatch</code> of the storage, so that the reads are in
+     * flight at the same time.
+     * @param ptrs the places of the main nodes
+     * @param count the number of main nodes
+     * @param buffer the place to put the blocks one after another
+     */
+    void ReadBlocks_(const Ptr* ptrs, SizeT count, std::vector<char>& buffer) const {
+        SizeT blockSize = BlockSize_();
+        buffer.resize(count * blockSize);
+        std::vector<ReadRequest> requests(count);
+        for (SizeT i = 0; i < count; ++i) requests[i] = ReadRequest{buffer.data() + i * blockSize, ptrs[i], blockSize};
+        storage_.ReadBatch(requests.data(), count);
+    }
 
-        // the case that the key is between the main node and the first node
-        list_.seekg(tmp.target);
-        list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-        if (key < tmpNode.key) return std::make_pair(-1, -1);
+    /**
+     * Get the main node and the array of a block read by
+     * <code>ReadBlocks_</code>, and check them.
+     * @param block
+     * @param ptr the place of the main node
+     * @param mainNode the place to put the main node
+     * @return the pointer to the array in the block
+     * @throw lau::RuntimeError if the block is broken
+     */
+    const Node_* ParseBlock_(const char* block, Ptr ptr, MainNode_& mainNode) const {
+        std::memcpy(&mainNode, block, sizeof(MainNode_));
+        if (!ValidMainNode_(ptr, mainNode)) throw lau::RuntimeError("Runtime Error: the main nodes are broken");
+        const auto* array = reinterpret_cast<const Node_*>(block + sizeof(MainNode_));
+        CheckBlock_(mainNode, array);
+        return array;
+    }
+
+    /**
+     * Visit the main nodes in the order of the keys with their arrays,
+     * which are read <code>kBlocksInFlight_</code> main nodes at a time.
+     * @tparam Visit
+     * @param visit the function to call with the position in the index,
+     * the main node and its array
+     */
+    template <class Visit>
+    void ForEachBlock_(Visit visit) const {
+        auto size = static_cast<SizeT>(index_.size());
+        std::vector<Ptr> ptrs;
+        std::vector<char> buffer;
+        MainNode_ mainNode;
+        for (SizeT first = 0; first < size; first += kBlocksInFlight_) {
+            SizeT count = std::min(kBlocksInFlight_, size - first);
+            ptrs.resize(count);
+            for (SizeT i = 0; i < count; ++i) ptrs[i] = index_[first + i].ptr;
+            ReadBlocks_(ptrs.data(), count, buffer);
+            for (SizeT i = 0; i < count; ++i) {
+                const Node_* array = ParseBlock_(buffer.data() + i * BlockSize_(), ptrs[i], mainNode);
+                visit(first + i, mainNode, array);
+            }
+        }
+    }
 
-        // the case that the key is right after the last node
-        list_.seekg(tmp.target + (tmp.count - 1) * sizeof(Node_));
-        list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-        if (tmpNode.key < key) return std::make_pair(-1, -1);
+    /**
+     * Build the index of main nodes by walking through the main nodes
+     * once.  The links and the keys of the main nodes are checked on the
+     * way, so that a broken link cannot lead the walk out of the file or
+     * into a loop.
+     * @throw lau::RuntimeError if the main nodes are broken
+     */
+    void BuildIndex_() {
+        index_.clear();
+        filterWords_ = FilterWords_(head_.maxNodeSize);
+        Ptr end = storage_.Allocate(0); // the end of the file
+        MainNode_ mainNode;
+        Ptr prePtr = 0;
+        for (Ptr ptr = head_.next; ptr != 0; ptr = mainNode.next) {
+            if (ptr < static_cast<Ptr>(sizeof(FirstNode_)) || ptr + BlockSize_() > end) {
+                throw lau::RuntimeError("Runtime Error: a link of the main nodes is out of the file");
+            }
+            ReadMainNode_(ptr, mainNode);
+            if (!ValidMainNode_(ptr, mainNode) || mainNode.pre != prePtr
+                || (!index_.empty() && !(index_.back().key < mainNode.key))) {
+                throw lau::RuntimeError("Runtime Error: the main nodes are broken");
+            }
+            index_.push_back(IndexEntry_{mainNode.key, ptr, NewFilter_()});
+            prePtr = ptr;
+        }
+        if (head_.pre != prePtr) throw lau::RuntimeError("Runtime Error: the main nodes are broken");
+        if (head_.blockCount != static_cast<SizeT>(index_.size())
+            || (!index_.empty() && !(head_.minKey == index_.front().key))) {
+            throw lau::RuntimeError("Runtime Error: the statistics in the head do not match the main nodes");
+        }
+    }
 
-        if (tmpNode.key == key) return std::make_pair(ptr, tmp.count - 1);
+    /**
+     * Tell whether the fields of a main node are possible, so that its
+     * array can be read safely.
+     * @param ptr the place of the main node
+     * @param mainNode
+     * @return whether the main node is possible
+     */
+    [[nodiscard]] bool ValidMainNode_(Ptr ptr, const MainNode_& mainNode) const {
+        return mainNode.target == ptr + static_cast<Ptr>(sizeof(MainNode_)) && mainNode.count >= 0
+               && mainNode.count <= head_.maxNodeSize;
+    }
 
-        while (rightIndex - leftIndex > 1) {
-            list_.seekg(tmp.target + ((rightIndex + leftIndex) / 2) * sizeof(Node_));
-            list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-            if (key < tmpNode.key) rightIndex = (rightIndex + leftIndex) / 2;
-            else leftIndex = (rightIndex + leftIndex) / 2;
+    /**
+     * Check a main node in the index with its array, its links and the
+     * order of its keys.  It is used by <code>Verify</code>.
+     * @param position the position in the index
+     * @param size the number of key-value pairs to add the pairs of the
+     * main node to
+     * @return whether the main node is intact
+     */
+    bool VerifyBlock_(SizeT position, std::atomic<SizeT>& size) const {
+        Ptr ptr = index_[position].ptr;
+        MainNode_ mainNode;
+        ReadMainNode_(ptr, mainNode);
+        SizeT last = static_cast<SizeT>(index_.size()) - 1;
+        if (!ValidMainNode_(ptr, mainNode) || !(mainNode.key == index_[position].key)
+            || mainNode.pre != (position == 0 ? 0 : index_[position - 1].ptr)
+            || mainNode.next != (position == last ? 0 : index_[position + 1].ptr)) {
+            return false;
         }
+        const Node_* array = ReadArray_(mainNode);
+        if (BlockChecksum_(mainNode, array) != mainNode.checksum) return false;
+        const KeyType* key = &mainNode.key;
+        for (SizeT i = 0; i < mainNode.count; key = &array[i].key, ++i) {
+            if (!(*key < array[i].key)) return false;
+        }
+        size.fetch_add(mainNode.count + 1, std::memory_order_relaxed);
+        return position == last ? *key == head_.maxKey : *key < index_[position + 1].key;
+    }
+
+    /**
+     * Build the Bloom filters of all the main nodes by reading the whole
+     * list.
+     */
+    void BuildFilters_() {
+        ForEachBlock_([this](SizeT position, const MainNode_& mainNode, const Node_* array) {
+            auto& filter = index_[position].filter;
+            AddToFilter_(filter, mainNode.key);
+            for (SizeT i = 0; i < mainNode.count; ++i) AddToFilter_(filter, array[i].key);
+        });
+    }
 
-        list_.seekg(tmp.target + leftIndex * sizeof(Node_));
-        list_.read(reinterpret_cast<char*>(&tmpNode), sizeof(Node_));
-        if (tmpNode.key == key) return std::make_pair(ptr, leftIndex);
-        else return std::make_pair(-1, -1);
+    /**
+     * Get the number of 64-bit words of a Bloom filter, which has
+     * <code>filterBits_</code> bits for each node that a main node can
+     * have.
+     * @param maxNodeSize the largest number of nodes in an array in the
+     * head the filter is for
+     * @return the number of words
+     */
+    [[nodiscard]] SizeT FilterWords_(SizeT maxNodeSize) const {
+        return (filterBits_ * (maxNodeSize + 1) + 63) / 64;
+    }
+
+    /**
+     * Get an empty Bloom filter for the index, or an empty vector if there
+     * are no Bloom filters.
+     * @return the filter
+     */
+    [[nodiscard]] std::vector<std::uint64_t> NewFilter_() const {
+        return std::vector<std::uint64_t>(filterWords_, 0);
+    }
+
+    /**
+     * Get the Bloom filter of the keys of some nodes.
+     * @param first
+     * @param last
+     * @param words the number of words of the filter
+     * @return the filter
+     */
+    [[nodiscard]] std::vector<std::uint64_t> MakeFilter_(const Node_* first, const Node_* last,
+                                                         SizeT words) const {
+        std::vector<std::uint64_t> filter(words, 0);
+        for (; first != last; ++first) AddToFilter_(filter, first->key);
+        return filter;
+    }
+
+    /**
+     * Tell whether every Bloom filter in the index has
+     * <code>filterWords_</code> words, which is checked before the
+     * filters are saved, loaded or merged.
+     * @return whether the filters match the index
+     */
+    [[nodiscard]] bool FiltersMatch_() const {
+        return std::all_of(index_.begin(), index_.end(), [this](const IndexEntry_& entry) {
+            return static_cast<SizeT>(entry.filter.size()) == filterWords_;
+        });
+    }
+
+    /**
+     * Hash the bytes of a key (FNV-1a, and then the finalizer of
+     * MurmurHash3 to mix the bits).
+     * @param key
+     * @return the hash value
+     */
+    static std::uint64_t HashKey_(const KeyType& key) {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(&key);
+        std::uint64_t hash = 14695981039346656037ULL;
+        for (std::size_t i = 0; i < sizeof(KeyType); ++i) hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    /**
+     * Get the number of bits set for each key in the Bloom filters, which
+     * is about ln 2 times the bits for each node.
+     * @return the number of bits
+     */
+    [[nodiscard]] SizeT FilterHashes_() const {
+        return std::max<SizeT>(1, std::min<SizeT>(16, filterBits_ * 69 / 100));
+    }
+
+    void AddToFilter_(std::vector<std::uint64_t>& filter, const KeyType& key) const {
+        if (filter.empty()) return;
+        std::uint64_t hash = HashKey_(key), bits = static_cast<std::uint64_t>(filter.size()) * 64;
+        std::uint64_t delta = (hash >> 32) | 1; // double hashing
+        for (SizeT i = 0; i < FilterHashes_(); ++i, hash += delta) {
+            filter[(hash % bits) / 64] |= std::uint64_t(1) << (hash % 64);
+        }
+    }
+
+    /**
+     * Tell whether a key may be in a main node by its Bloom filter.
+     * @param filter the Bloom filter of the main node, whose bits are
+     * counted from its length (which is checked with the index by
+     * <code>FiltersMatch_</code>)
+     * @param key
+     * @return false if the key is surely not in the main node, and true
+     * otherwise (or if there are no Bloom filters)
+     */
+    bool MayContain_(const std::vector<std::uint64_t>& filter, const KeyType& key) const {
+        if (filter.empty()) return true;
+        std::uint64_t hash = HashKey_(key), bits = static_cast<std::uint64_t>(filter.size()) * 64;
+        std::uint64_t delta = (hash >> 32) | 1;
+        for (SizeT i = 0; i < FilterHashes_(); ++i, hash += delta) {
+            if ((filter[(hash % bits) / 64] & (std::uint64_t(1) << (hash % 64))) == 0) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Load the Bloom filters from the file with the <code>.bloom</code>
+     * suffix, which is used only if it is saved with the same head (and
+     * thus the same number of modifications), the same main nodes and the
+     * same number of bits.
+     * @return whether the filters are loaded
+     */
+    bool LoadFilters_() {
+        if (fileName_.empty()) return false;
+        std::ifstream file(fileName_ + ".bloom", std::ios::in | std::ios::binary);
+        if (!file) return false;
+        FirstNode_ head;
+        SizeT filterBits = 0, count = 0;
+        file.read(reinterpret_cast<char*>(&head), sizeof(FirstNode_));
+        file.read(reinterpret_cast<char*>(&filterBits), sizeof(SizeT));
+        file.read(reinterpret_cast<char*>(&count), sizeof(SizeT));
+        if (!file || head.modifications != head_.modifications || head.checksum != head_.checksum
+            || filterBits != filterBits_ || count != static_cast<SizeT>(index_.size()) || !FiltersMatch_()) {
+            return false;
+        }
+        for (auto& entry : index_) {
+            Ptr ptr = 0;
+            file.read(reinterpret_cast<char*>(&ptr), sizeof(Ptr));
+            file.read(reinterpret_cast<char*>(entry.filter.data()), filterWords_ * sizeof(std::uint64_t));
+            if (!file || ptr != entry.ptr) {
+                for (auto& other : index_) other.filter.assign(other.filter.size(), 0);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Save the Bloom filters into the file with the <code>.bloom</code>
+     * suffix with the head of the list, so that they can be checked when
+     * they are loaded.  Nothing is saved if the filters do not match the
+     * index.
+     */
+    void SaveFilters_() const {
+        if (fileName_.empty() || filterBits_ == 0 || !FiltersMatch_()) return;
+        std::ofstream file(fileName_ + ".bloom", std::ios::out | std::ios::binary | std::ios::trunc);
+        SizeT count = static_cast<SizeT>(index_.size());
+        file.write(reinterpret_cast<const char*>(&head_), sizeof(FirstNode_));
+        file.write(reinterpret_cast<const char*>(&filterBits_), sizeof(SizeT));
+        file.write(reinterpret_cast<const char*>(&count), sizeof(SizeT));
+        for (const auto& entry : index_) {
+            file.write(reinterpret_cast<const char*>(&entry.ptr), sizeof(Ptr));
+            file.write(reinterpret_cast<const char*>(entry.filter.data()), filterWords_ * sizeof(std::uint64_t));
+        }
     }
 
     /**
@@ -600,66 +1758,58 @@ private:
      */
     void DeleteNode_(MainNode_& mainNode, Ptr target) {
         MainNode_ pre, next;
+        Ptr prePtr = mainNode.pre, nextPtr = mainNode.next;
+
+        // Remove the node from the index
+        index_.erase(index_.begin() + Position_(mainNode.key, target));
 
         // Change the node to be deleted
         mainNode.pre = 0;
         mainNode.next = head_.nextGarbage;
         mainNode.count = 0;
-        list_.seekp(target);
-        list_.write(reinterpret_cast<const char*>(&mainNode), sizeof(MainNode_));
+        WriteMainNode_(target, mainNode);
 
         // Change the first node
         head_.nextGarbage = target;
+        ++(head_.garbageCount);
 
         // The case that the only main node is to be deleted
-        if (mainNode.pre == 0 && mainNode.next == 0) {
+        if (prePtr == 0 && nextPtr == 0) {
             // Change the first node
             head_.pre = 0;
             head_.next = 0;
-            list_.seekp(0);
-            list_.write(reinterpret_cast<const char*>(&head_), sizeof(FirstNode_));
+            WriteHead_();
             return;
         }
 
         // The case that the main node is the first main Node
-        if (mainNode.pre == 0) {
-            head_.next = mainNode.next;
-            list_.seekg(mainNode.next);
-            list_.read(reinterpret_cast<char*>(&next), sizeof(MainNode_));
+        if (prePtr == 0) {
+            head_.next = nextPtr;
+            ReadMainNode_(nextPtr, next);
             next.pre = 0;
-            list_.seekp(mainNode.next);
-            list_.write(reinterpret_cast<const char*>(&next), sizeof(MainNode_));
-            list_.seekp(0);
-            list_.write(reinterpret_cast<const char*>(&head_), sizeof(FirstNode_));
+            WriteMainNode_(nextPtr, next);
+            WriteHead_();
             return;
         }
 
         // The case that the main node is the last main node
-        if (mainNode.next == 0) {
-            head_.pre = mainNode.pre;
-            list_.seekp(mainNode.pre);
-            list_.read(reinterpret_cast<char*>(&pre), sizeof(MainNode_));
+        if (nextPtr == 0) {
+            head_.pre = prePtr;
+            ReadMainNode_(prePtr, pre);
             pre.next = 0;
-            list_.seekp(mainNode.pre);
-            list_.write(reinterpret_cast<const char*>(&pre), sizeof(MainNode_));
-            list_.seekp(0);
-            list_.write(reinterpret_cast<const char*>(&head_), sizeof(FirstNode_));
+            WriteMainNode_(prePtr, pre);
+            WriteHead_();
             return;
         }
 
         // The regular case
-        list_.seekg(mainNode.pre);
-        list_.read(reinterpret_cast<char*>(&pre), sizeof(MainNode_));
-        list_.seekg(mainNode.next);
-        list_.read(reinterpret_cast<char*>(&next), sizeof(MainNode_));
-        pre.next = mainNode.next;
-        next.pre = mainNode.pre;
-        list_.seekp(mainNode.pre);
-        list_.write(reinterpret_cast<const char*>(&pre), sizeof(MainNode_));
-        list_.seekp(mainNode.next);
-        list_.write(reinterpret_cast<const char*>(&next), sizeof(MainNode_));
-        list_.seekp(0);
-        list_.write(reinterpret_cast<const char*>(&head_), sizeof(FirstNode_));
+        ReadMainNode_(prePtr, pre);
+        ReadMainNode_(nextPtr, next);
+        pre.next = nextPtr;
+        next.pre = prePtr;
+        WriteMainNode_(prePtr, pre);
+        WriteMainNode_(nextPtr, next);
+        WriteHead_();
     }
 
     /**
@@ -675,124 +1825,131 @@ private:
     Ptr NewNode_(MainNode_& mainNode, Ptr target) {
         if (target != 0) { // for a not empty list
             MainNode_ pre, next;
-            list_.seekg(target);
-            list_.read(reinterpret_cast<char*>(&pre), sizeof(MainNode_));
+            ReadMainNode_(target, pre);
             if (pre.next != 0) { // the case that the next main node is not the first node
                 // Get the next
-                list_.seekg(pre.next);
-                list_.read(reinterpret_cast<char*>(&next), sizeof(MainNode_));
+                ReadMainNode_(pre.next, next);
 
                 // Set the previous and next node
                 if (head_.nextGarbage == 0) {
-                    list_.seekp(0, std::ios::end);
+                    // Get a new space for the node and its array
+                    Ptr newPtr = storage_.Allocate(BlockSize_());
                     mainNode.next = pre.next;
                     mainNode.pre = next.pre;
-                    pre.next = list_.tellp();
-                    next.pre = list_.tellp();
+                    pre.next = newPtr;
+                    next.pre = newPtr;
 
                     // Put the new node
-                    mainNode.target = pre.next + sizeof(MainNode_);
-                    list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-
-                    // Get a new space for its array
-                    list_.seekp(head_.maxNodeSize * sizeof(Node_), std::ios::end);
-                    list_.write(reinterpret_cast<char*>(&emptyNode_), sizeof(Node_));
+                    mainNode.target = newPtr + sizeof(MainNode_);
+                    WriteMainNode_(newPtr, mainNode);
 
                 } else {
                     MainNode_ tmpMainNode;
-                    list_.seekg(head_.nextGarbage);
-                    list_.read(reinterpret_cast<char*>(&tmpMainNode), sizeof(MainNode_));
+                    ReadMainNode_(head_.nextGarbage, tmpMainNode);
 
                     mainNode.next = pre.next;
                     mainNode.pre = next.pre;
                     mainNode.target = tmpMainNode.target;
                     pre.next = head_.nextGarbage;
                     next.pre = head_.nextGarbage;
-                    list_.seekp(head_.nextGarbage);
-                    list_.write(reinterpret_cast<const char*>(&mainNode), sizeof(MainNode_));
+                    WriteMainNode_(head_.nextGarbage, mainNode);
                     head_.nextGarbage = tmpMainNode.next;
-                    list_.seekp(0);
-                    list_.write(reinterpret_cast<const char*>(&head_), sizeof(FirstNode_));
+                    --(head_.garbageCount);
+                    WriteHead_();
                 }
 
                 // Put back the previous and next main node
-                list_.seekp(mainNode.next);
-                list_.write(reinterpret_cast<char*>(&next), sizeof(MainNode_));
-                list_.seekp(mainNode.pre);
-                list_.write(reinterpret_cast<char*>(&pre), sizeof(MainNode_));
+                WriteMainNode_(mainNode.next, next);
+                WriteMainNode_(mainNode.pre, pre);
+                AddToIndex_(mainNode.key, pre.next);
                 return pre.next;
             } else { // the case that the next main node is the first node
                 // Set the previous and next node
                 if (head_.nextGarbage == 0) {
-                    list_.seekp(0, std::ios::end);
+                    // Get a new space for the node and its array
+                    Ptr newPtr = storage_.Allocate(BlockSize_());
                     mainNode.next = 0;
                     mainNode.pre = target;
-                    pre.next = list_.tellp();
-                    head_.pre = list_.tellp();
+                    pre.next = newPtr;
+                    head_.pre = newPtr;
 
                     // Put the new node
-                    mainNode.target = pre.next + sizeof(MainNode_);
-                    list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-
-                    // Get a new space for its array
-                    list_.seekp(head_.maxNodeSize * sizeof(Node_), std::ios::end);
-                    list_.write(reinterpret_cast<char*>(&emptyNode_), sizeof(Node_));
+                    mainNode.target = newPtr + sizeof(MainNode_);
+                    WriteMainNode_(newPtr, mainNode);
 
                 } else {
                     MainNode_ tmpMainNode;
-                    list_.seekg(head_.nextGarbage);
-                    list_.read(reinterpret_cast<char*>(&tmpMainNode), sizeof(MainNode_));
+                    ReadMainNode_(head_.nextGarbage, tmpMainNode);
 
                     mainNode.next = 0;
                     mainNode.pre = target;
                     mainNode.target = tmpMainNode.target;
                     pre.next = head_.nextGarbage;
                     head_.pre = head_.nextGarbage;
-                    list_.seekp(head_.nextGarbage);
-                    list_.write(reinterpret_cast<const char*>(&mainNode), sizeof(MainNode_));
+                    WriteMainNode_(head_.nextGarbage, mainNode);
                     head_.nextGarbage = tmpMainNode.next;
+                    --(head_.garbageCount);
                 }
 
                 // Put back the previous and next main node
-                list_.seekp(mainNode.pre);
-                list_.write(reinterpret_cast<char*>(&pre), sizeof(MainNode_));
-                list_.seekp(0);
-                list_.write(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
+                WriteMainNode_(mainNode.pre, pre);
+                WriteHead_();
+                AddToIndex_(mainNode.key, pre.next);
                 return pre.next;
             }
         } else { // For an empty list
             if (head_.nextGarbage == 0) {
-                list_.seekp(0, std::ios::end);
-                head_.next = list_.tellp();
-                head_.pre = list_.tellp();
+                // Get a new space for the node and its array
+                head_.next = storage_.Allocate(BlockSize_());
+                head_.pre = head_.next;
                 mainNode.target = head_.next + sizeof(MainNode_);
                 mainNode.next = 0;
                 mainNode.pre = 0;
-                list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
-
-                // to reserve the space for the array of the main node
-                list_.seekp(head_.maxNodeSize * sizeof(Node_), std::ios::end);
-                list_.write(reinterpret_cast<const char*>(&emptyNode_), sizeof(Node_));
+                WriteMainNode_(head_.next, mainNode);
             } else {
                 MainNode_ tmpMainNode;
-                list_.seekg(head_.nextGarbage);
-                list_.read(reinterpret_cast<char*>(&tmpMainNode), sizeof(MainNode_));
+                ReadMainNode_(head_.nextGarbage, tmpMainNode);
 
                 head_.next = head_.nextGarbage;
                 head_.pre = head_.nextGarbage;
                 mainNode.next = 0;
                 mainNode.pre = 0;
                 mainNode.target = tmpMainNode.target;
-                list_.seekp(head_.nextGarbage);
-                list_.write(reinterpret_cast<const char*>(&mainNode), sizeof(MainNode_));
+                WriteMainNode_(head_.nextGarbage, mainNode);
                 head_.nextGarbage = tmpMainNode.next;
+                --(head_.garbageCount);
             }
-            list_.seekp(0);
-            list_.write(reinterpret_cast<char*>(&head_), sizeof(FirstNode_));
+            WriteHead_();
+            AddToIndex_(mainNode.key, head_.next);
             return head_.next;
         }
     }
 
+    /**
+     * Add a new main node to the index.
+     * @param key the key of the main node
+     * @param ptr the place of the main node
+     */
+    void AddToIndex_(const KeyType& key, Ptr ptr) {
+        auto iter = std::upper_bound(index_.begin(), index_.end(), key,
+                                     [](const KeyType& lhs, const IndexEntry_& rhs) { return lhs < rhs.key; });
+        iter = index_.insert(iter, IndexEntry_{key, ptr, NewFilter_()});
+        AddToFilter_(iter->filter, key);
+    }
+
+    /**
+     * Get the position of a main node in the index.
+     * @param key the key of the main node
+     * @param ptr the place of the main node
+     * @return the position in the index
+     */
+    SizeT Position_(const KeyType& key, Ptr ptr) const {
+        SizeT position = LocateIndex_(key);
+        if (index_[position].ptr == ptr) return position;
+        return std::find_if(index_.begin(), index_.end(), [ptr](const IndexEntry_& entry) { return entry.ptr == ptr; })
+               - index_.begin();
+    }
+
     /**
      * This function split a main node into two.
      * @param mainNode
@@ -802,68 +1959,758 @@ private:
     Ptr Split_(MainNode_& mainNode, Ptr mainNodePtr) {
         // Copy the extra string of nodes
         auto* nodeBuffer = new Node_[mainNode.count - head_.nodeSize];
-        for (SizeT i = 0; i < mainNode.count - head_.nodeSize; ++i) {
-            list_.seekg(mainNode.target + sizeof(Node_) * (head_.nodeSize + i));
-            list_.read(reinterpret_cast<char*>(&nodeBuffer[i]), sizeof(Node_));
-        }
+        storage_.Read(reinterpret_cast<char*>(nodeBuffer), mainNode.target + sizeof(Node_) * head_.nodeSize,
+                      sizeof(Node_) * (mainNode.count - head_.nodeSize));
 
         // Create a new node
         Ptr newMainNodePtr;
         MainNode_ newMainNode{nodeBuffer[0].key, nodeBuffer[0].value, 0,
-                              mainNode.count - head_.nodeSize - 1, 0, 0};
+                              mainNode.count - head_.nodeSize - 1, 0, 0, 0};
 
         // Get a new space for the nodes
         newMainNodePtr = NewNode_(newMainNode, mainNodePtr);
 
         // Change the count of the original node
-        list_.seekg(mainNodePtr);
-        list_.read(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+        ReadMainNode_(mainNodePtr, mainNode);
         mainNode.count = head_.nodeSize;
-        list_.seekp(mainNodePtr);
-        list_.write(reinterpret_cast<char*>(&mainNode), sizeof(MainNode_));
+        WriteMainNode_(mainNodePtr, mainNode);
 
         // Get the new main node
-        list_.seekg(newMainNodePtr);
-        list_.read(reinterpret_cast<char*>(&newMainNode), sizeof(MainNode_));
+        ReadMainNode_(newMainNodePtr, newMainNode);
 
         // write the extra string of nodes
-        list_.seekp(newMainNode.target);
-        for (SizeT i = 1; i <= newMainNode.count; ++i) {
-            list_.write(reinterpret_cast<char*>(&nodeBuffer[i]), sizeof(Node_));
-        }
+        storage_.Write(reinterpret_cast<const char*>(nodeBuffer + 1), newMainNode.target,
+                       sizeof(Node_) * newMainNode.count);
+        auto& filter = index_[Position_(newMainNode.key, newMainNodePtr)].filter;
+        for (SizeT i = 1; i <= newMainNode.count; ++i) AddToFilter_(filter, nodeBuffer[i].key);
         delete[] nodeBuffer;
         return newMainNodePtr;
     }
 
     /**
-     * This function reads a string of stuff and returns a pointer to the string.
-     * @param target the place to get the data
-     * @param length
-     * @return a pointer to the string
+     * Merge the main node after a main node into it.  The merged array
+     * MUST NOT have more than <code>maxNodeSize</code> nodes.
+     * @param mainNode the main node, which is reloaded after merging
+     * @param mainNodePtr the place of the main node
+     * @throw lau::RuntimeError if the Bloom filters of the main nodes do
+     * not match the index
      */
-    char* Read_(Ptr target, SizeT length) {
-        char* buffer = new char[length];
-        list_.seekg(target);
-        list_.read(buffer, length);
-        return buffer;
+    void Merge_(MainNode_& mainNode, Ptr mainNodePtr) {
+        Ptr nextPtr = mainNode.next;
+        MainNode_ next;
+        ReadMainNode_(nextPtr, next);
+        auto& filter = index_[Position_(mainNode.key, mainNodePtr)].filter;
+        const auto& nextFilter = index_[Position_(next.key, nextPtr)].filter;
+        if (static_cast<SizeT>(filter.size()) != filterWords_
+            || static_cast<SizeT>(nextFilter.size()) != filterWords_) {
+            throw lau::RuntimeError("Runtime Error: the Bloom filters do not match the index");
+        }
+
+        // Append the next main node and its array to the array
+        WriteNode_(mainNode.target + mainNode.count * sizeof(Node_), Node_{next.key, next.value});
+        storage_.Move(next.target, mainNode.target + (mainNode.count + 1) * sizeof(Node_),
+                      next.count * sizeof(Node_));
+        mainNode.count += next.count + 1;
+        WriteMainNode_(mainNodePtr, mainNode);
+
+        // The filter of the merged main node has the bits of both
+        for (SizeT i = 0; i < filterWords_; ++i) filter[i] |= nextFilter[i];
+
+        DeleteNode_(next, nextPtr);
+        ReadMainNode_(mainNodePtr, mainNode);
+    }
+
+    /**
+     * Merge a main node that has too few nodes with one of its neighbours
+     * (the next one, or the previous one for the last main node) if the
+     * merged array has no more than <code>nodeSize</code> nodes, or move
+     * some nodes from the neighbour to it otherwise, so that each main
+     * node keeps at least <code>nodeSize / 2</code> nodes.
+     * @param mainNode
+     * @param mainNodePtr the place of the main node
+     */
+    void Rebalance_(const MainNode_& mainNode, Ptr mainNodePtr) {
+        if (mainNode.pre == 0 && mainNode.next == 0) return; // the only main node
+
+        Ptr leftPtr = mainNodePtr, rightPtr = mainNode.next;
+        MainNode_ left = mainNode, right;
+        if (rightPtr == 0) {
+            leftPtr = mainNode.pre;
+            rightPtr = mainNodePtr;
+            right = mainNode;
+            ReadMainNode_(leftPtr, left);
+        } else {
+            ReadMainNode_(rightPtr, right);
+        }
+
+        if (left.count + right.count + 1 <= head_.nodeSize) Merge_(left, leftPtr);
+        else Balance_(left, leftPtr, right, rightPtr);
+    }
+
+    /**
+     * Share the nodes of two adjacent main nodes evenly between them.
+     * @param left the former main node
+     * @param leftPtr the place of the former main node
+     * @param right the latter main node
+     * @param rightPtr the place of the latter main node
+     */
+    void Balance_(MainNode_& left, Ptr leftPtr, MainNode_& right, Ptr rightPtr) {
+        // Gather the nodes of the two main nodes in order
+        std::vector<Node_> nodes;
+        nodes.reserve(left.count + right.count + 2);
+        nodes.push_back(Node_{left.key, left.value});
+        const Node_* array = ReadArray_(left);
+        nodes.insert(nodes.end(), array, array + left.count);
+        nodes.push_back(Node_{right.key, right.value});
+        array = ReadArray_(right);
+        nodes.insert(nodes.end(), array, array + right.count);
+
+        // Put the first half in the former one and the rest in the latter one
+        SizeT position = LocateIndex_(right.key);
+        SizeT leftSize = static_cast<SizeT>(nodes.size()) / 2;
+        left.count = leftSize - 1;
+        WriteBlock_(leftPtr, left, nodes.data() + 1);
+        right.key = nodes[leftSize].key;
+        right.value = nodes[leftSize].value;
+        right.count = static_cast<SizeT>(nodes.size()) - leftSize - 1;
+        WriteBlock_(rightPtr, right, nodes.data() + leftSize + 1);
+        index_[position].key = right.key;
+        index_[position - 1].filter = MakeFilter_(nodes.data(), nodes.data() + leftSize, filterWords_);
+        index_[position].filter = MakeFilter_(nodes.data() + leftSize, nodes.data() + nodes.size(), filterWords_);
+    }
+
+    /**
+     * Swap the places of two main nodes (with their arrays) in the file.
+     * @param first the position of a main node in the index
+     * @param second the position of the other main node in the index
+     */
+    void Swap_(SizeT first, SizeT second) {
+        Ptr firstPtr = index_[first].ptr, secondPtr = index_[second].ptr;
+        auto swapPtr = [firstPtr, secondPtr](Ptr ptr) {
+            return ptr == firstPtr ? secondPtr : (ptr == secondPtr ? firstPtr : ptr);
+        };
+
+        // Read the two blocks
+        MainNode_ firstNode, secondNode;
+        ReadMainNode_(firstPtr, firstNode);
+        ReadMainNode_(secondPtr, secondNode);
+        const Node_* array = ReadArray_(firstNode);
+        std::vector<Node_> firstArray(array, array + firstNode.count);
+        const Node_* secondArray = ReadArray_(secondNode);
+
+        // Put the blocks in the places of each other
+        Ptr neighbours[4] = {firstNode.pre, firstNode.next, secondNode.pre, secondNode.next};
+        firstNode.pre = swapPtr(firstNode.pre);
+        firstNode.next = swapPtr(firstNode.next);
+        firstNode.target = secondPtr + sizeof(MainNode_);
+        secondNode.pre = swapPtr(secondNode.pre);
+        secondNode.next = swapPtr(secondNode.next);
+        secondNode.target = firstPtr + sizeof(MainNode_);
+        WriteBlock_(firstPtr, secondNode, secondArray);
+        WriteBlock_(secondPtr, firstNode, firstArray.data());
+
+        // Link the neighbours to the new places
+        std::sort(neighbours, neighbours + 4);
+        MainNode_ tmp;
+        for (SizeT i = 0; i < 4; ++i) {
+            Ptr ptr = neighbours[i];
+            if (ptr == 0 || ptr == firstPtr || ptr == secondPtr || (i > 0 && ptr == neighbours[i - 1])) continue;
+            ReadMainNode_(ptr, tmp);
+            tmp.pre = swapPtr(tmp.pre);
+            tmp.next = swapPtr(tmp.next);
+            WriteMainNode_(ptr, tmp);
+        }
+        head_.next = swapPtr(head_.next);
+        head_.pre = swapPtr(head_.pre);
+        WriteHead_();
+        std::swap(index_[first].ptr, index_[second].ptr);
+    }
+
+    /**
+     * Apply the operations sorted by key to the nodes sorted by key.
+     * @param nodes the nodes before the operations
+     * @param first the first operation
+     * @param last the end of the operations
+     * @param result the place to put the nodes after the operations
+     * @return the number of successful operations
+     */
+    static SizeT MergeOperations_(const std::vector<Node_>& nodes, const typename WriteBatch::Operation_* first,
+                                  const typename WriteBatch::Operation_* last, std::vector<Node_>& result) {
+        SizeT done = 0;
+        auto node = nodes.begin();
+        while (first != last) {
+            const KeyType& key = first->key;
+            while (node != nodes.end() && node->key < key) result.push_back(*(node++));
+            bool exist = node != nodes.end() && node->key == key;
+            ValueType value = exist ? (node++)->value : ValueType();
+
+            // Apply the operations on the key in order
+            for (; first != last && first->key == key; ++first) {
+                if (first->type == WriteBatch::insert) {
+                    if (exist) continue;
+                    exist = true;
+                    value = first->value;
+                } else if (first->type == WriteBatch::erase) {
+                    if (!exist) continue;
+                    exist = false;
+                } else {
+                    if (!exist) continue;
+                    value = first->value;
+                }
+                ++done;
+            }
+            if (exist) result.push_back(Node_{key, value});
+        }
+        result.insert(result.end(), node, nodes.end());
+        return done;
+    }
+
+    /**
+     * Replace the nodes of a main node with a sequence of nodes, which is
+     * split into several main nodes if there are too many nodes.
+     * @param position the position of the main node in the index (-1 if
+     * the list is empty, and then new main nodes are made)
+     * @param mainNodePtr the place of the main node
+     * @param nodes the new nodes in order (MUST NOT be empty)
+     * @param rebalance whether to rebalance the main node if it has too
+     * few nodes
+     */
+    void RewriteBlock_(SizeT position, Ptr mainNodePtr, const std::vector<Node_>& nodes, bool rebalance) {
+        SizeT size = static_cast<SizeT>(nodes.size());
+        SizeT blocks = size <= head_.maxNodeSize ? 1 : (size + head_.nodeSize) / (head_.nodeSize + 1);
+        MainNode_ mainNode;
+        for (SizeT i = 0; i < blocks; ++i) {
+            // Share the nodes evenly among the main nodes
+            SizeT begin = size * i / blocks, end = size * (i + 1) / blocks;
+            if (i == 0 && position != -1) {
+                ReadMainNode_(mainNodePtr, mainNode);
+                mainNode.key = nodes[begin].key;
+                mainNode.value = nodes[begin].value;
+                mainNode.count = end - begin - 1;
+                index_[position].key = mainNode.key;
+            } else {
+                mainNode = MainNode_{nodes[begin].key, nodes[begin].value, 0, end - begin - 1, 0, 0, 0};
+                mainNodePtr = NewNode_(mainNode, i == 0 ? 0 : mainNodePtr);
+            }
+            WriteBlock_(mainNodePtr, mainNode, nodes.data() + begin + 1);
+            index_[Position_(mainNode.key, mainNodePtr)].filter = MakeFilter_(nodes.data() + begin,
+                                                                              nodes.data() + end, filterWords_);
+        }
+        if (rebalance && blocks == 1 && mainNode.count + 1 < head_.nodeSize / 2) Rebalance_(mainNode, mainNodePtr);
+    }
+
+    /**
+     * Put a block of nodes at the end of the storage of a compacted file,
+     * and then clear the block.  It is used by <code>Compact</code>.
+     * @param target the storage of the compacted file
+     * @param block the nodes of the main node and its array
+     * @param prePtr the place of the last main node (0 if there is none)
+     * @param hasNext whether there is another block after this one
+     * @param head the head of the compacted file
+     * @param index the index of the compacted file
+     * @return the place of the main node
+     */
+    Ptr AppendBlock_(Storage& target, std::vector<Node_>& block, Ptr prePtr, bool hasNext,
+                     FirstNode_& head, std::vector<IndexEntry_>& index) const {
+        Ptr ptr = target.Allocate(head.blockSize);
+        Ptr arrayPtr = ptr + sizeof(MainNode_);
+        MainNode_ mainNode{block.front().key, block.front().value, arrayPtr,
+                           static_cast<SizeT>(block.size()) - 1, hasNext ? ptr + head.blockSize : 0, prePtr, 0};
+        mainNode.checksum = BlockChecksum_(mainNode, block.data() + 1);
+        target.Write(reinterpret_cast<const char*>(&mainNode), ptr, sizeof(MainNode_));
+        target.Write(reinterpret_cast<const char*>(block.data() + 1), arrayPtr, mainNode.count * sizeof(Node_));
+        target.EndOperation();
+        if (head.next == 0) {
+            head.next = ptr;
+            head.minKey = block.front().key;
+        }
+        head.pre = ptr;
+        head.size += static_cast<SizeT>(block.size());
+        ++(head.blockCount);
+        head.maxKey = block.back().key;
+        index.push_back(IndexEntry_{mainNode.key, ptr,
+                                    MakeFilter_(block.data(), block.data() + block.size(),
+                                                FilterWords_(head.maxNodeSize))});
+        block.clear();
+        return ptr;
+    }
+
+    /**
+     * Write a main node and the nodes in <code>arrayBuffer_</code> that
+     * follow the first <code>written</code> nodes of its array, and then
+     * clear the buffer.  It is used by <code>BulkLoad</code>.
+     * @param ptr the place of the main node
+     * @param mainNode
+     * @param written the number of nodes in the array already in the file
+     */
+    void PutBlock_(Ptr ptr, const MainNode_& mainNode, SizeT written) {
+        if (written == 0) { // the whole array is in the buffer
+            MainNode_ block = mainNode;
+            WriteBlock_(ptr, block, arrayBuffer_.data());
+        } else {
+            storage_.Write(reinterpret_cast<const char*>(arrayBuffer_.data()),
+                           mainNode.target + written * sizeof(Node_),
+                           static_cast<SizeT>(arrayBuffer_.size()) * sizeof(Node_));
+            WriteMainNode_(ptr, mainNode);
+        }
+        arrayBuffer_.clear();
+    }
+
+    /**
+     * Read a main node.
+     * @param ptr the place of the main node
+     * @param mainNode the place to put the main node
+     */
+    void ReadMainNode_(Ptr ptr, MainNode_& mainNode) const {
+        storage_.Read(reinterpret_cast<char*>(&mainNode), ptr, sizeof(MainNode_));
+    }
+
+    /**
+     * Write a main node.  Its checksum is updated at the end of the
+     * operation.
+     * @param ptr the place of the main node
+     * @param mainNode
+     */
+    void WriteMainNode_(Ptr ptr, const MainNode_& mainNode) {
+        storage_.Write(reinterpret_cast<const char*>(&mainNode), ptr, sizeof(MainNode_));
+        dirty_.push_back(ptr);
+    }
+
+    /**
+     * Write a main node and its whole array with the checksum.
+     * @param ptr the place of the main node
+     * @param mainNode the main node, whose checksum is set
+     * @param array
+     */
+    void WriteBlock_(Ptr ptr, MainNode_& mainNode, const Node_* array) {
+        mainNode.checksum = BlockChecksum_(mainNode, array);
+        storage_.Write(reinterpret_cast<const char*>(&mainNode), ptr, sizeof(MainNode_));
+        storage_.Write(reinterpret_cast<const char*>(array), mainNode.target, mainNode.count * sizeof(Node_));
+        dirty_.erase(std::remove(dirty_.begin(), dirty_.end(), ptr), dirty_.end());
+    }
+
+    /**
+     * Get the checksum of a main node and its array.
+     * @param mainNode
+     * @param array
+     * @return the CRC-32C of the main node (except the checksum) and the
+     * array
+     */
+    static std::uint64_t BlockChecksum_(const MainNode_& mainNode, const Node_* array) {
+        const auto* bytes = reinterpret_cast<const char*>(&mainNode);
+        const auto* checksum = reinterpret_cast<const char*>(&mainNode.checksum);
+        SizeT after = static_cast<SizeT>(bytes + sizeof(MainNode_) - checksum) - sizeof(mainNode.checksum);
+        std::uint32_t crc = Crc32c(bytes, checksum - bytes);
+        crc = Crc32c(checksum + sizeof(mainNode.checksum), after, crc);
+        return Crc32c(reinterpret_cast<const char*>(array), mainNode.count * sizeof(Node_), crc);
+    }
+
+    /**
+     * Check the checksum of a main node and its array.
+     * @param mainNode
+     * @param array
+     * @throw lau::RuntimeError if the checksum does not match
+     */
+    void CheckBlock_(const MainNode_& mainNode, const Node_* array) const {
+        if (BlockChecksum_(mainNode, array) != mainNode.checksum) {
+            throw lau::RuntimeError("Runtime Error: the checksum of a main node does not match");
+        }
+    }
+
+    /**
+     * Read the whole array of a main node and check the checksum.
+     * @param mainNode
+     * @return the pointer to the array (see <code>ReadArray_</code>)
+     * @throw lau::RuntimeError if the checksum does not match
+     */
+    const Node_* ReadCheckedArray_(const MainNode_& mainNode) const {
+        if (mainNode.count < 0 || mainNode.count > head_.maxNodeSize) {
+            throw lau::RuntimeError("Runtime Error: the size of a main node is invalid");
+        }
+        const Node_* array = ReadArray_(mainNode);
+        CheckBlock_(mainNode, array);
+        return array;
+    }
+
+    /**
+     * Count the modification, update the statistics in the head and the
+     * checksums of the main nodes written in the operation, and then mark
+     * the end of the operation.
+     */
+    void EndOperation_() {
+        ++(head_.modifications);
+        UpdateStats_();
+        WriteHead_();
+        std::sort(dirty_.begin(), dirty_.end());
+        dirty_.erase(std::unique(dirty_.begin(), dirty_.end()), dirty_.end());
+        MainNode_ mainNode;
+        for (Ptr ptr : dirty_) {
+            ReadMainNode_(ptr, mainNode);
+            mainNode.checksum = BlockChecksum_(mainNode, ReadArray_(mainNode));
+            storage_.Write(reinterpret_cast<const char*>(&mainNode), ptr, sizeof(MainNode_));
+        }
+        dirty_.clear();
+        storage_.EndOperation();
+    }
+
+    /**
+     * Read a node in an array.
+     * @param ptr the place of the node
+     * @param node the place to put the node
+     */
+    void ReadNode_(Ptr ptr, Node_& node) const {
+        storage_.Read(reinterpret_cast<char*>(&node), ptr, sizeof(Node_));
+    }
+
+    /**
+     * Write a node in an array.
+     * @param ptr the place of the node
+     * @param node
+     */
+    void WriteNode_(Ptr ptr, const Node_& node) {
+        storage_.Write(reinterpret_cast<const char*>(&node), ptr, sizeof(Node_));
+    }
+
+    /**
+     * @struct Latches_{list, cache}
+     *
+     * The latches to read the list in several threads.  The cache latch
+     * is shared by the readers getting from the cache, and exclusive to
+     * the readers putting a pair into it.  They are kept in the heap so
+     * that the list can be moved.
+     */
+    struct Latches_ {
+        ReaderWriterLatch list;
+        std::shared_mutex cache;
+    };
+
+    /**
+     * Lock the list for a function that only reads the list.
+     * @return the shared lock of the list
+     * @throw lau::RuntimeError if the list has no storage (see
+     * <code>CheckStorage_</code>)
+     */
+    std::shared_lock<std::shared_mutex> ReadLock_() const {
+        std::shared_lock<std::shared_mutex> lock = latches_->list.ReadLock();
+        CheckStorage_();
+        return lock;
+    }
+
+    /**
+     * Lock the list for a function that modifies the list.
+     * @return the exclusive lock of the list
+     * @throw lau::RuntimeError if the list has no storage (see
+     * <code>CheckStorage_</code>)
+     */
+    std::unique_lock<std::shared_mutex> WriteLock_() {
+        std::unique_lock<std::shared_mutex> lock = latches_->list.WriteLock();
+        CheckStorage_();
+        return lock;
+    }
+
+    /**
+     * Check that the list still has a storage, which it loses if the file
+     * cannot be opened again after <code>Rewrite_</code> replaces it.
+     * @throw lau::RuntimeError if the list has no storage
+     */
+    void CheckStorage_() const {
+        if (broken_) throw lau::RuntimeError("Runtime Error: the file cannot be opened again after it was replaced");
+    }
+
+    /**
+     * Write the first node (the head of the list).
+     */
+    void WriteHead_() {
+        head_.checksum = HeadChecksum_(head_);
+        storage_.Write(reinterpret_cast<const char*>(&head_), 0, sizeof(FirstNode_));
+    }
+
+    /**
+     * Read the first node (the head of the list) and check it.
+     * @throw lau::RuntimeError if the head is broken, or the file is not
+     * made with the same version or the same key and value types
+     */
+    void ReadHead_() {
+        storage_.Read(reinterpret_cast<char*>(&head_), 0, sizeof(FirstNode_));
+        if (head_.checksum != HeadChecksum_(head_)) {
+            throw lau::RuntimeError("Runtime Error: the checksum of the head does not match");
+        }
+        if (head_.version != kVersion_) throw lau::RuntimeError("Runtime Error: the version is not supported");
+        if (head_.keySize != static_cast<SizeT>(sizeof(KeyType))
+            || head_.valueSize != static_cast<SizeT>(sizeof(ValueType))) {
+            throw lau::RuntimeError("Runtime Error: the sizes of the keys and values do not match the file");
+        }
+        if (head_.nodeSize <= 0 || head_.maxNodeSize < head_.nodeSize
+            || head_.blockSize < static_cast<SizeT>(sizeof(MainNode_) + (head_.maxNodeSize + 1) * sizeof(Node_))) {
+            throw lau::RuntimeError("Runtime Error: the size of the main nodes is invalid");
+        }
+        if (head_.size < 0 || head_.blockCount < 0 || head_.garbageCount < 0 || head_.size < head_.blockCount) {
+            throw lau::RuntimeError("Runtime Error: the statistics in the head are invalid");
+        }
+    }
+
+    /**
+     * Get a new head of the list.  The size of a main node with its array
+     * is rounded up to a multiple of the alignment, and the array is made
+     * as long as the rounded size allows.
+     * @param nodeSize
+     * @param maxNodeSize
+     * @param alignment the alignment of the storage
+     * @return the head
+     */
+    static FirstNode_ NewHead_(SizeT nodeSize, SizeT maxNodeSize, SizeT alignment) {
+        SizeT blockSize = sizeof(MainNode_) + (maxNodeSize + 1) * sizeof(Node_);
+        blockSize = (blockSize + alignment - 1) / alignment * alignment;
+        maxNodeSize = (blockSize - static_cast<SizeT>(sizeof(MainNode_))) / static_cast<SizeT>(sizeof(Node_)) - 1;
+        return FirstNode_{kMagic_, kVersion_, sizeof(KeyType), sizeof(ValueType), 0, 0, 0, nodeSize, maxNodeSize,
+                          blockSize, 0, 0, 0, KeyType(), KeyType(), 0, 0};
+    }
+
+    /**
+     * Get the size of the space of the head, which is rounded up to a
+     * multiple of the alignment so that the main nodes after it are
+     * aligned.
+     * @param alignment the alignment of the storage
+     * @return the size of the space of the head
+     */
+    static SizeT HeadSize_(SizeT alignment) {
+        return (static_cast<SizeT>(sizeof(FirstNode_)) + alignment - 1) / alignment * alignment;
+    }
+
+    /**
+     * Update the statistics in the head that are not updated by the
+     * operations themselves: the number of main nodes, the least key, and
+     * the greatest key if the greatest key might have been erased.
+     */
+    void UpdateStats_() {
+        head_.blockCount = static_cast<SizeT>(index_.size());
+        if (index_.empty()) {
+            head_.minKey = KeyType();
+            head_.maxKey = KeyType();
+        } else {
+            head_.minKey = index_.front().key;
+            if (maxStale_) head_.maxKey = LastKey_();
+        }
+        maxStale_ = false;
+    }
+
+    /**
+     * Get the greatest key in the list by reading the last main node.  The
+     * list MUST NOT be empty.
+     * @return the greatest key
+     */
+    KeyType LastKey_() const {
+        MainNode_ mainNode;
+        ReadMainNode_(head_.pre, mainNode);
+        if (mainNode.count == 0) return mainNode.key;
+        Node_ tmpNode;
+        ReadNode_(mainNode.target + (mainNode.count - 1) * sizeof(Node_), tmpNode);
+        return tmpNode.key;
+    }
+
+    /**
+     * Tell whether the key is out of the range of the keys in the list
+     * by the statistics in the head, so that the main nodes need not be
+     * read.
+     * @param key
+     * @return whether the key is surely not in the list
+     */
+    [[nodiscard]] bool OutOfRange_(const KeyType& key) const {
+        return head_.size == 0 || key < head_.minKey || head_.maxKey < key;
+    }
+
+    static std::uint64_t HeadChecksum_(const FirstNode_& head) {
+        return Crc32c(reinterpret_cast<const char*>(&head), offsetof(FirstNode_, checksum));
+    }
+
+    /**
+     * Remove the file made by <code>Rewrite_</code> and the files the
+     * storage keeps beside it (the log of a
+     * <code>lau::JournaledStorage</code>).  The files that do not exist
+     * are ignored.
+     * @param compactName the name of the file made by <code>Rewrite_</code>
+     */
+    static void RemoveCompactFiles_(const std::string& compactName) {
+        std::remove(compactName.c_str());
+        std::remove((compactName + ".wal").c_str());
+    }
+
+    /**
+     * Rewrite the list into a new file, whose name is the file name with
+     * a <code>.compact</code> suffix, and then replace the file with it.
+     * The pairs are packed into main nodes with <code>nodeSize</code>
+     * nodes in the array.  It is used by <code>Compact</code> and
+     * <code>Upgrade_</code>.
+     * @tparam ForEachBlock
+     * @param forEachBlock the function to call its argument
+     * <code>put(key, value, array, count)</code> with each main node and
+     * its array in order
+     * @throw lau::RuntimeError if the file cannot be replaced, and then
+     * the list keeps the old file, or the file cannot be opened again,
+     * and then the list has no storage (see <code>CheckStorage_</code>)
+     */
+    template <class ForEachBlock>
+    void Rewrite_(ForEachBlock forEachBlock) {
+        std::string compactName = fileName_ + ".compact";
+        RemoveCompactFiles_(compactName); // a log left by a crash must not be replayed
+        std::ofstream(compactName, std::ios::out | std::ios::binary | std::ios::trunc).close();
+        storage_.Flush();
+
+        FirstNode_ newHead;
+        std::vector<IndexEntry_> newIndex;
+        try {
+            Storage target = openStorage_(compactName);
+            newHead = NewHead_(head_.nodeSize, head_.maxNodeSize, target.Alignment());
+            target.Allocate(HeadSize_(target.Alignment()));
+
+            // Pack the pairs into blocks, and put a block once the pairs
+            // after it come
+            std::vector<Node_> block;
+            block.reserve(head_.nodeSize + 1);
+            Ptr prePtr = 0;
+            forEachBlock([&](const KeyType& key, const ValueType& value, const Node_* array, SizeT count) {
+                for (SizeT j = -1; j < count; ++j) {
+                    if (static_cast<SizeT>(block.size()) > head_.nodeSize) {
+                        prePtr = AppendBlock_(target, block, prePtr, true, newHead, newIndex);
+                    }
+                    block.push_back(j == -1 ? Node_{key, value} : array[j]);
+                }
+            });
+            if (!block.empty()) AppendBlock_(target, block, prePtr, false, newHead, newIndex);
+            newHead.modifications = head_.modifications + 1;
+            newHead.checksum = HeadChecksum_(newHead);
+            target.Write(reinterpret_cast<const char*>(&newHead), 0, sizeof(FirstNode_));
+            target.EndOperation();
+            target.Flush();
+        } catch (...) {
+            RemoveCompactFiles_(compactName);
+            throw;
+        }
+
+        // Close the file before replacing it, so that nothing is written to
+        // it (e.g. by the log of a lau::JournaledStorage) afterwards.  The
+        // list has no storage until the file is opened again.
+        { Storage old(std::move(storage_)); }
+        broken_ = true;
+        bool renamed = std::rename(compactName.c_str(), fileName_.c_str()) == 0;
+        RemoveCompactFiles_(compactName);
+        Storage storage = openStorage_(fileName_);
+        storage_ = std::move(storage);
+        broken_ = false;
+        if (!renamed) throw lau::RuntimeError("Runtime Error: fail to replace the file with the compacted one");
+        head_ = newHead;
+        index_ = std::move(newIndex);
+        filterWords_ = FilterWords_(head_.maxNodeSize); // the filters are made for the new head
+        compactCursor_ = 0;
+    }
+
+    /**
+     * Upgrade a file made before the head had a version (which has no
+     * checksums) by rewriting it.
+     * @throw lau::RuntimeError if the list is not constructed with a file
+     * name, or the main nodes are broken
+     */
+    void Upgrade_() {
+        LegacyFirstNode_ legacy;
+        storage_.Read(reinterpret_cast<char*>(&legacy), 0, sizeof(LegacyFirstNode_));
+        RewriteOld_<LegacyMainNode_>(legacy.next, sizeof(LegacyFirstNode_), legacy.nodeSize, legacy.maxNodeSize);
+    }
+
+    /**
+     * Upgrade a file of an older version with a checked head (version 1
+     * has no statistics in the head, version 2 has no block size, and
+     * version 3 has no number of modifications) by rewriting it.  The checksums of the main nodes are checked on the
+     * way.
+     * @tparam OldFirstNode the type of the head in the file
+     * @throw lau::RuntimeError if the list is not constructed with a file
+     * name, or the head or the main nodes are broken
+     */
+    template <class OldFirstNode>
+    void UpgradeVersioned_() {
+        OldFirstNode head;
+        storage_.Read(reinterpret_cast<char*>(&head), 0, sizeof(OldFirstNode));
+        if (head.checksum != Crc32c(reinterpret_cast<const char*>(&head), offsetof(OldFirstNode, checksum))) {
+            throw lau::RuntimeError("Runtime Error: the checksum of the head does not match");
+        }
+        if (head.keySize != static_cast<SizeT>(sizeof(KeyType))
+            || head.valueSize != static_cast<SizeT>(sizeof(ValueType))) {
+            throw lau::RuntimeError("Runtime Error: the sizes of the keys and values do not match the file");
+        }
+        RewriteOld_<MainNode_>(head.next, sizeof(OldFirstNode), head.nodeSize, head.maxNodeSize);
+    }
+
+    /**
+     * Rewrite a file in an old format by walking its main nodes from the
+     * first one.  The links and the sizes are checked on the way, so that
+     * a broken file cannot lead the walk out of the file.
+     * @tparam OldMainNode the type of the main nodes in the file, which
+     * has the members <code>key</code>, <code>value</code>,
+     * <code>target</code>, <code>count</code>, <code>next</code> and
+     * <code>pre</code>
+     * @param first the first main node
+     * @param headSize the size of the head in the file
+     * @param nodeSize
+     * @param maxNodeSize
+     * @throw lau::RuntimeError if the list is not constructed with a file
+     * name, or the main nodes are broken
+     */
+    template <class OldMainNode>
+    void RewriteOld_(Ptr first, SizeT headSize, SizeT nodeSize, SizeT maxNodeSize) {
+        if (fileName_.empty()) {
+            throw lau::RuntimeError("Runtime Error: the file is in an old format, which can only be upgraded "
+                                    "when the list is constructed with a file name");
+        }
+        if (nodeSize <= 0 || maxNodeSize < nodeSize
+            || maxNodeSize > storage_.Allocate(0) / static_cast<SizeT>(sizeof(Node_))) {
+            throw lau::RuntimeError("Runtime Error: the size of the main nodes is invalid");
+        }
+        head_.nodeSize = nodeSize;
+        head_.maxNodeSize = maxNodeSize;
+        Rewrite_([this, first, headSize, maxNodeSize](auto&& put) {
+            Ptr end = storage_.Allocate(0); // the end of the file
+            OldMainNode mainNode;
+            std::vector<Node_> array;
+            Ptr prePtr = 0;
+            for (Ptr ptr = first; ptr != 0; prePtr = ptr, ptr = mainNode.next) {
+                if (ptr < headSize || ptr > end - static_cast<Ptr>(sizeof(OldMainNode))) {
+                    throw lau::RuntimeError("Runtime Error: a link of the main nodes is out of the file");
+                }
+                storage_.Read(reinterpret_cast<char*>(&mainNode), ptr, sizeof(OldMainNode));
+                if (mainNode.pre != prePtr || mainNode.count < 0 || mainNode.count > maxNodeSize
+                    || mainNode.target < ptr
+                    || mainNode.target > end - mainNode.count * static_cast<Ptr>(sizeof(Node_))) {
+                    throw lau::RuntimeError("Runtime Error: the main nodes are broken");
+                }
+                array.resize(mainNode.count);
+                storage_.Read(reinterpret_cast<char*>(array.data()), mainNode.target, mainNode.count * sizeof(Node_));
+                if constexpr (std::is_same_v<OldMainNode, MainNode_>) CheckBlock_(mainNode, array.data());
+                put(mainNode.key, mainNode.value, array.data(), mainNode.count);
+            }
+        });
     }
 
     /**
-     * This function writes a string of stuff.
-     * @param source the source pointer
-     * @param target the place to place the data
-     * @param length
+     * Get the size of a main node with its array (and the padding).
+     * @return the size of a main node with its array
      */
-    void Write_(char* source, Ptr target, SizeT length) {
-        list_.seekp(target);
-        list_.write(source, length);
+    [[nodiscard]] SizeT BlockSize_() const {
+        return head_.blockSize;
     }
 
-    mutable std::fstream  list_;
+    mutable Storage storage_;
     FirstNode_ head_;
-    Node_ emptyNode_;
-    mutable Node_ cachedNode_;
-    mutable bool cached = false;
+    std::vector<IndexEntry_> index_; // the main nodes in order
+    std::vector<Node_> arrayBuffer_; // the nodes to be put by PutBlock_
+    mutable ClockCache<KeyType, ValueType> cache_;
+    std::string fileName_; // empty if the list is constructed with a storage
+    std::function<Storage(const std::string&)> openStorage_; // empty if the list is constructed with a storage
+    SizeT compactCursor_ = 0; // the position in the index where CompactStep continues
+    SizeT filterBits_ = 0; // the number of bits of the Bloom filters for each node
+    SizeT filterWords_ = 0; // the number of words of each Bloom filter in the index
+    bool maxStale_ = false; // whether the greatest key in the head might have been erased
+    std::vector<Ptr> dirty_; // the main nodes whose checksums are to be updated
+    bool broken_ = false; // whether the storage is lost (see CheckStorage_)
+    std::unique_ptr<Latches_> latches_ = std::make_unique<Latches_>();
 };
 
 }
@@ -0,0 +1,968 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/flat_hash_table.h
+ *
+ * This is a external header file, including a flat hash table class.
+ */
+
+#ifndef LAU_CPP_LIB_LAU_FLAT_HASH_TABLE_H
+#define LAU_CPP_LIB_LAU_FLAT_HASH_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LAU_CPP_LIB_FLAT_HASH_TABLE_SSE2
+#endif
+
+#include "exception.h"
+#include "type_traits.h"
+#include "utility.h"
+
+namespace lau {
+
+/**
+ * @class FlatHashTable
+ *
+ * A hash table storing the elements in a contiguous array of slots with
+ * open addressing.  Each slot has a control byte, which is either empty or
+ * 7 bits of the hash of the element in it, and the control bytes of a
+ * group of 16 slots are compared with the hash at once (with SSE2 if
+ * available), so most of the slots compared with the element are skipped
+ * without touching the elements.  The slots are probed linearly, and
+ * erasing an element shifts the elements after it backward instead of
+ * leaving a tombstone, so the probing never slows down as the elements are
+ * inserted and erased.
+ * <br><br>
+ * Inserting may move all the elements (when the table grows), and erasing
+ * may move the elements after the erased one, so both invalidate all the
+ * iterators.
+ * @tparam T
+ * @tparam Hash
+ * @tparam Equal
+ * @tparam Allocator
+ */
+template <class T,
+          class Hash = std::hash<T>,
+          class Equal = std::equal_to<T>,
+          class Allocator = std::allocator<T>>
+class FlatHashTable {
+public:
+    class Iterator;
+    class ConstIterator;
+
+    using SlotAllocatorType    = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+    using ControlAllocatorType = typename std::allocator_traits<Allocator>::template rebind_alloc<std::int8_t>;
+
+    class Iterator {
+        friend class FlatHashTable;
+        friend class ConstIterator;
+
+    public:
+        // The following code is written for the C++ type_traits library.
+        // Type traits is a C++ feature for describing certain properties of a type.
+        // STL algorithms and containers may use these type_traits (e.g. the following
+        // typedef) to work properly.
+        // See these websites for more information:
+        // https://en.cppreference.com/w/cpp/header/type_traits
+        // About iterator_category: https://en.cppreference.com/w/cpp/iterator
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = T;
+        using pointer           = value_type*;
+        using reference         = value_type&;
+        using iterator_category = std::output_iterator_tag;
+
+        Iterator() noexcept = default;
+        Iterator(const Iterator&) noexcept = default;
+
+        Iterator& operator=(const Iterator&) noexcept = default;
+
+        ~Iterator() = default;
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        Iterator& operator++() {
+            if (table_ == nullptr || index_ == table_->capacity_) {
+                throw InvalidIterator("Invalid Iterator: using ++ on the end iterator");
+            }
+            index_ = table_->NextFull_(index_ + 1);
+            return *this;
+        }
+
+        Iterator operator--(int) {
+            Iterator tmp = *this;
+            --(*this);
+            return tmp;
+        }
+
+        Iterator& operator--() {
+            SizeT index = table_ == nullptr ? -1 : table_->PreviousFull_(index_ - 1);
+            if (index < 0) {
+                throw InvalidIterator("Invalid Iterator: using -- on the beginning iterator");
+            }
+            index_ = index;
+            return *this;
+        }
+
+        bool operator==(const Iterator& rhs) const noexcept {
+            return ((this->table_ == rhs.table_) && (this->index_ == rhs.index_));
+        }
+
+        bool operator==(const ConstIterator& rhs) const noexcept {
+            return ((this->table_ == rhs.table_) && (this->index_ == rhs.index_));
+        }
+
+        bool operator!=(const Iterator& rhs) const noexcept {
+            return ((this->table_ != rhs.table_) || (this->index_ != rhs.index_));
+        }
+
+        bool operator!=(const ConstIterator& rhs) const noexcept {
+            return ((this->table_ != rhs.table_) || (this->index_ != rhs.index_));
+        }
+
+        T& operator*() const {
+            if (table_ == nullptr || index_ == table_->capacity_) {
+                throw InvalidIterator("Invalid Iterator: de-referencing the end iterator");
+            }
+            return table_->slots_[index_];
+        }
+
+        T* operator->() const {
+            if (table_ == nullptr || index_ == table_->capacity_) {
+                throw InvalidIterator("Invalid Iterator: de-referencing the end iterator");
+            }
+            return table_->slots_ + index_;
+        }
+
+    private:
+        Iterator(SizeT index, FlatHashTable* table) noexcept : index_(index), table_(table) {}
+
+        SizeT index_ = 0; // the index of the slot, or the capacity for the end iterator
+        FlatHashTable* table_ = nullptr;
+    };
+
+    class ConstIterator {
+        friend class FlatHashTable;
+        friend class Iterator;
+
+    public:
+        // The following code is written for the C++ type_traits library.
+        // Type traits is a C++ feature for describing certain properties of a type.
+        // STL algorithms and containers may use these type_traits (e.g. the following
+        // typedef) to work properly.
+        // See these websites for more information:
+        // https://en.cppreference.com/w/cpp/header/type_traits
+        // About iterator_category: https://en.cppreference.com/w/cpp/iterator
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = T;
+        using pointer           = const value_type*;
+        using reference         = const value_type&;
+        using iterator_category = std::output_iterator_tag;
+
+        ConstIterator() noexcept = default;
+        ConstIterator(const ConstIterator&) noexcept = default;
+        ConstIterator(const Iterator& obj) noexcept : index_(obj.index_), table_(obj.table_) {}
+
+        ConstIterator& operator=(const ConstIterator&) noexcept = default;
+
+        ~ConstIterator() = default;
+
+        ConstIterator operator++(int) {
+            ConstIterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        ConstIterator& operator++() {
+            if (table_ == nullptr || index_ == table_->capacity_) {
+                throw InvalidIterator("Invalid Iterator: using ++ on the end iterator");
+            }
+            index_ = table_->NextFull_(index_ + 1);
+            return *this;
+        }
+
+        ConstIterator operator--(int) {
+            ConstIterator tmp = *this;
+            --(*this);
+            return tmp;
+        }
+
+        ConstIterator& operator--() {
+            SizeT index = table_ == nullptr ? -1 : table_->PreviousFull_(index_ - 1);
+            if (index < 0) {
+                throw InvalidIterator("Invalid Iterator: using -- on the beginning iterator");
+            }
+            index_ = index;
+            return *this;
+        }
+
+        bool operator==(const Iterator& rhs) const noexcept {
+            return ((this->table_ == rhs.table_) && (this->index_ == rhs.index_));
+        }
+
+        bool operator==(const ConstIterator& rhs) const noexcept {
+            return ((this->table_ == rhs.table_) && (this->index_ == rhs.index_));
+        }
+
+        bool operator!=(const Iterator& rhs) const noexcept {
+            return ((this->table_ != rhs.table_) || (this->index_ != rhs.index_));
+        }
+
+        bool operator!=(const ConstIterator& rhs) const noexcept {
+            return ((this->table_ != rhs.table_) || (this->index_ != rhs.index_));
+        }
+
+        const T& operator*() const {
+            if (table_ == nullptr || index_ == table_->capacity_) {
+                throw InvalidIterator("Invalid Iterator: de-referencing the end iterator");
+            }
+            return table_->slots_[index_];
+        }
+
+        const T* operator->() const {
+            if (table_ == nullptr || index_ == table_->capacity_) {
+                throw InvalidIterator("Invalid Iterator: de-referencing the end iterator");
+            }
+            return table_->slots_ + index_;
+        }
+
+    private:
+        ConstIterator(SizeT index, const FlatHashTable* table) noexcept : index_(index), table_(table) {}
+
+        SizeT index_ = 0; // the index of the slot, or the capacity for the end iterator
+        const FlatHashTable* table_ = nullptr;
+    };
+
+    explicit FlatHashTable(const Allocator& allocator = Allocator())
+        : hash_(), equal_(), slotAllocator_(allocator), controlAllocator_(allocator) {}
+
+    explicit FlatHashTable(const Hash& hash,
+                           const Equal& equal = Equal(),
+                           const Allocator& allocator = Allocator())
+        : hash_(hash), equal_(equal), slotAllocator_(allocator), controlAllocator_(allocator) {}
+
+    explicit FlatHashTable(SizeT minimumSize,
+                           const Hash& hash = Hash(),
+                           const Equal& equal = Equal(),
+                           const Allocator& allocator = Allocator())
+        : hash_(hash), equal_(equal), slotAllocator_(allocator), controlAllocator_(allocator) {
+        ReserveAtLeast(minimumSize);
+    }
+
+    template<class InputIt>
+    FlatHashTable(InputIt first, InputIt last,
+                  const Hash& hash = Hash(),
+                  const Equal& equal = Equal(),
+                  const Allocator& allocator = Allocator())
+        : hash_(hash), equal_(equal), slotAllocator_(allocator), controlAllocator_(allocator) {
+        try {
+            while (first != last) {
+                this->Insert(*first);
+                ++first;
+            }
+        } catch (...) {
+            this->Clear();
+            throw;
+        }
+    }
+
+    template<class InputIt>
+    FlatHashTable(InputIt first, InputIt last,
+                  SizeT minimumSize,
+                  const Hash& hash = Hash(),
+                  const Equal& equal = Equal(),
+                  const Allocator& allocator = Allocator())
+        : hash_(hash), equal_(equal), slotAllocator_(allocator), controlAllocator_(allocator) {
+        try {
+            ReserveAtLeast(minimumSize);
+            while (first != last) {
+                this->Insert(*first);
+                ++first;
+            }
+        } catch (...) {
+            this->Clear();
+            throw;
+        }
+    }
+
+    FlatHashTable(const FlatHashTable& obj)
+        : hash_(obj.hash_), equal_(obj.equal_),
+          slotAllocator_(obj.slotAllocator_), controlAllocator_(obj.controlAllocator_) {
+        CopyFrom_(obj);
+    }
+
+    FlatHashTable(const FlatHashTable& obj, const Allocator& allocator)
+        : hash_(obj.hash_), equal_(obj.equal_), slotAllocator_(allocator), controlAllocator_(allocator) {
+        CopyFrom_(obj);
+    }
+
+    FlatHashTable(FlatHashTable&& obj) noexcept
+        : control_(obj.control_), slots_(obj.slots_), size_(obj.size_), capacity_(obj.capacity_),
+          hash_(std::move(obj.hash_)), equal_(std::move(obj.equal_)),
+          slotAllocator_(std::move(obj.slotAllocator_)), controlAllocator_(std::move(obj.controlAllocator_)) {
+        obj.control_ = nullptr;
+        obj.slots_ = nullptr;
+        obj.size_ = 0;
+        obj.capacity_ = 0;
+    }
+
+    FlatHashTable(std::initializer_list<T> init,
+                  const Hash& hash,
+                  const Equal& equal = Equal(),
+                  const Allocator& allocator = Allocator())
+        : FlatHashTable(init.begin(), init.end(), static_cast<SizeT>(init.size()), hash, equal, allocator) {}
+
+    FlatHashTable(std::initializer_list<T> init,
+                  const Allocator& allocator = Allocator())
+        : FlatHashTable(init.begin(), init.end(), static_cast<SizeT>(init.size()), Hash(), Equal(), allocator) {}
+
+    FlatHashTable& operator=(const FlatHashTable& obj) {
+        if (this == &obj) {
+            return *this;
+        }
+        FlatHashTable tmp(obj);
+        this->Swap(tmp);
+        return *this;
+    }
+
+    FlatHashTable& operator=(FlatHashTable&& obj) noexcept {
+        if (this == &obj) {
+            return *this;
+        }
+        this->Clear();
+        hash_ = std::move(obj.hash_);
+        equal_ = std::move(obj.equal_);
+        slotAllocator_ = std::move(obj.slotAllocator_);
+        controlAllocator_ = std::move(obj.controlAllocator_);
+        control_ = obj.control_;
+        slots_ = obj.slots_;
+        size_ = obj.size_;
+        capacity_ = obj.capacity_;
+        obj.control_ = nullptr;
+        obj.slots_ = nullptr;
+        obj.size_ = 0;
+        obj.capacity_ = 0;
+        return *this;
+    }
+
+    ~FlatHashTable() { this->Clear(); }
+
+    /**
+     * Delete all the contents of the hash table.  This will also free the
+     * memory of the slots.
+     * @return the reference to the hash table
+     */
+    FlatHashTable& Clear() noexcept {
+        if (capacity_ == 0) return *this;
+        for (SizeT i = 0; i < capacity_; ++i) {
+            if (IsFull_(control_[i])) slots_[i].~T();
+        }
+        slotAllocator_.deallocate(slots_, capacity_);
+        controlAllocator_.deallocate(control_, capacity_ + kGroupWidth_);
+        control_ = nullptr;
+        slots_ = nullptr;
+        size_ = 0;
+        capacity_ = 0;
+        return *this;
+    }
+
+    /**
+     * Try inserting the value into the table.  If the value has not already
+     * been contained in the table, the value will be inserted and a pair of
+     * the iterator pointing to the inserted element and a bool set to true
+     * will be returned.  If not, a pair of the iterator pointing to the
+     * existing element that is equal to the value and a bool set to false
+     * will be returned.
+     * @param value
+     * @return the iterator pointing to the inserted element or the existing
+     * element that is equal to the value and a bool indicating whether the
+     * operation is successful or not
+     */
+    Pair<Iterator, bool> Insert(const T& value) {
+        return Insert_(value);
+    }
+
+    /**
+     * Try inserting the value into the table.  If the value has not already
+     * been contained in the table, the value will be inserted and a pair of
+     * the iterator pointing to the inserted element and a bool set to true
+     * will be returned.  If not, a pair of the iterator pointing to the
+     * existing element that is equal to the value and a bool set to false
+     * will be returned (and the value is not moved).
+     * @param value
+     * @return the iterator pointing to the inserted element or the existing
+     * element that is equal to the value and a bool indicating whether the
+     * operation is successful or not
+     */
+    Pair<Iterator, bool> Insert(T&& value) {
+        return Insert_(std::move(value));
+    }
+
+    /**
+     * Try inserting the value into the hash using a in-place construction of
+     * the contained class.  The function will construct the contained class
+     * even if there is an element equal to it.  If the value has not already
+     * been contained in the table, the value will be inserted and a pair of
+     * the iterator pointing to the inserted element and a bool set to true
+     * will be returned.  If not, a pair of the iterator pointing to the
+     * existing element that is equal to the value and a bool set to false
+     * will be returned.
+     * @tparam Args...
+     * @param args... the argument(s) to construct the contained class
+     * @return the iterator pointing to the inserted element or the existing
+     * element that is equal to the value and a bool indicating whether the
+     * operation is successful or not
+     */
+    template<class... Args>
+    Pair<Iterator, bool> Emplace(Args&&... args) {
+        return Insert_(T(std::forward<Args>(args)...));
+    }
+
+    /**
+     * Erasing the value from the hash table.  If the position iterator is not
+     * pointing to this table or is the end iterator, a
+     * <code>lau::InvalidIterator</code> will be thrown.
+     * @param position the iterator pointing to the element to be erased
+     * @return the reference to the table
+     */
+    FlatHashTable& Erase(Iterator position) {
+        if (position.table_ != this) {
+            throw InvalidIterator("Invalid Iterator: using an iterator that does not belong to the hash table");
+        }
+        if (position.index_ == capacity_) {
+            throw InvalidIterator("Invalid Iterator: erasing with the end iterator");
+        }
+        Erase_(position.index_);
+        return *this;
+    }
+
+    /**
+     * Erasing the value from the hash table.  If the container is empty, a
+     * <code>lau::EmptyContainer</code> will be thrown.  If the value is not
+     * contained in the table, a <code>lau::InvalidArgument</code> will be
+     * thrown.
+     * @param value the value to be deleted
+     * @return the reference to the table
+     */
+    FlatHashTable& Erase(const T& value) {
+        return EraseValue_(value);
+    }
+
+    /**
+     * Erasing the value from the hash table.  If the container is empty, a
+     * <code>lau::EmptyContainer</code> will be thrown.  If the value is not
+     * contained in the table, a <code>lau::InvalidArgument</code> will be
+     * thrown.  Note that the <code>Hash::is_transparent</code> and
+     * <code>KeyEqual::is_transparent</code> must be valid and each denotes a
+     * type.
+     * @tparam K the type of value
+     * @param value
+     * @return the reference to the table
+     */
+    template<class K>
+    FlatHashTable& Erase(const K& value) {
+        return EraseValue_(value);
+    }
+
+    /**
+     * Merge other flat hash table into this flat hash table.  The elements
+     * of the other table that are not contained in this table are moved
+     * into this table, and the others are dropped.  After this operation,
+     * the other table will be cleared.
+     * @param other
+     * @return the reference to the table
+     */
+    FlatHashTable& Merge(FlatHashTable& other) {
+        if (&other == this) return *this;
+        ReserveAtLeast(size_ + other.size_);
+        for (SizeT i = 0; i < other.capacity_; ++i) {
+            if (IsFull_(other.control_[i])) Insert_(std::move(other.slots_[i]));
+        }
+        other.Clear();
+        return *this;
+    }
+
+    /**
+     * Swap the content of two hash tables.
+     * @param other
+     * @return the reference to the table
+     */
+    FlatHashTable& Swap(FlatHashTable& other) noexcept {
+        std::swap(this->control_, other.control_);
+        std::swap(this->slots_, other.slots_);
+        std::swap(this->size_, other.size_);
+        std::swap(this->capacity_, other.capacity_);
+        std::swap(this->hash_, other.hash_);
+        std::swap(this->equal_, other.equal_);
+        std::swap(this->slotAllocator_, other.slotAllocator_);
+        std::swap(this->controlAllocator_, other.controlAllocator_);
+        return *this;
+    }
+
+    /**
+     * Reserve the slots so that at least <code>minimumSize</code> elements
+     * can be contained without growing the table.  If the size is negative,
+     * a <code>lau::InvalidArgument</code> will be thrown.
+     * @param minimumSize
+     * @return the reference to the table
+     */
+    FlatHashTable& ReserveAtLeast(SizeT minimumSize) {
+        if (minimumSize < 0) {
+            throw InvalidArgument("Invalid Argument: the size is negative");
+        }
+        if (minimumSize <= MaxLoad_(capacity_)) return *this;
+        SizeT capacity = std::max(capacity_, kGroupWidth_);
+        while (MaxLoad_(capacity) < minimumSize) capacity *= 2;
+        Rehash_(capacity);
+        return *this;
+    }
+
+    [[nodiscard]] Iterator Begin() noexcept { return Iterator(NextFull_(0), this); }
+    [[nodiscard]] ConstIterator Begin() const noexcept { return ConstIterator(NextFull_(0), this); }
+    [[nodiscard]] Iterator begin() noexcept { return Iterator(NextFull_(0), this); }
+    [[nodiscard]] ConstIterator begin() const noexcept { return ConstIterator(NextFull_(0), this); }
+    [[nodiscard]] ConstIterator ConstBegin() const noexcept { return ConstIterator(NextFull_(0), this); }
+
+    [[nodiscard]] Iterator End() noexcept { return Iterator(capacity_, this); }
+    [[nodiscard]] ConstIterator End() const noexcept { return ConstIterator(capacity_, this); }
+    [[nodiscard]] Iterator end() noexcept { return Iterator(capacity_, this); }
+    [[nodiscard]] ConstIterator end() const noexcept { return ConstIterator(capacity_, this); }
+    [[nodiscard]] ConstIterator ConstEnd() const noexcept { return ConstIterator(capacity_, this); }
+
+    [[nodiscard]] Iterator Find(const T& value) { return Iterator(Find_(value), this); }
+
+    template<class K>
+    [[nodiscard]] Iterator Find(const K& value) { return Iterator(Find_(value), this); }
+
+    [[nodiscard]] ConstIterator Find(const T& value) const { return ConstIterator(Find_(value), this); }
+
+    template<class K>
+    [[nodiscard]] ConstIterator Find(const K& value) const { return ConstIterator(Find_(value), this); }
+
+    [[nodiscard]] bool Contains(const T& value) const { return Find_(value) != capacity_; }
+
+    template<class K>
+    [[nodiscard]] bool Contains(const K& value) const { return Find_(value) != capacity_; }
+
+    [[nodiscard]] SizeT Size() const noexcept { return size_; }
+    [[nodiscard]] bool Empty() const noexcept { return size_ == 0; }
+
+    /**
+     * Get the number of slots, which is 0 or a power of 2.
+     * @return the number of slots
+     */
+    [[nodiscard]] SizeT BucketCount() const noexcept { return capacity_; }
+
+    /**
+     * Get a copy of the hash class.
+     * @return a copy of the hash class
+     */
+    [[nodiscard]] Hash GetHash() const { return hash_; }
+
+    /**
+     * Get a copy of the equal class.
+     * @return a copy of the equal class
+     */
+    [[nodiscard]] Equal GetEqual() const { return equal_; }
+
+    /**
+     * Get a copy of the slot allocator class.
+     * @return a copy of the slot allocator class
+     */
+    [[nodiscard]] SlotAllocatorType GetSlotAllocator() const { return slotAllocator_; }
+
+    /**
+     * Get a copy of the control byte allocator class.
+     * @return a copy of the control byte allocator class
+     */
+    [[nodiscard]] ControlAllocatorType GetControlAllocator() const { return controlAllocator_; }
+
+private:
+    constexpr static SizeT kGroupWidth_ = 16; // the number of control bytes compared at once
+    constexpr static std::int8_t kEmpty_ = -128; // the control byte of an empty slot
+
+    /**
+     * @class Group_
+     *
+     * The control bytes of the slots from a place, which are compared with
+     * a byte at once.  The bit i of a mask is set if the control byte of
+     * the slot i in the group matches.
+     */
+    class Group_ {
+    public:
+        explicit Group_(const std::int8_t* control) noexcept {
+#ifdef LAU_CPP_LIB_FLAT_HASH_TABLE_SSE2
+            control_ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(control));
+#else
+            std::memcpy(control_, control, kGroupWidth_);
+#endif
+        }
+
+        /**
+         * Get the mask of the slots whose control bytes are the given one.
+         * @param byte
+         * @return the mask
+         */
+        [[nodiscard]] std::uint32_t Match(std::int8_t byte) const noexcept {
+#ifdef LAU_CPP_LIB_FLAT_HASH_TABLE_SSE2
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(byte), control_)));
+#else
+            std::uint32_t mask = 0;
+            for (SizeT i = 0; i < kGroupWidth_; ++i) {
+                if (control_[i] == byte) mask |= std::uint32_t(1) << i;
+            }
+            return mask;
+#endif
+        }
+
+        /**
+         * Get the mask of the empty slots.
+         * @return the mask
+         */
+        [[nodiscard]] std::uint32_t MatchEmpty() const noexcept {
+#ifdef LAU_CPP_LIB_FLAT_HASH_TABLE_SSE2
+            // Only the control byte of an empty slot is negative
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(control_));
+#else
+            return Match(kEmpty_);
+#endif
+        }
+
+    private:
+#ifdef LAU_CPP_LIB_FLAT_HASH_TABLE_SSE2
+        __m128i control_;
+#else
+        std::int8_t control_[kGroupWidth_];
+#endif
+    };
+
+    /**
+     * Get the index of the lowest set bit of a non-zero mask.
+     * @param mask
+     * @return the index of the lowest set bit
+     */
+    static SizeT LowestBit_(std::uint32_t mask) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctz(mask);
+#else
+        SizeT index = 0;
+        while ((mask & 1) == 0) {
+            mask >>= 1;
+            ++index;
+        }
+        return index;
+#endif
+    }
+
+    /**
+     * Mix the bits of the hash, so that the hashes differing only in a few
+     * bits (e.g. the identity hash of the integers) are spread over the
+     * slots.  The 7 lowest bits of the result are kept in the control
+     * byte, and the other bits choose the slot.
+     * @param hash
+     * @return the mixed hash
+     */
+    static std::uint64_t Mix_(std::size_t hash) noexcept {
+        std::uint64_t mixed = static_cast<std::uint64_t>(hash) * 0x9e3779b97f4a7c15ULL;
+        return mixed ^ (mixed >> 32);
+    }
+
+    static std::int8_t ControlByte_(std::uint64_t mixed) noexcept {
+        return static_cast<std::int8_t>(mixed & 0x7f);
+    }
+
+    static bool IsFull_(std::int8_t control) noexcept { return control >= 0; }
+
+    /**
+     * Get the maximum number of elements in the given number of slots,
+     * which is 7/8 of the slots.
+     * @param capacity
+     * @return the maximum number of elements
+     */
+    static SizeT MaxLoad_(SizeT capacity) noexcept { return capacity - capacity / 8; }
+
+    /**
+     * Set the control byte of a slot, as well as its copy after the end
+     * (the control bytes of the first group are copied after the last slot,
+     * so that a group can be loaded from any slot).
+     * @param control the control bytes
+     * @param capacity the number of slots
+     * @param index the index of the slot
+     * @param byte
+     */
+    static void SetControl_(std::int8_t* control, SizeT capacity, SizeT index, std::int8_t byte) noexcept {
+        control[index] = byte;
+        if (index < kGroupWidth_) control[capacity + index] = byte;
+    }
+
+    /**
+     * Find the first empty slot from the slot chosen by the hash.
+     * @param control the control bytes
+     * @param capacity the number of slots
+     * @param mixed the mixed hash
+     * @return the index of the empty slot
+     */
+    static SizeT FindEmpty_(const std::int8_t* control, SizeT capacity, std::uint64_t mixed) noexcept {
+        SizeT mask = capacity - 1;
+        SizeT position = static_cast<SizeT>(mixed >> 7) & mask;
+        while (true) {
+            std::uint32_t empty = Group_(control + position).MatchEmpty();
+            if (empty != 0) return (position + LowestBit_(empty)) & mask;
+            position = (position + kGroupWidth_) & mask;
+        }
+    }
+
+    /**
+     * Find the slot of the element that is equal to the given value.
+     * @tparam K
+     * @param value
+     * @return the index of the slot if found, otherwise the capacity
+     */
+    template<class K>
+    [[nodiscard]] SizeT Find_(const K& value) const {
+        if (size_ == 0) return capacity_;
+        return Find_(value, Mix_(hash_(value)));
+    }
+
+    /**
+     * Find the slot of the element that is equal to the given value.  The
+     * elements whose hashes choose a slot are between the slot and the
+     * first empty slot after it, so the probing stops at the first group
+     * with an empty slot.
+     * @tparam K
+     * @param value
+     * @param mixed the mixed hash
+     * @return the index of the slot if found, otherwise the capacity
+     */
+    template<class K>
+    [[nodiscard]] SizeT Find_(const K& value, std::uint64_t mixed) const {
+        SizeT mask = capacity_ - 1;
+        SizeT position = static_cast<SizeT>(mixed >> 7) & mask;
+        std::int8_t byte = ControlByte_(mixed);
+        while (true) {
+            Group_ group(control_ + position);
+            for (std::uint32_t match = group.Match(byte); match != 0; match &= match - 1) {
+                SizeT index = (position + LowestBit_(match)) & mask;
+                if (equal_(slots_[index], value)) return index;
+            }
+            if (group.MatchEmpty() != 0) return capacity_;
+            position = (position + kGroupWidth_) & mask;
+        }
+    }
+
+    /**
+     * Insert the value if there is no element equal to it.
+     * @tparam V
+     * @param value
+     * @return the iterator pointing to the inserted element or the existing
+     * element that is equal to the value and a bool indicating whether the
+     * operation is successful or not
+     */
+    template<class V>
+    Pair<Iterator, bool> Insert_(V&& value) {
+        std::uint64_t mixed = Mix_(hash_(value));
+        if (size_ > 0) {
+            SizeT index = Find_(value, mixed);
+            if (index != capacity_) return Pair<Iterator, bool>(Iterator(index, this), false);
+        }
+        if (size_ + 1 > MaxLoad_(capacity_)) {
+            Rehash_(capacity_ == 0 ? kGroupWidth_ : capacity_ * 2);
+        }
+        SizeT index = FindEmpty_(control_, capacity_, mixed);
+        ::new(slots_ + index) T(std::forward<V>(value));
+        SetControl_(control_, capacity_, index, ControlByte_(mixed));
+        ++size_;
+        return Pair<Iterator, bool>(Iterator(index, this), true);
+    }
+
+    /**
+     * Erase the element that is equal to the given value.
+     * @tparam K
+     * @param value
+     * @return the reference to the table
+     */
+    template<class K>
+    FlatHashTable& EraseValue_(const K& value) {
+        if (size_ == 0) {
+            throw EmptyContainer("Empty Container: using erasing function on an empty container");
+        }
+        SizeT index = Find_(value);
+        if (index == capacity_) {
+            throw InvalidArgument("Invalid Argument: no such element to be erased");
+        }
+        Erase_(index);
+        return *this;
+    }
+
+    /**
+     * Erase the element in the slot.  The elements after it (until an empty
+     * slot) are shifted backward if their hashes choose a slot not after
+     * the hole, so that no element is separated from the slot chosen by its
+     * hash by an empty slot, and no tombstone is needed.
+     * @param index the index of the slot
+     */
+    void Erase_(SizeT index) {
+        SizeT mask = capacity_ - 1;
+        slots_[index].~T();
+        SizeT hole = index;
+        for (SizeT next = (index + 1) & mask; IsFull_(control_[next]); next = (next + 1) & mask) {
+            SizeT home = static_cast<SizeT>(Mix_(hash_(slots_[next])) >> 7) & mask;
+            // The element may fill the hole if the distance from its slot to
+            // the hole is no more than the distance from its slot to itself
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                ::new(slots_ + hole) T(std::move(slots_[next]));
+                slots_[next].~T();
+                SetControl_(control_, capacity_, hole, control_[next]);
+                hole = next;
+            }
+        }
+        SetControl_(control_, capacity_, hole, kEmpty_);
+        --size_;
+    }
+
+    /**
+     * Move the elements into new slots.  If an exception is thrown, the
+     * table is not changed.
+     * @param capacity the new number of slots, which is a power of 2 not
+     * less than the width of a group
+     */
+    void Rehash_(SizeT capacity) {
+        std::int8_t* control = controlAllocator_.allocate(capacity + kGroupWidth_);
+        T* slots;
+        try {
+            slots = slotAllocator_.allocate(capacity);
+        } catch (...) {
+            controlAllocator_.deallocate(control, capacity + kGroupWidth_);
+            throw;
+        }
+        std::memset(control, static_cast<unsigned char>(kEmpty_), capacity + kGroupWidth_);
+        try {
+            for (SizeT i = 0; i < capacity_; ++i) {
+                if (!IsFull_(control_[i])) continue;
+                std::uint64_t mixed = Mix_(hash_(slots_[i]));
+                SizeT index = FindEmpty_(control, capacity, mixed);
+                ::new(slots + index) T(std::move_if_noexcept(slots_[i]));
+                SetControl_(control, capacity, index, ControlByte_(mixed));
+            }
+        } catch (...) {
+            for (SizeT j = 0; j < capacity; ++j) {
+                if (IsFull_(control[j])) slots[j].~T();
+            }
+            slotAllocator_.deallocate(slots, capacity);
+            controlAllocator_.deallocate(control, capacity + kGroupWidth_);
+            throw;
+        }
+        if (capacity_ > 0) {
+            for (SizeT j = 0; j < capacity_; ++j) {
+                if (IsFull_(control_[j])) slots_[j].~T();
+            }
+            slotAllocator_.deallocate(slots_, capacity_);
+            controlAllocator_.deallocate(control_, capacity_ + kGroupWidth_);
+        }
+        control_ = control;
+        slots_ = slots;
+        capacity_ = capacity;
+    }
+
+    /**
+     * Copy the slots of the other table, which has the same hash function,
+     * so the elements are copied to the same slots.  The table MUST be
+     * empty.
+     * @param obj
+     */
+    void CopyFrom_(const FlatHashTable& obj) {
+        if (obj.capacity_ == 0) return;
+        std::int8_t* control = controlAllocator_.allocate(obj.capacity_ + kGroupWidth_);
+        T* slots;
+        try {
+            slots = slotAllocator_.allocate(obj.capacity_);
+        } catch (...) {
+            controlAllocator_.deallocate(control, obj.capacity_ + kGroupWidth_);
+            throw;
+        }
+        std::memcpy(control, obj.control_, obj.capacity_ + kGroupWidth_);
+        SizeT i = 0;
+        try {
+            for (; i < obj.capacity_; ++i) {
+                if (IsFull_(control[i])) ::new(slots + i) T(obj.slots_[i]);
+            }
+        } catch (...) {
+            for (SizeT j = 0; j < i; ++j) {
+                if (IsFull_(control[j])) slots[j].~T();
+            }
+            slotAllocator_.deallocate(slots, obj.capacity_);
+            controlAllocator_.deallocate(control, obj.capacity_ + kGroupWidth_);
+            throw;
+        }
+        control_ = control;
+        slots_ = slots;
+        size_ = obj.size_;
+        capacity_ = obj.capacity_;
+    }
+
+    /**
+     * Get the first full slot from the given index.
+     * @param index
+     * @return the index of the slot, or the capacity if there is none
+     */
+    [[nodiscard]] SizeT NextFull_(SizeT index) const noexcept {
+        while (index < capacity_ && !IsFull_(control_[index])) ++index;
+        return index;
+    }
+
+    /**
+     * Get the last full slot until the given index.
+     * @param index
+     * @return the index of the slot, or -1 if there is none
+     */
+    [[nodiscard]] SizeT PreviousFull_(SizeT index) const noexcept {
+        while (index >= 0 && !IsFull_(control_[index])) --index;
+        return index;
+    }
+
+    std::int8_t* control_  = nullptr; // the control bytes, with a copy of the first group after the end
+    T*           slots_    = nullptr;
+    SizeT        size_     = 0; // the number of elements in the hash table
+    SizeT        capacity_ = 0; // the number of slots (0 or a power of 2 not less than a group)
+    Hash                 hash_;
+    Equal                equal_;
+    SlotAllocatorType    slotAllocator_;
+    ControlAllocatorType controlAllocator_;
+};
+
+template<class T, class Hash, class Equal, class Allocator>
+void Swap(FlatHashTable<T, Hash, Equal, Allocator>& lhs,
+          FlatHashTable<T, Hash, Equal, Allocator>& rhs) noexcept {
+    lhs.Swap(rhs);
+}
+
+} // namespace lau
+
+#endif // LAU_CPP_LIB_LAU_FLAT_HASH_TABLE_H
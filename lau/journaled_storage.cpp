@@ -0,0 +1,391 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/**
+ * @file lau/journaled_storage.cpp
+ *
+ * This is a internal source file, including the implementation of the
+ * <code>lau::JournaledStorage</code> class.
+ */
+
+#include "journaled_storage.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "async_reader.h"
+#include "exception.h"
+#include "type_traits.h"
+
+namespace {
+
+constexpr std::uint64_t kGroupMagic = 0x4c415557414c4731ULL; // "LAUWALG1"
+constexpr std::uint64_t kCommitMagic = 0x4c415557414c4331ULL; // "LAUWALC1"
+
+/**
+ * Write the whole buffer at the position, retrying short writes.
+ * @return whether the write is successful
+ */
+bool WriteAll(int fd, const char* data, SizeT length, long position) {
+    while (length > 0) {
+        ssize_t size = ::pwrite(fd, data, length, position);
+        if (size < 0 && errno == EINTR) continue;
+        if (size <= 0) return false;
+        data += size;
+        length -= size;
+        position += size;
+    }
+    return true;
+}
+
+/**
+ * Read the buffer at the position, retrying short reads.
+ * @return the number of bytes read (less than the length only at the end
+ * of the file), or -1 if the read fails
+ */
+SizeT ReadAll(int fd, char* data, SizeT length, long position) {
+    SizeT total = 0;
+    while (length > 0) {
+        ssize_t size = ::pread(fd, data, length, position);
+        if (size < 0 && errno == EINTR) continue;
+        if (size < 0) return -1;
+        if (size == 0) break;
+        data += size;
+        length -= size;
+        position += size;
+        total += size;
+    }
+    return total;
+}
+
+} // namespace
+
+lau::JournaledStorage::JournaledStorage(const std::string& fileName, SizeT groupSize,
+                                        SizeT logLimit, SizeT pageSize)
+    : fileName_(fileName), groupSize_(groupSize), logLimit_(logLimit), pageSize_(pageSize) {
+    if (groupSize <= 0 || logLimit <= 0 || pageSize <= 0) {
+        throw lau::InvalidArgument("Invalid Argument: the group size, log limit or page size is not positive");
+    }
+    fd_ = ::open(fileName.c_str(), O_RDWR);
+    if (fd_ < 0) {
+        throw lau::RuntimeError("Runtime Error: cannot open the file");
+    }
+    logFd_ = ::open((fileName + ".wal").c_str(), O_RDWR | O_CREAT, 0644);
+    if (logFd_ < 0) {
+        ::close(fd_);
+        throw lau::RuntimeError("Runtime Error: cannot open the log");
+    }
+    try {
+        struct stat status{};
+        if (::fstat(fd_, &status) != 0) throw lau::RuntimeError("Runtime Error: cannot get the size of the file");
+        fileEnd_ = status.st_size;
+        end_ = fileEnd_;
+        reader_ = std::make_unique<AsyncReader>(fd_);
+        Recover_();
+    } catch (...) {
+        ::close(fd_);
+        ::close(logFd_);
+        throw;
+    }
+}
+
+lau::JournaledStorage::JournaledStorage(JournaledStorage&& obj) noexcept
+    : fileName_(std::move(obj.fileName_)), fd_(obj.fd_), logFd_(obj.logFd_), reader_(std::move(obj.reader_)), dirtyPages_(std::move(obj.dirtyPages_)),
+      buffer_(std::move(obj.buffer_)), groupSize_(obj.groupSize_), logLimit_(obj.logLimit_),
+      pageSize_(obj.pageSize_), operations_(obj.operations_), end_(obj.end_),
+      fileEnd_(obj.fileEnd_), logEnd_(obj.logEnd_) {
+    obj.fd_ = -1;
+    obj.logFd_ = -1;
+}
+
+lau::JournaledStorage& lau::JournaledStorage::operator=(JournaledStorage&& obj) noexcept {
+    if (this == &obj) return *this;
+    Close_();
+    fileName_ = std::move(obj.fileName_);
+    fd_ = obj.fd_;
+    logFd_ = obj.logFd_;
+    reader_ = std::move(obj.reader_);
+    dirtyPages_ = std::move(obj.dirtyPages_);
+    buffer_ = std::move(obj.buffer_);
+    groupSize_ = obj.groupSize_;
+    logLimit_ = obj.logLimit_;
+    pageSize_ = obj.pageSize_;
+    operations_ = obj.operations_;
+    end_ = obj.end_;
+    fileEnd_ = obj.fileEnd_;
+    logEnd_ = obj.logEnd_;
+    obj.fd_ = -1;
+    obj.logFd_ = -1;
+    return *this;
+}
+
+lau::JournaledStorage::~JournaledStorage() {
+    Close_();
+}
+
+void lau::JournaledStorage::Read(char* buffer, Ptr position, SizeT length) {
+    while (length > 0) {
+        SizeT number = position / pageSize_;
+        SizeT offset = position % pageSize_;
+        SizeT size = std::min(length, pageSize_ - offset);
+        auto iter = dirtyPages_.find(number);
+        if (iter != dirtyPages_.end()) {
+            std::memcpy(buffer, iter->second.get() + offset, size);
+        } else {
+            // The part beyond the end of the file is filled with 0
+            SizeT got = ReadAll(fd_, buffer, std::max(std::min(size, fileEnd_ - position), 0L), position);
+            if (got < 0) throw lau::RuntimeError("Runtime Error: fail to read the file");
+            std::memset(buffer + got, 0, size - got);
+        }
+        buffer += size;
+        position += size;
+        length -= size;
+    }
+}
+
+void lau::JournaledStorage::ReadBatch(ReadRequest* requests, SizeT count) {
+    // Copy the parts in the modified pages, and read the rest (with the
+    // adjacent parts joined) at once
+    std::vector<ReadRequest> reads;
+    for (SizeT i = 0; i < count; ++i) {
+        char* buffer = requests[i].buffer;
+        Ptr position = requests[i].position;
+        SizeT length = requests[i].length;
+        while (length > 0) {
+            SizeT number = position / pageSize_;
+            SizeT offset = position % pageSize_;
+            SizeT size = std::min(length, pageSize_ - offset);
+            auto iter = dirtyPages_.find(number);
+            if (iter != dirtyPages_.end()) {
+                std::memcpy(buffer, iter->second.get() + offset, size);
+            } else {
+                // The part beyond the end of the file is filled with 0
+                SizeT inFile = std::max(std::min(size, fileEnd_ - position), 0L);
+                std::memset(buffer + inFile, 0, size - inFile);
+                if (!reads.empty() && reads.back().buffer + reads.back().length == buffer
+                    && reads.back().position + reads.back().length == position) {
+                    reads.back().length += inFile;
+                } else if (inFile > 0) {
+                    reads.push_back(ReadRequest{buffer, position, inFile});
+                }
+            }
+            buffer += size;
+            position += size;
+            length -= size;
+        }
+    }
+    reader_->Read(reads.data(), static_cast<SizeT>(reads.size()));
+}
+
+void lau::JournaledStorage::Write(const char* source, Ptr position, SizeT length) {
+    if (position + length > end_) end_ = position + length;
+    while (length > 0) {
+        SizeT offset = position % pageSize_;
+        SizeT size = std::min(length, pageSize_ - offset);
+        std::memcpy(GetPage_(position / pageSize_) + offset, source, size);
+        source += size;
+        position += size;
+        length -= size;
+    }
+}
+
+void lau::JournaledStorage::Move(Ptr source, Ptr target, SizeT length) {
+    if (length <= 0) return;
+    if (static_cast<SizeT>(buffer_.size()) < length) buffer_.resize(length);
+    Read(buffer_.data(), source, length);
+    Write(buffer_.data(), target, length);
+}
+
+void lau::JournaledStorage::Prefetch(Ptr position, SizeT length) {
+    ::posix_fadvise(fd_, position, length, POSIX_FADV_WILLNEED);
+}
+
+lau::JournaledStorage::Ptr lau::JournaledStorage::Allocate(SizeT length) {
+    Ptr position = end_;
+    end_ += length;
+    return position;
+}
+
+void lau::JournaledStorage::EndOperation() {
+    if (++operations_ >= groupSize_) Commit_();
+}
+
+void lau::JournaledStorage::Flush() {
+    Commit_();
+}
+
+bool lau::JournaledStorage::Empty() const noexcept {
+    return end_ == 0;
+}
+
+SizeT lau::JournaledStorage::Alignment() const noexcept {
+    return 1;
+}
+
+const std::string& lau::JournaledStorage::FileName() const noexcept {
+    return fileName_;
+}
+
+char* lau::JournaledStorage::GetPage_(SizeT number) {
+    auto iter = dirtyPages_.find(number);
+    if (iter != dirtyPages_.end()) return iter->second.get();
+    auto page = std::make_unique<char[]>(pageSize_);
+    Read(page.get(), number * pageSize_, pageSize_);
+    return dirtyPages_.emplace(number, std::move(page)).first->second.get();
+}
+
+void lau::JournaledStorage::Commit_() {
+    operations_ = 0;
+    if (dirtyPages_.empty() && end_ == fileEnd_) return;
+
+    // Write the pages in the order of their places
+    std::vector<std::pair<SizeT, const char*>> pages;
+    pages.reserve(dirtyPages_.size());
+    for (auto& page : dirtyPages_) pages.emplace_back(page.first, page.second.get());
+    std::sort(pages.begin(), pages.end());
+
+    // Build the group in the log: header, pages and trailer
+    GroupHeader_ header{kGroupMagic, static_cast<SizeT>(pages.size()), end_};
+    SizeT groupLength = sizeof(GroupHeader_) + static_cast<SizeT>(pages.size()) * (sizeof(SizeT) + pageSize_)
+                        + sizeof(GroupTrailer_);
+    if (static_cast<SizeT>(buffer_.size()) < groupLength) buffer_.resize(groupLength);
+    char* cursor = buffer_.data();
+    std::memcpy(cursor, &header, sizeof(GroupHeader_));
+    cursor += sizeof(GroupHeader_);
+    for (auto& [number, data] : pages) {
+        std::memcpy(cursor, &number, sizeof(SizeT));
+        std::memcpy(cursor + sizeof(SizeT), data, pageSize_);
+        cursor += sizeof(SizeT) + pageSize_;
+    }
+    GroupTrailer_ trailer{Checksum_(buffer_.data(), cursor - buffer_.data()), kCommitMagic};
+    std::memcpy(cursor, &trailer, sizeof(GroupTrailer_));
+
+    // The group is committed once the log is synchronized
+    if (!WriteAll(logFd_, buffer_.data(), groupLength, logEnd_) || ::fdatasync(logFd_) != 0) {
+        throw lau::RuntimeError("Runtime Error: cannot write the log");
+    }
+    logEnd_ += groupLength;
+
+    // If the pages cannot be written to the file, they are kept as
+    // modified, so they are logged and written again with the next group,
+    // and the log is not cleared before that
+    Apply_(pages, end_);
+    dirtyPages_.clear();
+    if (logEnd_ >= logLimit_) Checkpoint_();
+}
+
+void lau::JournaledStorage::Apply_(const std::vector<std::pair<SizeT, const char*>>& pages, Ptr end) {
+    for (auto& [number, data] : pages) {
+        Ptr start = number * pageSize_;
+        SizeT size = std::min(pageSize_, end - start);
+        if (size > 0 && !WriteAll(fd_, data, size, start)) {
+            throw lau::RuntimeError("Runtime Error: cannot write the file");
+        }
+    }
+    if (end != fileEnd_) {
+        if (::ftruncate(fd_, end) != 0) {
+            throw lau::RuntimeError("Runtime Error: cannot set the size of the file");
+        }
+        fileEnd_ = end;
+    }
+}
+
+void lau::JournaledStorage::Checkpoint_() {
+    if (::fsync(fd_) != 0 || ::ftruncate(logFd_, 0) != 0 || ::fdatasync(logFd_) != 0) {
+        throw lau::RuntimeError("Runtime Error: cannot checkpoint the log");
+    }
+    logEnd_ = 0;
+}
+
+void lau::JournaledStorage::Recover_() {
+    struct stat status{};
+    if (::fstat(logFd_, &status) != 0) throw lau::RuntimeError("Runtime Error: cannot get the size of the log");
+    Ptr logSize = status.st_size;
+    Ptr position = 0;
+    std::vector<char> group;
+    while (position + static_cast<Ptr>(sizeof(GroupHeader_)) <= logSize) {
+        GroupHeader_ header{};
+        if (ReadAll(logFd_, reinterpret_cast<char*>(&header), sizeof(GroupHeader_), position) < 0) {
+            throw lau::RuntimeError("Runtime Error: cannot read the log");
+        }
+        if (header.magic != kGroupMagic || header.pageCount < 0 || header.pageCount > logSize / pageSize_) break;
+        SizeT groupLength = sizeof(GroupHeader_) + header.pageCount * (sizeof(SizeT) + pageSize_)
+                            + sizeof(GroupTrailer_);
+        if (position + groupLength > logSize) break; // the group is not completely written
+
+        group.resize(groupLength);
+        if (ReadAll(logFd_, group.data(), groupLength, position) < 0) {
+            throw lau::RuntimeError("Runtime Error: cannot read the log");
+        }
+        GroupTrailer_ trailer{};
+        std::memcpy(&trailer, group.data() + groupLength - sizeof(GroupTrailer_), sizeof(GroupTrailer_));
+        if (trailer.magic != kCommitMagic
+            || trailer.checksum != Checksum_(group.data(), groupLength - sizeof(GroupTrailer_))) {
+            break;
+        }
+
+        // Replay the committed group
+        std::vector<std::pair<SizeT, const char*>> pages;
+        const char* cursor = group.data() + sizeof(GroupHeader_);
+        for (SizeT i = 0; i < header.pageCount; ++i) {
+            SizeT number;
+            std::memcpy(&number, cursor, sizeof(SizeT));
+            pages.emplace_back(number, cursor + sizeof(SizeT));
+            cursor += sizeof(SizeT) + pageSize_;
+        }
+        Apply_(pages, header.end);
+        position += groupLength;
+    }
+    end_ = fileEnd_;
+    if (logSize > 0) Checkpoint_();
+}
+
+void lau::JournaledStorage::Close_() noexcept {
+    if (fd_ >= 0) {
+        try {
+            Commit_();
+            Checkpoint_();
+        } catch (...) {
+            // The committed groups are still in the log and will be
+            // replayed next time
+        }
+        ::close(fd_);
+    }
+    if (logFd_ >= 0) ::close(logFd_);
+    fd_ = -1;
+    logFd_ = -1;
+    dirtyPages_.clear();
+}
+
+std::uint64_t lau::JournaledStorage::Checksum_(const char* data, SizeT length) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (SizeT i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
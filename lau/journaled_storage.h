@@ -0,0 +1,262 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/**
+ * @file lau/journaled_storage.h
+ *
+ * This is a external header file, including a
+ * <code>lau::JournaledStorage</code> class.
+ */
+
+#ifndef LAU_CPP_LIB_LAU_JOURNALED_STORAGE_H
+#define LAU_CPP_LIB_LAU_JOURNALED_STORAGE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "async_reader.h"
+#include "type_traits.h"
+
+namespace lau {
+
+/**
+ * @class JournaledStorage
+ *
+ * A storage of the data structures based on files that keeps the file
+ * consistent even if the program crashes (POSIX only).
+ * <br><br>
+ * The modified pages are kept in memory until a group of operations is
+ * committed.  On commit, the images of the modified pages are appended to
+ * a write-ahead log (the file name with a ".wal" suffix) with one
+ * <code>fsync</code>, and then written to the file.  When the storage is
+ * opened, the committed groups in the log are replayed, and the groups
+ * that are not completely written are discarded.  The log is cleared
+ * (checkpointed) when it grows larger than the limit.
+ * <br><br>
+ * The data structures tell the storage the end of each operation by
+ * <code>EndOperation</code>, so an operation is never split into two
+ * groups.
+ */
+class JournaledStorage {
+public:
+    using Ptr = long;
+
+    /**
+     * Open the file and replay its log.  Please make sure that the file
+     * does exist.  The log will be created if it does not exist.
+     * @param fileName
+     * @param groupSize the number of operations committed together, 64 by
+     * default
+     * @param logLimit the size of the log that triggers a checkpoint,
+     * 64 MiB by default
+     * @param pageSize the size of a page, 4 KiB by default
+     * @throw lau::InvalidArgument if an argument is not positive
+     * @throw lau::RuntimeError if the file or the log cannot be opened,
+     * or the log cannot be replayed
+     */
+    explicit JournaledStorage(const std::string& fileName, SizeT groupSize = 64,
+                              SizeT logLimit = 64 * 1024 * 1024, SizeT pageSize = 4096);
+
+    JournaledStorage(JournaledStorage&& obj) noexcept;
+
+    JournaledStorage(const JournaledStorage&) = delete;
+
+    JournaledStorage& operator=(JournaledStorage&& obj) noexcept;
+
+    JournaledStorage& operator=(const JournaledStorage&) = delete;
+
+    ~JournaledStorage();
+
+    /**
+     * Read a string of stuff from the file.
+     * @param buffer the place to put the data
+     * @param position the place to get the data
+     * @param length
+     * @throw lau::RuntimeError if the file cannot be read
+     */
+    void Read(char* buffer, Ptr position, SizeT length);
+
+    /**
+     * Read a batch of strings of stuff from the file.  The parts in the
+     * modified pages are copied, and the rest are read with the reads in
+     * flight at the same time (see <code>lau::AsyncReader</code>).
+     * @param requests
+     * @param count the number of requests
+     */
+    void ReadBatch(ReadRequest* requests, SizeT count);
+
+    /**
+     * Write a string of stuff to the file.  The data will not be written
+     * to the file until the group is committed.
+     * @param source the source pointer
+     * @param position the place to place the data
+     * @param length
+     */
+    void Write(const char* source, Ptr position, SizeT length);
+
+    /**
+     * Move a string of stuff to another place of the file.  The source
+     * and the target may overlap.
+     * @param source the place of the data
+     * @param target the new place of the data
+     * @param length
+     */
+    void Move(Ptr source, Ptr target, SizeT length);
+
+    /**
+     * Tell the storage that the data will be read soon, so that it can be
+     * loaded in the background.
+     * @param position the place of the data
+     * @param length
+     */
+    void Prefetch(Ptr position, SizeT length);
+
+    /**
+     * Get a new space at the end of the file.
+     * @param length the length of the new space
+     * @return the place of the new space
+     */
+    Ptr Allocate(SizeT length);
+
+    /**
+     * Mark the end of an operation.  The group is committed when it
+     * contains enough operations.
+     * @throw lau::RuntimeError if the group is committed and the log or
+     * the file cannot be written
+     */
+    void EndOperation();
+
+    /**
+     * Commit the current group, so that everything written is durable.
+     * @throw lau::RuntimeError if the log or the file cannot be written
+     */
+    void Flush();
+
+    /**
+     * Tell whether the file is empty.
+     * @return the boolean of whether the file is empty
+     */
+    [[nodiscard]] bool Empty() const noexcept;
+
+    /**
+     * Get the size that the places and the lengths of the data are best
+     * aligned to.  There is no need to align for this storage.
+     * @return 1
+     */
+    [[nodiscard]] SizeT Alignment() const noexcept;
+
+    /**
+     * Get the name of the file, so that the data structures based on files
+     * can find the files they keep beside it.
+     * @return the name of the file
+     */
+    [[nodiscard]] const std::string& FileName() const noexcept;
+
+private:
+    /**
+     * @struct GroupHeader_{magic, pageCount, end}
+     *
+     * The header of a group in the log, followed by the pages (each with
+     * its number ahead) and a <code>GroupTrailer_</code>.
+     */
+    struct GroupHeader_ {
+        std::uint64_t magic;
+        SizeT         pageCount;
+        Ptr           end; // the end of the file after the group
+    };
+
+    /**
+     * @struct GroupTrailer_{checksum, magic}
+     *
+     * The commit record of a group.  A group is committed only if its
+     * trailer is complete and the checksum matches.
+     */
+    struct GroupTrailer_ {
+        std::uint64_t checksum;
+        std::uint64_t magic;
+    };
+
+    /**
+     * Get the modified page with the number.  The page will be loaded from
+     * the file if it is not modified in the current group.
+     * @param number
+     * @return the pointer to the data of the page
+     */
+    char* GetPage_(SizeT number);
+
+    /**
+     * Write the modified pages to the log, sync the log, and then write
+     * them to the file.  The pages stay modified until they are written
+     * to the file.
+     * @throw lau::RuntimeError if the log or the file cannot be written
+     */
+    void Commit_();
+
+    /**
+     * Write the pages to the file and set the size of the file.
+     * @param pages the pages with their numbers
+     * @param end the end of the file
+     * @throw lau::RuntimeError if the file cannot be written
+     */
+    void Apply_(const std::vector<std::pair<SizeT, const char*>>& pages, Ptr end);
+
+    /**
+     * Sync the file and clear the log.
+     */
+    void Checkpoint_();
+
+    /**
+     * Replay the committed groups in the log.
+     * @throw lau::RuntimeError if the log cannot be read or the file
+     * cannot be written
+     */
+    void Recover_();
+
+    /**
+     * Commit, checkpoint and close the files.
+     */
+    void Close_() noexcept;
+
+    /**
+     * Calculate the checksum (64-bit FNV-1a) of a string of stuff.
+     * @param data
+     * @param length
+     * @return the checksum
+     */
+    static std::uint64_t Checksum_(const char* data, SizeT length);
+
+    std::string fileName_;
+    int fd_ = -1; // the file
+    int logFd_ = -1; // the log
+    std::unique_ptr<AsyncReader> reader_; // the reader of the file
+    std::unordered_map<SizeT, std::unique_ptr<char[]>> dirtyPages_;
+    std::vector<char> buffer_; // the buffer for moving data and writing the log
+    SizeT groupSize_;
+    SizeT logLimit_;
+    SizeT pageSize_;
+    SizeT operations_ = 0; // the number of operations in the current group
+    Ptr end_ = 0; // the end of the file, including the allocated space
+    Ptr fileEnd_ = 0; // the real size of the file
+    Ptr logEnd_ = 0; // the size of the log
+};
+
+} // namespace lau
+
+#endif // LAU_CPP_LIB_LAU_JOURNALED_STORAGE_H
@@ -47,12 +47,14 @@ namespace lau {
  * @tparam Value the value type
  * @tparam Hash the class that can get the hash value of the key
  * @tparam Equal the class that can tell whether two keys are equal
+ * @tparam Policy the rehash policy of the table
  */
 template<class Key,
          class Value,
          class Hash      = std::hash<Key>,
          class Equal     = std::equal_to<Key>,
-         class Allocator = std::allocator<KeyValuePair<const Key, Value>>>
+         class Allocator = std::allocator<KeyValuePair<const Key, Value>>,
+         class Policy    = RehashPolicy>
 class LinkedHashMap {
 public:
     using MapPair    = KeyValuePair<const Key, Value>;
@@ -140,7 +142,7 @@ public:
         ~Iterator() = default;
 
         explicit operator MapPair*() const noexcept {
-            return &((static_cast<typename LinkedHashTable<MapPair, PairHash, PairEqual, Allocator>::Node*>(iterator_))->value);
+            return &((static_cast<typename LinkedHashTable<MapPair, PairHash, PairEqual, Allocator, Policy>::Node*>(iterator_))->value);
         }
 
         Iterator operator++(int) {
@@ -174,10 +176,10 @@ public:
         MapPair* operator->() const noexcept {return &(iterator_->value);}
 
     private:
-        explicit Iterator(const typename LinkedHashTable<MapPair, PairHash, PairEqual, Allocator>::Iterator& iterator)
+        explicit Iterator(const typename LinkedHashTable<MapPair, PairHash, PairEqual, Allocator, Policy>::Iterator& iterator)
             : iterator_(iterator) {}
 
-        typename LinkedHashTable<MapPair, PairHash, PairEqual, Allocator>::Iterator iterator_;
+        typename LinkedHashTable<MapPair, PairHash, PairEqual, Allocator, Policy>::Iterator iterator_;
     };
 
     class ConstIterator {
@@ -240,9 +242,9 @@ public:
         const MapPair* operator->() const { return &(iterator_->value); }
 
     private:
-        explicit ConstIterator(const typename LinkedHashTable<MapPair, PairHash, PairEqual, Allocator>::ConstIterator& iterator)
+        explicit ConstIterator(const typename LinkedHashTable<MapPair, PairHash, PairEqual, Allocator, Policy>::ConstIterator& iterator)
             : iterator_(iterator) {}
-        typename LinkedHashTable<MapPair, PairHash, PairEqual, Allocator>::ConstIterator iterator_;
+        typename LinkedHashTable<MapPair, PairHash, PairEqual, Allocator, Policy>::ConstIterator iterator_;
     };
 
     LinkedHashMap() = default;
@@ -587,12 +589,12 @@ public:
     [[nodiscard]] PairHash GetEqual() const { return table_.GetEqual().equal_; }
 
 private:
-    LinkedHashTable<MapPair, PairHash, PairEqual, Allocator> table_;
+    LinkedHashTable<MapPair, PairHash, PairEqual, Allocator, Policy> table_;
 };
 
-template<class Key, class Value, class Hash, class KeyEqual, class Allocator>
-void Swap(LinkedHashMap<Key, Value, Hash, KeyEqual, Allocator>& lhs,
-          LinkedHashMap<Key, Value, Hash, KeyEqual, Allocator>& rhs) {
+template<class Key, class Value, class Hash, class KeyEqual, class Allocator, class Policy>
+void Swap(LinkedHashMap<Key, Value, Hash, KeyEqual, Allocator, Policy>& lhs,
+          LinkedHashMap<Key, Value, Hash, KeyEqual, Allocator, Policy>& rhs) {
     lhs.Swap(rhs);
 }
 
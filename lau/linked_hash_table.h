@@ -44,11 +44,16 @@ namespace lau {
  * @tparam Hash
  * @tparam Equal
  * @tparam Allocator
+ * @tparam Policy the rehash policy, which decides the bucket sizes and maps
+ * the hash values to the buckets (<code>lau::RehashPolicy</code>,
+ * <code>lau::FastRangeRehashPolicy</code> or
+ * <code>lau::PowerOfTwoRehashPolicy</code>)
  */
 template <class T,
           class Hash = std::hash<T>,
           class Equal = std::equal_to<T>,
-          class Allocator = std::allocator<T>>
+          class Allocator = std::allocator<T>,
+          class Policy = RehashPolicy>
 class LinkedHashTable {
 public:
     struct Node;
@@ -310,7 +315,7 @@ public:
         BucketIterator(const BucketIterator&) noexcept = default;
         explicit BucketIterator(const Iterator& obj) noexcept
             : target_(obj.target_),
-              bucket_(obj.table_->bucket_ + target_->hash % obj.table_->bucketSize_) {}
+              bucket_(obj.table_->bucket_ + obj.table_->rehashPolicy_.BucketIndex(target_->hash)) {}
 
         BucketIterator& operator=(const BucketIterator&) noexcept = default;
 
@@ -390,11 +395,11 @@ public:
 
         explicit ConstBucketIterator(const Iterator& obj) noexcept
             : target_(obj.target_),
-              bucket_(obj.table_->bucket_ + target_->hash % obj.table_->bucketSize_) {}
+              bucket_(obj.table_->bucket_ + obj.table_->rehashPolicy_.BucketIndex(target_->hash)) {}
 
         explicit ConstBucketIterator(const ConstIterator& obj) noexcept
             : target_(obj.target_),
-              bucket_(obj.table_->bucket_ + target_->hash % obj.table_->bucketSize_) {}
+              bucket_(obj.table_->bucket_ + obj.table_->rehashPolicy_.BucketIndex(target_->hash)) {}
 
         ConstBucketIterator& operator=(const ConstBucketIterator&) noexcept = default;
 
@@ -474,7 +479,9 @@ public:
         : hash_(hash), equal_(equal), rehashPolicy_(minimumBucketSize),
           nodeAllocator_(allocator), bucketAllocator_(allocator),
           head_(nullptr), tail_(nullptr), bucket_(bucketAllocator_.allocate(rehashPolicy_.GetSize())),
-          size_(0), bucketSize_(rehashPolicy_.GetSize()) {}
+          size_(0), bucketSize_(rehashPolicy_.GetSize()) {
+        for (SizeT i = 0; i < bucketSize_; ++i) bucket_[i] = nullptr;
+    }
 
     template<class InputIt>
     LinkedHashTable(InputIt first, InputIt last,
@@ -506,6 +513,7 @@ public:
           nodeAllocator_(allocator), bucketAllocator_(allocator),
           head_(nullptr), tail_(nullptr), bucket_(bucketAllocator_.allocate(rehashPolicy_.GetSize())),
           size_(0), bucketSize_(rehashPolicy_.GetSize()) {
+        for (SizeT i = 0; i < bucketSize_; ++i) bucket_[i] = nullptr;
         try {
             while (first != last) {
                 this->Insert(*first);
@@ -693,7 +701,7 @@ public:
             newTail = newNode;
 
             // Handling the bucket
-            std::size_t index = (newNode->hash) % obj.bucketSize_;
+            std::size_t index = obj.rehashPolicy_.BucketIndex(newNode->hash);
             newNode->next = newBucket[index];
             newBucket[index] = newNode;
         }
@@ -773,7 +781,7 @@ public:
     Pair<Iterator, bool> Insert(const T& value) {
         if (NeedRehash_()) Rehash_();
         std::size_t hash = hash_(value);
-        std::size_t bucketIndex = hash % bucketSize_;
+        std::size_t bucketIndex = rehashPolicy_.BucketIndex(hash);
         Node* tmpNode = bucket_[bucketIndex];
         while (tmpNode != nullptr) {
             if (equal_(tmpNode->value, value)) {
@@ -815,7 +823,7 @@ public:
     Pair<Iterator, bool> Insert(T&& value) {
         if (NeedRehash_()) Rehash_();
         std::size_t hash = hash_(value);
-        std::size_t bucketIndex = hash % bucketSize_;
+        std::size_t bucketIndex = rehashPolicy_.BucketIndex(hash);
         Node* tmpNode = bucket_[bucketIndex];
         while (tmpNode != nullptr) {
             if (equal_(tmpNode->value, value)) {
@@ -877,7 +885,7 @@ public:
             throw;
         }
         std::size_t hash = newNode->hash;
-        std::size_t bucketIndex = hash % bucketSize_;
+        std::size_t bucketIndex = rehashPolicy_.BucketIndex(hash);
         Node* tmpNode = bucket_[bucketIndex];
         try {
             while (tmpNode != nullptr) {
@@ -936,7 +944,7 @@ public:
         if (size_ == 0) {
             throw EmptyContainer("Empty Container: using erasing function on an empty container");
         }
-        std::size_t bucketIndex = hash_(value) % bucketSize_;
+        std::size_t bucketIndex = rehashPolicy_.BucketIndex(hash_(value));
         Node* tmpNode = bucket_[bucketIndex];
         if (tmpNode == nullptr) {
             throw InvalidArgument("Invalid Argument: no such element to be erased");
@@ -998,7 +1006,7 @@ public:
         if (size_ == 0) {
             throw EmptyContainer("Empty Container: using erasing function on an empty container");
         }
-        std::size_t bucketIndex = hash_(value) % bucketSize_;
+        std::size_t bucketIndex = rehashPolicy_.BucketIndex(hash_(value));
         Node* tmpNode = bucket_[bucketIndex];
         if (tmpNode == nullptr) {
             throw InvalidArgument("Invalid Argument: no such element to be erased");
@@ -1117,7 +1125,7 @@ public:
         this->bucketAllocator_ = std::move(other.bucketAllocator_);
         other.bucketAllocator_ = std::move(tmpBucketAllocator);
 
-        RehashPolicy tmpRehashPolicy = this->rehashPolicy_;
+        Policy tmpRehashPolicy = this->rehashPolicy_;
         this->rehashPolicy_ = other.rehashPolicy_;
         other.rehashPolicy_ = tmpRehashPolicy;
 
@@ -1132,8 +1140,7 @@ public:
      * @return the reference to the table
      */
     LinkedHashTable& ReserveAtLeast(SizeT minimumSize) noexcept {
-        if (minimumSize <= bucketSize_ ||
-            minimumSize >= rehashPolicy_.NextSize()) {
+        if (minimumSize <= bucketSize_ || bucketSize_ >= Policy::MaxSize()) {
             return *this;
         }
         SizeT newSize = rehashPolicy_.ReserveAtLeast(minimumSize);
@@ -1150,7 +1157,7 @@ public:
         for (SizeT i = 0; i < newSize; ++i) {
             newBucket[i] = nullptr;
         }
-        for (Node* node = head_; node != nullptr; node = node->next) {
+        for (Node* node = head_; node != nullptr; node = node->linkedNext) {
             Reinsert_(node);
         }
         return *this;
@@ -1261,7 +1268,7 @@ private:
      * @return
      */
     [[nodiscard]] bool NeedRehash_() const noexcept {
-        if (size_ >= RehashPolicy::MaxSize()) return false;
+        if (size_ >= Policy::MaxSize()) return false;
         return (size_ >= bucketSize_);
     }
 
@@ -1303,7 +1310,7 @@ private:
      * @param node the node to reinsert
      */
     void Reinsert_(Node* node) noexcept {
-        std::size_t index = (node->hash) % bucketSize_;
+        std::size_t index = rehashPolicy_.BucketIndex(node->hash);
         node->next = bucket_[index];
         bucket_[index] = node;
     }
@@ -1329,7 +1336,7 @@ private:
     template<class K>
     [[nodiscard]] Node* Find_(const K& value, std::size_t hash) const {
         if (size_ == 0) return nullptr;
-        std::size_t bucketIndex = hash % bucketSize_;
+        std::size_t bucketIndex = rehashPolicy_.BucketIndex(hash);
         Node* tmpNode = bucket_[bucketIndex];
         while (tmpNode != nullptr) {
             if (equal_(tmpNode->value, value)) {
@@ -1353,10 +1360,10 @@ private:
         if (node->linkedPrevious != nullptr) {
             node->linkedPrevious->linkedNext = node->linkedNext;
         }
-        std::size_t hash = node->hash % bucketSize_;
-        Node* tmpNode = bucket_[hash];
+        std::size_t bucketIndex = rehashPolicy_.BucketIndex(node->hash);
+        Node* tmpNode = bucket_[bucketIndex];
         if (tmpNode == node) {
-            bucket_[hash] = node->next;
+            bucket_[bucketIndex] = node->next;
         } else {
             while (tmpNode->next != node) tmpNode = tmpNode->next;
             tmpNode->next = node->next;
@@ -1366,21 +1373,23 @@ private:
         --size_;
     }
 
+    // The policy and the allocators are declared first, since the bucket
+    // is allocated with them in the constructors.
+    Hash                 hash_;
+    Equal                equal_;
+    Policy               rehashPolicy_;
+    NodeAllocatorType    nodeAllocator_;
+    BucketAllocatorType  bucketAllocator_;
     Node*  head_       = nullptr;
     Node*  tail_       = nullptr;
     Node** bucket_     = nullptr;
     SizeT  size_       = 0; // the number of elements in the hash table
     SizeT  bucketSize_ = 0; // the number of buckets
-    Hash                 hash_;
-    Equal                equal_;
-    RehashPolicy         rehashPolicy_;
-    NodeAllocatorType    nodeAllocator_;
-    BucketAllocatorType  bucketAllocator_;
 };
 
-template<class T, class Hash, class Equal, class Allocator>
-void Swap(LinkedHashTable<T, Hash, Equal, Allocator>& lhs,
-          LinkedHashTable<T, Hash, Equal, Allocator>& rhs) noexcept {
+template<class T, class Hash, class Equal, class Allocator, class Policy>
+void Swap(LinkedHashTable<T, Hash, Equal, Allocator, Policy>& lhs,
+          LinkedHashTable<T, Hash, Equal, Allocator, Policy>& rhs) noexcept {
     lhs.Swap(rhs);
 }
 
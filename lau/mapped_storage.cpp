@@ -0,0 +1,226 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/**
+ * @file lau/mapped_storage.cpp
+ *
+ * This is a internal source file, including the implementation of the
+ * <code>lau::MappedStorage</code> class.
+ */
+
+#include "mapped_storage.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "async_reader.h"
+#include "exception.h"
+#include "type_traits.h"
+
+namespace {
+
+constexpr std::uint64_t kEndMagic = 0x4c41554d53454e44ULL; // "LAUMSEND"
+
+} // namespace
+
+lau::MappedStorage::MappedStorage(const std::string& fileName, SizeT extentSize)
+    : fileName_(fileName), extentSize_(extentSize) {
+    if (extentSize <= 0) {
+        throw lau::InvalidArgument("Invalid Argument: the extent size is not positive");
+    }
+    fd_ = ::open(fileName.c_str(), O_RDWR);
+    if (fd_ < 0) {
+        throw lau::RuntimeError("Runtime Error: cannot open the file");
+    }
+    struct stat status{};
+    if (::fstat(fd_, &status) != 0) {
+        ::close(fd_);
+        throw lau::RuntimeError("Runtime Error: cannot get the size of the file");
+    }
+    end_ = status.st_size;
+    if (end_ > 0) {
+        void* address = ::mmap(nullptr, end_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (address == MAP_FAILED) {
+            ::close(fd_);
+            throw lau::RuntimeError("Runtime Error: cannot map the file");
+        }
+        data_ = static_cast<char*>(address);
+        capacity_ = end_;
+
+        // The mark is still there if the storage was not destroyed (e.g. the
+        // program crashed), and the rest of the last extent is not used
+        if (capacity_ >= static_cast<SizeT>(sizeof(EndMark_))) {
+            EndMark_ mark{};
+            std::memcpy(&mark, data_ + capacity_ - sizeof(EndMark_), sizeof(EndMark_));
+            if (mark.magic == kEndMagic && mark.end >= 0
+                && mark.end <= capacity_ - static_cast<SizeT>(sizeof(EndMark_))) {
+                end_ = mark.end;
+            }
+        }
+    }
+}
+
+lau::MappedStorage::MappedStorage(MappedStorage&& obj) noexcept
+    : fileName_(std::move(obj.fileName_)), fd_(obj.fd_), data_(obj.data_), capacity_(obj.capacity_),
+      extentSize_(obj.extentSize_), end_(obj.end_) {
+    obj.fd_ = -1;
+    obj.data_ = nullptr;
+    obj.capacity_ = 0;
+    obj.end_ = 0;
+}
+
+lau::MappedStorage& lau::MappedStorage::operator=(MappedStorage&& obj) noexcept {
+    if (this == &obj) return *this;
+    Close_();
+    fileName_ = std::move(obj.fileName_);
+    fd_ = obj.fd_;
+    data_ = obj.data_;
+    capacity_ = obj.capacity_;
+    extentSize_ = obj.extentSize_;
+    end_ = obj.end_;
+    obj.fd_ = -1;
+    obj.data_ = nullptr;
+    obj.capacity_ = 0;
+    obj.end_ = 0;
+    return *this;
+}
+
+lau::MappedStorage::~MappedStorage() {
+    Close_();
+}
+
+void lau::MappedStorage::Read(char* buffer, Ptr position, SizeT length) {
+    if (length <= 0) return;
+    std::memcpy(buffer, data_ + position, length);
+}
+
+void lau::MappedStorage::ReadBatch(ReadRequest* requests, SizeT count) {
+    for (SizeT i = 0; i < count; ++i) Read(requests[i].buffer, requests[i].position, requests[i].length);
+}
+
+void lau::MappedStorage::Write(const char* source, Ptr position, SizeT length) {
+    if (length <= 0) return;
+    if (position + length > end_) Extend_(position + length);
+    std::memcpy(data_ + position, source, length);
+}
+
+void lau::MappedStorage::Move(Ptr source, Ptr target, SizeT length) {
+    if (length <= 0) return;
+    if (target + length > end_) Extend_(target + length);
+    std::memmove(data_ + target, data_ + source, length);
+}
+
+void lau::MappedStorage::Prefetch(Ptr position, SizeT length) {
+    // madvise needs an address aligned to pages
+    static const SizeT pageSize = ::sysconf(_SC_PAGESIZE);
+    length = std::min(length, capacity_ - position);
+    if (length <= 0) return;
+    Ptr start = position / pageSize * pageSize;
+    ::madvise(data_ + start, length + (position - start), MADV_WILLNEED);
+}
+
+lau::MappedStorage::Ptr lau::MappedStorage::Allocate(SizeT length) {
+    Ptr position = end_;
+    if (length > 0) {
+        Extend_(position + length);
+        // The space may be used before (e.g. by the old mark of the end), so
+        // clear it
+        std::memset(data_ + position, 0, length);
+    }
+    return position;
+}
+
+void lau::MappedStorage::EndOperation() {}
+
+void lau::MappedStorage::Flush() {
+    if (data_ == nullptr) return;
+    // fsync also keeps the size of the file, which is changed by the extents
+    if (::msync(data_, capacity_, MS_SYNC) != 0 || ::fsync(fd_) != 0) {
+        throw lau::RuntimeError("Runtime Error: cannot write the file back");
+    }
+}
+
+bool lau::MappedStorage::Empty() const noexcept {
+    return end_ == 0;
+}
+
+SizeT lau::MappedStorage::Alignment() const noexcept {
+    return 1;
+}
+
+const std::string& lau::MappedStorage::FileName() const noexcept {
+    return fileName_;
+}
+
+void lau::MappedStorage::Extend_(Ptr end) {
+    Reserve_(end + static_cast<SizeT>(sizeof(EndMark_)));
+    end_ = end;
+    EndMark_ mark{end_, kEndMagic};
+    std::memcpy(data_ + capacity_ - sizeof(EndMark_), &mark, sizeof(EndMark_));
+}
+
+void lau::MappedStorage::Reserve_(SizeT size) {
+    if (size <= capacity_) return;
+    SizeT oldCapacity = capacity_;
+    SizeT newCapacity = (size + extentSize_ - 1) / extentSize_ * extentSize_;
+    if (::ftruncate(fd_, newCapacity) != 0) {
+        throw lau::RuntimeError("Runtime Error: cannot extend the file");
+    }
+    void* address;
+#ifdef MREMAP_MAYMOVE
+    if (data_ != nullptr) {
+        address = ::mremap(data_, capacity_, newCapacity, MREMAP_MAYMOVE);
+    } else {
+        address = ::mmap(nullptr, newCapacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    }
+#else
+    if (data_ != nullptr) ::munmap(data_, capacity_);
+    data_ = nullptr;
+    capacity_ = 0;
+    address = ::mmap(nullptr, newCapacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+#endif
+    if (address == MAP_FAILED) {
+        throw lau::RuntimeError("Runtime Error: cannot map the file");
+    }
+    data_ = static_cast<char*>(address);
+    capacity_ = newCapacity;
+
+    // Clear the old mark of the end, unless the used space reaches it
+    if (oldCapacity - static_cast<SizeT>(sizeof(EndMark_)) >= end_) {
+        std::memset(data_ + oldCapacity - sizeof(EndMark_), 0, sizeof(EndMark_));
+    }
+}
+
+void lau::MappedStorage::Close_() noexcept {
+    if (data_ != nullptr) ::munmap(data_, capacity_);
+    if (fd_ >= 0) {
+        ::ftruncate(fd_, end_);
+        ::close(fd_);
+    }
+    fd_ = -1;
+    data_ = nullptr;
+    capacity_ = 0;
+    end_ = 0;
+}
@@ -0,0 +1,200 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/**
+ * @file lau/mapped_storage.h
+ *
+ * This is a external header file, including a
+ * <code>lau::MappedStorage</code> class.
+ */
+
+#ifndef LAU_CPP_LIB_LAU_MAPPED_STORAGE_H
+#define LAU_CPP_LIB_LAU_MAPPED_STORAGE_H
+
+#include <cstdint>
+#include <string>
+
+#include "async_reader.h"
+#include "type_traits.h"
+
+namespace lau {
+
+/**
+ * @class MappedStorage
+ *
+ * A storage of the data structures based on files that maps the file into
+ * memory (POSIX only).  Reads and writes are plain memory copies, moving
+ * data is done by <code>memmove</code> in place, and the file grows in
+ * large preallocated extents, so that no system call is needed for most
+ * of the operations.
+ * <br><br>
+ * The file is truncated to the really used size when the storage is
+ * destroyed.  Until then, the end of the used space is also kept at the
+ * end of the mapped space, so that the unused extent is not taken as used
+ * when the file is opened again after a crash.
+ */
+class MappedStorage {
+public:
+    using Ptr = long;
+
+    /**
+     * Open the file and map it into memory.  Please make sure that the
+     * file does exist.
+     * @param fileName
+     * @param extentSize the size that the file grows by each time, 64 MiB
+     * by default
+     * @throw lau::InvalidArgument if the extent size is not positive
+     * @throw lau::RuntimeError if the file cannot be opened or mapped
+     */
+    explicit MappedStorage(const std::string& fileName, SizeT extentSize = 64 * 1024 * 1024);
+
+    MappedStorage(MappedStorage&& obj) noexcept;
+
+    MappedStorage(const MappedStorage&) = delete;
+
+    MappedStorage& operator=(MappedStorage&& obj) noexcept;
+
+    MappedStorage& operator=(const MappedStorage&) = delete;
+
+    ~MappedStorage();
+
+    /**
+     * Read a string of stuff from the mapped file.
+     * @param buffer the place to put the data
+     * @param position the place to get the data
+     * @param length
+     */
+    void Read(char* buffer, Ptr position, SizeT length);
+
+    /**
+     * Read a batch of strings of stuff from the mapped file.  The data are
+     * copied one by one, since they are already in memory.
+     * @param requests
+     * @param count the number of requests
+     */
+    void ReadBatch(ReadRequest* requests, SizeT count);
+
+    /**
+     * Write a string of stuff to the mapped file.
+     * @param source the source pointer
+     * @param position the place to place the data
+     * @param length
+     * @throw lau::RuntimeError if the file cannot grow
+     */
+    void Write(const char* source, Ptr position, SizeT length);
+
+    /**
+     * Move a string of stuff to another place of the file.  The source
+     * and the target may overlap.
+     * @param source the place of the data
+     * @param target the new place of the data
+     * @param length
+     * @throw lau::RuntimeError if the file cannot grow
+     */
+    void Move(Ptr source, Ptr target, SizeT length);
+
+    /**
+     * Tell the storage that the data will be read soon, so that it can be
+     * loaded in the background.
+     * @param position the place of the data
+     * @param length
+     */
+    void Prefetch(Ptr position, SizeT length);
+
+    /**
+     * Get a new space at the end of the file.
+     * @param length the length of the new space
+     * @return the place of the new space
+     * @throw lau::RuntimeError if the file cannot grow
+     */
+    Ptr Allocate(SizeT length);
+
+    /**
+     * Mark the end of an operation.  Nothing needs to be done for this
+     * storage.
+     */
+    void EndOperation();
+
+    /**
+     * Write the modified pages back to the file and wait until they are
+     * stored in the device.
+     * @throw lau::RuntimeError if the pages cannot be written back
+     */
+    void Flush();
+
+    /**
+     * Tell whether the file is empty.
+     * @return the boolean of whether the file is empty
+     */
+    [[nodiscard]] bool Empty() const noexcept;
+
+    /**
+     * Get the size that the places and the lengths of the data are best
+     * aligned to.  There is no need to align for this storage.
+     * @return 1
+     */
+    [[nodiscard]] SizeT Alignment() const noexcept;
+
+    /**
+     * Get the name of the file, so that the data structures based on files
+     * can find the files they keep beside it.
+     * @return the name of the file
+     */
+    [[nodiscard]] const std::string& FileName() const noexcept;
+
+private:
+    /**
+     * @struct EndMark_{end, magic}
+     *
+     * The mark at the end of the mapped space, which keeps the end of the
+     * used space until the file is truncated to it.
+     */
+    struct EndMark_ {
+        Ptr           end;
+        std::uint64_t magic;
+    };
+
+    /**
+     * Move the end of the used space forward, growing the file if needed,
+     * and update the mark of the end.
+     * @param end the new end
+     */
+    void Extend_(Ptr end);
+
+    /**
+     * Make sure that the mapped space is at least <code>size</code> bytes.
+     * The file grows by whole extents.
+     * @param size
+     */
+    void Reserve_(SizeT size);
+
+    /**
+     * Unmap the file, cut off the unused extent and close the file.
+     */
+    void Close_() noexcept;
+
+    std::string fileName_;
+    int fd_ = -1;
+    char* data_ = nullptr;
+    SizeT capacity_ = 0; // the size of the mapped space
+    SizeT extentSize_;
+    Ptr end_ = 0; // the end of the used space
+};
+
+} // namespace lau
+
+#endif // LAU_CPP_LIB_LAU_MAPPED_STORAGE_H
@@ -0,0 +1,85 @@
+// Lau CPP Library - to strengthen the ability of C++ STL
+// Copyright (C) 2022 Lau Yee-Yu
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/**
+ * @file lau/reader_writer_latch.h
+ *
+ * This is an internal header file, including a
+ * <code>lau::ReaderWriterLatch</code> class, which is used by the data
+ * structures based on files.
+ */
+
+#ifndef LAU_CPP_LIB_LAU_READER_WRITER_LATCH_H
+#define LAU_CPP_LIB_LAU_READER_WRITER_LATCH_H
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
+namespace lau {
+
+/**
+ * @class ReaderWriterLatch
+ *
+ * The latch to read a data structure in several threads.  It is shared by
+ * the functions that only read the structure and exclusive to the
+ * functions that modify it.  A writer holds the turn latch while it
+ * waits, and <code>writers_</code> counts the writers waiting, so that
+ * the readers coming later wait for them instead of starving them (and
+ * the readers do not touch the turn latch when no writer is waiting).
+ * <br><br>
+ * The latch cannot be moved, so a structure that can be moved keeps it
+ * in the heap.
+ */
+class ReaderWriterLatch {
+public:
+    ReaderWriterLatch() = default;
+
+    ReaderWriterLatch(const ReaderWriterLatch&) = delete;
+
+    ReaderWriterLatch& operator=(const ReaderWriterLatch&) = delete;
+
+    /**
+     * Lock the latch for a function that only reads the structure.
+     * @return the shared lock
+     */
+    std::shared_lock<std::shared_mutex> ReadLock() {
+        if (writers_.load() == 0) return std::shared_lock<std::shared_mutex>(latch_);
+        std::lock_guard<std::mutex> turn(turn_);
+        return std::shared_lock<std::shared_mutex>(latch_);
+    }
+
+    /**
+     * Lock the latch for a function that modifies the structure.
+     * @return the exclusive lock
+     */
+    std::unique_lock<std::shared_mutex> WriteLock() {
+        ++writers_;
+        std::lock_guard<std::mutex> turn(turn_);
+        std::unique_lock<std::shared_mutex> lock(latch_);
+        --writers_;
+        return lock;
+    }
+
+private:
+    std::shared_mutex latch_;
+    std::mutex        turn_;
+    std::atomic<int>  writers_{0};
+};
+
+}
+
+#endif // LAU_CPP_LIB_LAU_READER_WRITER_LATCH_H
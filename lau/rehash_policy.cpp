@@ -18,7 +18,8 @@
  * @file lau/rehash_policy.cpp
  *
  * This is a internal source file, including the implementation of the
- * <code>lau::RehashPolicy</code> class.
+ * <code>lau::RehashPolicy</code> and <code>lau::PowerOfTwoRehashPolicy</code>
+ * classes.
  */
 
 #include "rehash_policy.h"
@@ -92,3 +93,42 @@ void lau::RehashPolicy::SetSize(SizeT size) {
 [[nodiscard]] SizeT lau::RehashPolicy::GetSize() const noexcept {
     return kBucketSize_[index_];
 }
+
+lau::PowerOfTwoRehashPolicy::PowerOfTwoRehashPolicy(SizeT minimumSize) {
+    ReserveAtLeast(minimumSize);
+}
+
+[[nodiscard]] SizeT lau::PowerOfTwoRehashPolicy::NextSize() noexcept {
+    if (index_ != kMaxIndex_) ++index_;
+    return GetSize();
+}
+
+[[nodiscard]] SizeT lau::PowerOfTwoRehashPolicy::PreviousSize() noexcept {
+    if (index_ != 0) --index_;
+    return GetSize();
+}
+
+SizeT lau::PowerOfTwoRehashPolicy::ReserveAtLeast(SizeT size) {
+    if (size < 0) {
+        throw lau::InvalidArgument("Invalid Argument: the size is negative");
+    }
+    index_ = 0;
+    while (index_ < kMaxIndex_ && GetSize() < size) ++index_;
+    return GetSize();
+}
+
+void lau::PowerOfTwoRehashPolicy::SetSize(SizeT size) {
+    if (size < 0) {
+        throw lau::InvalidArgument("Invalid Argument: the size is negative");
+    }
+    SizeT index = 0;
+    while (index < kMaxIndex_ && SizeOf_(index) < size) ++index;
+    if (SizeOf_(index) != size) {
+        throw lau::InvalidArgument("Invalid Argument: argument not matching any of the bucket size");
+    }
+    index_ = index;
+}
+
+[[nodiscard]] SizeT lau::PowerOfTwoRehashPolicy::GetSize() const noexcept {
+    return SizeOf_(index_);
+}
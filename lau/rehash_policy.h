@@ -24,10 +24,25 @@
 #ifndef LAU_CPP_LIB_LAU_REHASH_POLICY_H
 #define LAU_CPP_LIB_LAU_REHASH_POLICY_H
 
+#include <cstddef>
+#include <cstdint>
+
+#if !defined(__SIZEOF_INT128__) && defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
 #include "type_traits.h"
 
 namespace lau {
 
+/**
+ * @class RehashPolicy
+ *
+ * The default rehash policy, whose bucket sizes are primes.  The hash value
+ * is reduced by the modulo of the prime, which is a compile-time constant
+ * selected by the current size, so the compiler can replace the division
+ * with a multiplication.
+ */
 class RehashPolicy {
 public:
     RehashPolicy() noexcept = default;
@@ -77,11 +92,59 @@ public:
      */
     [[nodiscard]] SizeT GetSize() const noexcept;
 
+    /**
+     * Get the index of the bucket for the hash value.  The bucket size must
+     * not be 0.
+     * @param hash
+     * @return the index of the bucket, which is less than the bucket size
+     */
+    [[nodiscard]] std::size_t BucketIndex(std::size_t hash) const noexcept {
+        switch (index_) {
+            case 1:  return Modulo_<1>(hash);
+            case 2:  return Modulo_<2>(hash);
+            case 3:  return Modulo_<3>(hash);
+            case 4:  return Modulo_<4>(hash);
+            case 5:  return Modulo_<5>(hash);
+            case 6:  return Modulo_<6>(hash);
+            case 7:  return Modulo_<7>(hash);
+            case 8:  return Modulo_<8>(hash);
+            case 9:  return Modulo_<9>(hash);
+            case 10: return Modulo_<10>(hash);
+            case 11: return Modulo_<11>(hash);
+            case 12: return Modulo_<12>(hash);
+            case 13: return Modulo_<13>(hash);
+            case 14: return Modulo_<14>(hash);
+            case 15: return Modulo_<15>(hash);
+            case 16: return Modulo_<16>(hash);
+            case 17: return Modulo_<17>(hash);
+            case 18: return Modulo_<18>(hash);
+            case 19: return Modulo_<19>(hash);
+            case 20: return Modulo_<20>(hash);
+            case 21: return Modulo_<21>(hash);
+            case 22: return Modulo_<22>(hash);
+            case 23: return Modulo_<23>(hash);
+            case 24: return Modulo_<24>(hash);
+            case 25: return Modulo_<25>(hash);
+            case 26: return Modulo_<26>(hash);
+            case 27: return Modulo_<27>(hash);
+            case 28: return Modulo_<28>(hash);
+            case 29: return Modulo_<29>(hash);
+            case 30: return Modulo_<30>(hash);
+            case 31: return Modulo_<31>(hash);
+            default: return 0;
+        }
+    }
+
     [[nodiscard]] constexpr static SizeT MaxSize() noexcept {
         return kBucketSize_[kMaxIndex_];
     }
 
-private:
+protected:
+    template<SizeT kIndex>
+    [[nodiscard]] constexpr static std::size_t Modulo_(std::size_t hash) noexcept {
+        return hash % static_cast<std::size_t>(kBucketSize_[kIndex]);
+    }
+
     constexpr static SizeT kBucketSize_[32] = {
         0,
         127,
@@ -121,6 +184,129 @@ private:
     SizeT index_ = 0;
 };
 
+/**
+ * @class FastRangeRehashPolicy
+ *
+ * A rehash policy with the same bucket sizes as
+ * <code>lau::RehashPolicy</code>, but the hash value is reduced with the
+ * fast range method (multiplying the mixed hash value by the bucket size and
+ * taking the high 64 bits), so no division is needed.
+ */
+class FastRangeRehashPolicy : public RehashPolicy {
+public:
+    using RehashPolicy::RehashPolicy;
+
+    /**
+     * Get the index of the bucket for the hash value.  The bucket size must
+     * not be 0.
+     * @param hash
+     * @return the index of the bucket, which is less than the bucket size
+     */
+    [[nodiscard]] std::size_t BucketIndex(std::size_t hash) const noexcept {
+        std::uint64_t mixed = static_cast<std::uint64_t>(hash) * kMultiplier_;
+        std::uint64_t size = static_cast<std::uint64_t>(kBucketSize_[index_]);
+#if defined(__SIZEOF_INT128__)
+        return static_cast<std::size_t>((static_cast<unsigned __int128>(mixed) * size) >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        return static_cast<std::size_t>(__umulh(mixed, size));
+#else
+        std::uint64_t mixedLow = mixed & 0xffffffffU, mixedHigh = mixed >> 32;
+        std::uint64_t sizeLow = size & 0xffffffffU, sizeHigh = size >> 32;
+        std::uint64_t middle = (mixedLow * sizeLow >> 32) + (mixedHigh * sizeLow & 0xffffffffU) + mixedLow * sizeHigh;
+        return static_cast<std::size_t>(mixedHigh * sizeHigh + (mixedHigh * sizeLow >> 32) + (middle >> 32));
+#endif
+    }
+
+private:
+    constexpr static std::uint64_t kMultiplier_ = 0x9e3779b97f4a7c15U;
+};
+
+/**
+ * @class PowerOfTwoRehashPolicy
+ *
+ * A rehash policy whose bucket sizes are powers of 2.  The hash value is
+ * mixed by multiplying it by an odd constant, and the highest bits are taken
+ * as the index (Fibonacci hashing), so no division is needed and the hash
+ * functions that only change the low bits (such as <code>std::hash</code>
+ * for integers) still spread well.
+ */
+class PowerOfTwoRehashPolicy {
+public:
+    PowerOfTwoRehashPolicy() noexcept = default;
+    explicit PowerOfTwoRehashPolicy(SizeT minimumSize);
+    PowerOfTwoRehashPolicy(const PowerOfTwoRehashPolicy&) noexcept = default;
+
+    PowerOfTwoRehashPolicy& operator=(const PowerOfTwoRehashPolicy&) noexcept = default;
+
+    ~PowerOfTwoRehashPolicy() = default;
+
+    /**
+     * Move to the next bucket size.  Note that if the current size reaches
+     * the maximum size, the size will be set to the maximum size.
+     * @return the new bucket size
+     */
+    [[nodiscard]] SizeT NextSize() noexcept;
+
+    /**
+     * Move back to the previous bucket size.  Note that if the size reaches
+     * the minimum size (namely, 0), the size will be set to the minimum size.
+     * @return the new bucket size
+     */
+    [[nodiscard]] SizeT PreviousSize() noexcept;
+
+    /**
+     * Set the size to the minimum size that is larger than the given size.
+     * If the size is negative, a <code>lau::InvalidArgument</code> will be
+     * thrown.  Note that if the size is larger than the maximum size, the
+     * size will be set to the maximum size.
+     * @param size
+     * @return the new bucket size
+     */
+    SizeT ReserveAtLeast(SizeT size);
+
+    /**
+     * Set the size to the input value.  If the size is negative, or the size
+     * is neither 0 nor a power of 2 within the range, a
+     * <code>lau::InvalidArgument</code> will be thrown.  It is recommended
+     * to use this function only when you have to fall back to the previous
+     * size.
+     * @param size
+     */
+    void SetSize(SizeT size);
+
+    /**
+     * Get the current bucket size.
+     * @return the current bucket size
+     */
+    [[nodiscard]] SizeT GetSize() const noexcept;
+
+    /**
+     * Get the index of the bucket for the hash value.  The bucket size must
+     * not be 0.
+     * @param hash
+     * @return the index of the bucket, which is less than the bucket size
+     */
+    [[nodiscard]] std::size_t BucketIndex(std::size_t hash) const noexcept {
+        return static_cast<std::size_t>((static_cast<std::uint64_t>(hash) * kMultiplier_) >>
+                                        (64 - kMinShift_ - index_));
+    }
+
+    [[nodiscard]] constexpr static SizeT MaxSize() noexcept {
+        return SizeOf_(kMaxIndex_);
+    }
+
+private:
+    [[nodiscard]] constexpr static SizeT SizeOf_(SizeT index) noexcept {
+        return index == 0 ? 0 : SizeT(1) << (index + kMinShift_);
+    }
+
+    constexpr static std::uint64_t kMultiplier_ = 0x9e3779b97f4a7c15U;
+    constexpr static SizeT kMinShift_ = 6; // the first non-zero size is 2^7
+    constexpr static SizeT kMaxIndex_ = 31;
+
+    SizeT index_ = 0; // the size is 0 if index_ is 0, or 2^(index_ + 6)
+};
+
 } // namespace lau
 
 #endif // LAU_CPP_LIB_LAU_REHASH_POLICY_H